@@ -0,0 +1,195 @@
+#pragma once
+
+#include "malc.h"
+#include "opres.h"
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+
+namespace aico::sys
+{
+    //linear allocator: allocations bump an offset and are never released one
+    //by one, memory comes back all at once through rollback() or reset().
+    //chunks are mapped lazily and kept across resets, so a steady workload
+    //stops touching the OS after its first pass. not thread safe
+    struct arena
+    {
+        struct chunk_t
+        {
+            chunk_t* next;
+            size_t bytes;   //mapped bytes, header included
+        };
+        static constexpr size_t CHUNK_HDR=(sizeof(chunk_t)+alignof(max_align_t)-1)&
+            ~(alignof(max_align_t)-1);
+
+        //a point to roll back to, everything allocated after it is dropped
+        struct marker
+        {
+            chunk_t* chunk;
+            size_t offset;
+        };
+
+        explicit arena(size_t chunkbytes=1*MB)noexcept:_chunkbytes(chunkbytes){}
+        arena(arena&& other)noexcept:_head(other._head), _cur(other._cur),
+            _offset(other._offset), _chunkbytes(other._chunkbytes)
+        {
+            other._head=other._cur=nullptr;
+            other._offset=0;
+        }
+        arena(const arena&)=delete;
+        arena& operator=(const arena&)=delete;
+        arena& operator=(arena&&)=delete;
+        ~arena()noexcept
+        {
+            _unmap(_head);
+        }
+
+        inline void* alloc(size_t bytes, size_t alignment=alignof(max_align_t),
+            opres* res=nullptr)noexcept
+        {
+            if(!is_pow2(alignment))
+            {
+                if(res) *res=opres::ALIGN_ERR;
+                return nullptr;
+            }
+            if(_cur)
+                if(void* p=_bump(_cur, _offset, bytes, alignment); p)
+                {
+                    if(res) *res=opres::SUCCESS;
+                    return p;
+                }
+            //spare chunks past _cur are free, reuse the next one if it fits
+            size_t offset=CHUNK_HDR;
+            chunk_t* next=_cur?_cur->next:_head;
+            void* p=next?_bump(next, offset, bytes, alignment):nullptr;
+            if(!p)
+            {
+                const size_t page=os_pagesize();
+                const size_t needed=CHUNK_HDR+bytes+alignment;
+                const size_t mapped=(uintptr_t)align_up(
+                    (void*)std::max(_chunkbytes, needed), page);
+                chunk_t* c=(chunk_t*)os_map(mapped, page);
+                if(!c)
+                {
+                    if(res) *res=opres::MEM_ERR;
+                    return nullptr;
+                }
+                stat_map(mapped);
+                *c={.next=next, .bytes=mapped};
+                (_cur?_cur->next:_head)=c;
+                next=c;
+                offset=CHUNK_HDR;
+                p=_bump(c, offset, bytes, alignment);
+            }
+            _cur=next;
+            _offset=offset;
+            if(res) *res=opres::SUCCESS;
+            return p;
+        }
+        template<typename T>
+        inline T* alloc(size_t count)noexcept
+        {
+            return (T*)alloc(sizeof(T)*count, alignof(T)>alignof(void*)?
+                alignof(T):alignof(void*));
+        }
+
+        inline marker mark()const noexcept{return {_cur, _offset};}
+        //`m` must come from this arena, and not from before a later rollback
+        inline void rollback(marker m)noexcept
+        {
+            _cur=m.chunk;
+            _offset=m.offset;
+        }
+        //O(1), chunks stay mapped for the next round
+        inline void reset()noexcept
+        {
+            _cur=nullptr;
+            _offset=0;
+        }
+        //unmaps the chunks past the current one
+        inline size_t shrink()noexcept
+        {
+            chunk_t*& spare=_cur?_cur->next:_head;
+            const size_t released=_unmap(spare);
+            spare=nullptr;
+            return released;
+        }
+        //bytes mapped across all chunks
+        inline size_t reserved()const noexcept
+        {
+            size_t bytes=0;
+            for(chunk_t* c=_head; c; c=c->next)
+                bytes+=c->bytes;
+            return bytes;
+        }
+        //bytes handed out since the last reset, padding included
+        inline size_t used()const noexcept
+        {
+            size_t bytes=0;
+            for(chunk_t* c=_head; c&&_cur; c=c->next)
+            {
+                if(c==_cur)
+                    return bytes+_offset-CHUNK_HDR;
+                bytes+=c->bytes-CHUNK_HDR;//skipped tails included
+            }
+            return bytes;
+        }
+
+        inline static size_t _unmap(chunk_t* c)noexcept
+        {
+            size_t released=0;
+            while(c)
+            {
+                chunk_t* next=c->next;
+                const size_t bytes=c->bytes;
+                os_unmap(c, bytes);
+                stat_unmap(bytes);
+                released+=bytes;
+                c=next;
+            }
+            return released;
+        }
+        inline static void* _bump(chunk_t* c, size_t& offset, size_t bytes,
+            size_t alignment)noexcept
+        {
+            const uintptr_t at=(uintptr_t)align_up((char*)c+offset, alignment);
+            if(at+bytes>(uintptr_t)c+c->bytes)
+                return nullptr;
+            offset=at+bytes-(uintptr_t)c;
+            return (void*)at;
+        }
+
+        chunk_t* _head=nullptr;
+        chunk_t* _cur=nullptr;  //nullptr until the first alloc after a reset
+        size_t _offset=0;
+        size_t _chunkbytes;
+    };
+
+    //the calling thread's arena for arena_alloc, wndctx::loop binds the
+    //current frame's arena here
+    inline arena*& bound_arena()
+    {
+        thread_local arena* a=nullptr;
+        return a;
+    }
+    //binds an arena to the calling thread for the lifetime of the scope
+    struct arena_scope
+    {
+        arena* prev;
+        explicit arena_scope(arena& a)noexcept:prev(bound_arena()){bound_arena()=&a;}
+        arena_scope(const arena_scope&)=delete;
+        arena_scope& operator=(const arena_scope&)=delete;
+        ~arena_scope()noexcept{bound_arena()=prev;}
+    };
+
+    //storage Alloc/Free pair, e.g.
+    //storage<T, DYNAMIC, false, 8, &sys::arena_alloc, &sys::arena_free>.
+    //memory lives until the bound arena is reset, arena_free is a no-op
+    inline void* arena_alloc(size_t bytes)
+    {
+        arena* a=bound_arena();
+        return a?a->alloc(bytes):nullptr;
+    }
+    inline void arena_free(void*){}
+}
@@ -0,0 +1,374 @@
+#pragma once
+
+#include "malc.h"
+#include "opres.h"
+#include "storage.h"
+
+#include <bit>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace aico
+{
+    //a group of flat_map control bytes probed at once. a control byte is
+    //0..127 for a full slot, holding 7 bits of its hash, else one of the
+    //two values below, both with the high bit set. match masks have one
+    //bit, or one byte's high bit without SSE2, per matching control byte
+    struct ctrl_group
+    {
+        static constexpr int8_t EMPTY=-128;     //0b10000000
+        static constexpr int8_t DELETED=-2;     //0b11111110
+
+#ifdef AICO_BITS_SSE2
+        static constexpr size_t WIDTH=16, SHIFT=0;
+        __m128i v;
+
+        explicit ctrl_group(const int8_t* p)noexcept:v(_mm_loadu_si128((const __m128i*)p)){}
+        inline uint64_t match(int8_t h)const noexcept
+        {
+            return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h), v));
+        }
+        inline uint64_t match_empty()const noexcept{return match(EMPTY);}
+        //empty or deleted
+        inline uint64_t match_free()const noexcept{return (uint32_t)_mm_movemask_epi8(v);}
+#else
+        static constexpr size_t WIDTH=8, SHIFT=3;
+        static constexpr uint64_t LSBS=0x0101010101010101ull, MSBS=0x8080808080808080ull;
+        uint64_t w;
+
+        explicit ctrl_group(const int8_t* p)noexcept:w(bits_word((const uint8_t*)p, 0)){}
+        //may flag a full byte next to a real match, never a free one, the
+        //key compare sorts it out
+        inline uint64_t match(int8_t h)const noexcept
+        {
+            const uint64_t x=w^(LSBS*(uint8_t)h);
+            return (x-LSBS)&~x&MSBS;
+        }
+        inline uint64_t match_empty()const noexcept{return w&~(w<<6)&MSBS;}
+        inline uint64_t match_free()const noexcept{return w&MSBS;}
+#endif
+        inline static size_t lowest(uint64_t mask)noexcept
+        {
+            return (size_t)std::countr_zero(mask)>>SHIFT;
+        }
+    };
+
+    //open addressing hash map, swisstable style: a control byte per slot,
+    //probed a group at a time, slots and control bytes in one block from
+    //Alloc. values do not have stable addresses, any insert may rehash.
+    //capacity is a power of two, at most 7/8 full counting tombstones
+    template<typename K, typename V, typename Hash=std::hash<K>, typename Eq=std::equal_to<K>,
+        memalloc_t Alloc=&alloc_bind, memfree_t Free=&sys::rel>
+    requires(std::is_move_constructible_v<K>&&std::is_move_constructible_v<V>)
+    class flat_map
+    {
+    public: //XXX testing
+        static constexpr size_t GROUP=ctrl_group::WIDTH;
+
+        struct slot_t
+        {
+            K key;
+            V value;
+        };
+        static_assert(alignof(slot_t)<=alignof(std::max_align_t));
+
+        //control bytes of an empty map, all EMPTY, probing them finds nothing
+        alignas(16) static constexpr int8_t _empty_group[16]=
+        {
+            -128, -128, -128, -128, -128, -128, -128, -128,
+            -128, -128, -128, -128, -128, -128, -128, -128,
+        };
+
+        slot_t* _slots=nullptr;
+        //capacity+GROUP bytes, the last GROUP mirror the first so a group
+        //load never wraps
+        int8_t* _ctrl=const_cast<int8_t*>(_empty_group);
+        size_t _capacity=0;
+        size_t _size=0;
+        size_t _growth_left=0;  //empty slots that may still be filled
+        [[no_unique_address]] Hash _hasher;
+        [[no_unique_address]] Eq _eq;
+
+        inline static constexpr size_t _max_load(size_t cpct)noexcept{return cpct-cpct/8;}
+
+        //mixed so both the 7 control bits and the probe start see every input bit
+        inline uint64_t _hash(const K& key)const noexcept(noexcept(_hasher(key)))
+        {
+            uint64_t h=(uint64_t)_hasher(key)*0x9E3779B97F4A7C15ull;
+            return h^(h>>32);
+        }
+        inline static int8_t _h2(uint64_t h)noexcept{return (int8_t)(h&0x7F);}
+        inline size_t _mask()const noexcept{return _capacity?_capacity-1:0;}
+
+        inline void _setctrl(size_t i, int8_t c)noexcept
+        {
+            _ctrl[i]=c;
+            if(i<GROUP)
+                _ctrl[_capacity+i]=c;
+        }
+
+        //triangular probing over groups, visits every group once per lap.
+        //f(group, pos) returns true to stop
+        template<typename F>
+        inline void _probe(uint64_t h, F&& f)const
+        {
+            const size_t mask=_mask();
+            size_t pos=(size_t)(h>>7)&mask;
+            for(size_t step=GROUP; !f(ctrl_group(_ctrl+pos), pos); step+=GROUP)
+                pos=(pos+step)&mask;
+        }
+        //slot of `key` or ~0
+        inline size_t _lookup(const K& key, uint64_t h)const
+        {
+            const int8_t h2=_h2(h);
+            const size_t mask=_mask();
+            size_t res=~size_t(0);
+            _probe(h, [&](const ctrl_group g, size_t pos)
+                {
+                    for(uint64_t m=g.match(h2); m; m&=m-1)
+                        if(const size_t i=(pos+ctrl_group::lowest(m))&mask; _eq(_slots[i].key, key))
+                            return res=i, true;
+                    return g.match_empty()!=0;  //key would have gone here
+                });
+            return res;
+        }
+        //first empty or deleted slot on the probe path of `h`
+        inline size_t _free_slot(uint64_t h)const noexcept
+        {
+            const size_t mask=_mask();
+            size_t res=0;
+            _probe(h, [&](const ctrl_group g, size_t pos)
+                {
+                    const uint64_t m=g.match_free();
+                    return m&&(res=(pos+ctrl_group::lowest(m))&mask, true);
+                });
+            return res;
+        }
+
+        //moves every element into a fresh block of `newcpct` slots,
+        //tombstones are dropped on the way. the old block stays on failure
+        inline opres _rehash(size_t newcpct)noexcept
+        {
+            assert(std::has_single_bit(newcpct)&&newcpct>=GROUP&&_max_load(newcpct)>=_size);
+            char* block=(char*)Alloc(sizeof(slot_t)*newcpct+newcpct+GROUP);
+            if(!block)  //Alloc fault
+                return opres::MEM_ERR;
+            slot_t* oldslots=_slots;
+            int8_t* oldctrl=_ctrl;
+            const size_t oldcpct=_capacity;
+            _slots=(slot_t*)block;
+            _ctrl=(int8_t*)(block+sizeof(slot_t)*newcpct);
+            _capacity=newcpct;
+            std::memset(_ctrl, (uint8_t)ctrl_group::EMPTY, newcpct+GROUP);
+            for(size_t i=0; i<oldcpct; ++i)
+                if(oldctrl[i]>=0)
+                {
+                    const uint64_t h=_hash(oldslots[i].key);
+                    const size_t dst=_free_slot(h);
+                    std::construct_at(_slots+dst, std::move(oldslots[i]));
+                    std::destroy_at(oldslots+i);
+                    _setctrl(dst, _h2(h));
+                }
+            _growth_left=_max_load(newcpct)-_size;
+            if(oldcpct)
+                Free(oldslots);
+            return opres::SUCCESS;
+        }
+        //out of empty slots: clean tombstones out in place if they are what
+        //fills the table, else double
+        inline opres _grow()noexcept
+        {
+            if(_capacity&&_size<=_max_load(_capacity)/2)
+                return _rehash(_capacity);
+            return _rehash(_capacity?_capacity*2:GROUP);
+        }
+        inline void _destroy()noexcept
+        {
+            if constexpr(!std::is_trivially_destructible_v<slot_t>)
+                for(size_t i=0; i<_capacity; ++i)
+                    if(_ctrl[i]>=0)
+                        std::destroy_at(_slots+i);
+        }
+    public:
+        /*SIZE*/
+
+        inline size_t size()const noexcept{return _size;}
+        inline bool empty()const noexcept{return _size==0;}
+        inline size_t capacity()const noexcept{return _capacity;}
+
+        /*LOOKUP*/
+
+        //nullptr if absent
+        inline V* find(const K& key)
+        {
+            const size_t i=_lookup(key, _hash(key));
+            return i!=~size_t(0)?&_slots[i].value:nullptr;
+        }
+        inline const V* find(const K& key)const
+        {
+            const size_t i=_lookup(key, _hash(key));
+            return i!=~size_t(0)?&_slots[i].value:nullptr;
+        }
+        inline bool contains(const K& key)const{return find(key)!=nullptr;}
+
+        /*ITERATION*/
+
+        //full slots in slot order, as {key, value} pairs
+        template<bool Const>
+        struct basic_iterator
+        {
+            using map_t=std::conditional_t<Const, const flat_map, flat_map>;
+            using value_t=std::conditional_t<Const, const V, V>;
+            map_t* map;
+            size_t i;
+
+            struct sentinel{};
+            inline void _settle()noexcept
+            {
+                while(i<map->_capacity&&map->_ctrl[i]<0)
+                    ++i;
+            }
+            inline std::pair<const K&, value_t&> operator*()const noexcept
+            {
+                return {map->_slots[i].key, map->_slots[i].value};
+            }
+            inline basic_iterator& operator++()noexcept{++i; _settle(); return *this;}
+            inline bool operator!=(sentinel)const noexcept{return i<map->_capacity;}
+        };
+        using iterator=basic_iterator<false>;
+        using const_iterator=basic_iterator<true>;
+
+        inline iterator begin()noexcept
+        {
+            iterator it{this, 0};
+            it._settle();
+            return it;
+        }
+        inline const_iterator begin()const noexcept
+        {
+            const_iterator it{this, 0};
+            it._settle();
+            return it;
+        }
+        inline iterator::sentinel end()noexcept{return {};}
+        inline const_iterator::sentinel end()const noexcept{return {};}
+
+        /*CONSTRUCTOR*/
+
+        flat_map()noexcept=default;
+        explicit flat_map(size_t cpct)
+        {
+            if(rsvcpct(cpct)!=opres::SUCCESS)
+                throw std::bad_alloc();
+        }
+
+            /*COPY*/
+
+        flat_map(const flat_map&)=delete;
+
+            /*MOVE*/
+
+        flat_map(flat_map&& other)noexcept:_slots(other._slots), _ctrl(other._ctrl),
+            _capacity(other._capacity), _size(other._size), _growth_left(other._growth_left),
+            _hasher(std::move(other._hasher)), _eq(std::move(other._eq))
+        {
+            other._slots=nullptr;
+            other._ctrl=const_cast<int8_t*>(_empty_group);
+            other._capacity=other._size=other._growth_left=0;
+        }
+
+        flat_map& operator=(const flat_map&)=delete;
+        flat_map& operator=(flat_map&&)=delete;
+
+        /*RESERVE*/
+
+        //room for `n` elements without a rehash
+        inline opres rsvcpct(size_t n)noexcept
+        {
+            if(n<=_size+_growth_left)   //noalloc
+                return opres::SUCCESS;
+            size_t cpct=std::max(GROUP, std::bit_ceil(n));
+            if(_max_load(cpct)<n)
+                cpct*=2;
+            return _rehash(cpct);
+        }
+
+        /*INSERT*/
+
+        //{value, true} if it was inserted, {value, false} if `key` was
+        //there already, args unused. {nullptr, false} on Alloc fault
+        template<typename KK, typename...Args>
+        inline std::pair<V*, bool> try_emplace(KK&& key, Args&&...args)
+            requires(std::is_constructible_v<K, KK&&>&&std::is_constructible_v<V, Args...>)
+        {
+            const uint64_t h=_hash(key);
+            if(const size_t i=_lookup(key, h); i!=~size_t(0))
+                return {&_slots[i].value, false};
+            size_t dst=_free_slot(h);
+            if(_growth_left==0&&_ctrl[dst]==ctrl_group::EMPTY)
+            {
+                if(_grow()!=opres::SUCCESS)
+                    return {nullptr, false};
+                dst=_free_slot(h);
+            }
+            //control byte last, a throwing constructor leaves the slot free
+            ::new((void*)(_slots+dst)) slot_t{K(std::forward<KK>(key)),
+                V(std::forward<Args>(args)...)};
+            _growth_left-=_ctrl[dst]==ctrl_group::EMPTY;
+            _setctrl(dst, _h2(h));
+            ++_size;
+            return {&_slots[dst].value, true};
+        }
+        //overwrites the value of an existing key
+        template<typename KK, typename VV>
+        inline opres insert_or_assign(KK&& key, VV&& value)
+            requires(std::is_constructible_v<K, KK&&>&&std::is_assignable_v<V&, VV&&>)
+        {
+            auto [v, inserted]=try_emplace(std::forward<KK>(key), std::forward<VV>(value));
+            if(!v)
+                return opres::MEM_ERR;
+            if(!inserted)
+                *v=std::forward<VV>(value);
+            return opres::SUCCESS;
+        }
+
+        /*ERASE*/
+
+        //whether `key` was there. leaves a tombstone, the next rehash drops it
+        inline bool erase(const K& key)
+        {
+            const size_t i=_lookup(key, _hash(key));
+            if(i==~size_t(0))
+                return false;
+            std::destroy_at(_slots+i);
+            _setctrl(i, ctrl_group::DELETED);
+            --_size;
+            return true;
+        }
+        //keeps the capacity
+        inline void clear()noexcept
+        {
+            _destroy();
+            if(_capacity)
+                std::memset(_ctrl, (uint8_t)ctrl_group::EMPTY, _capacity+GROUP);
+            _size=0;
+            _growth_left=_max_load(_capacity);
+        }
+
+        /*DESTRUCTOR*/
+
+        ~flat_map()noexcept
+        {
+            _destroy();
+            if(_capacity)
+                Free(_slots);
+        }
+    };
+}
@@ -1,10 +1,12 @@
 #pragma once
 
 #include "opres.h"
+#include "view.h"
 #include "wndctx.h"
 
 #include <cstdint>
 #include <iostream>
+#include <memory_resource>
 #include <ostream>
 #include <vector>
 #include <optional>
@@ -49,6 +51,20 @@ namespace aico
             const noexcept;
         opres bufdata(const buf_t&, const void* data, size_t size, size_t buf_offset)
             const noexcept;
+        //`count` elements of `elemsize` bytes, `stride` bytes apart in data,
+        //land packed at buf_offset. strided data goes up a stack-sized
+        //batch at a time, nothing is allocated
+        opres bufdata(const buf_t&, const void* data, size_t count, size_t elemsize,
+            size_t stride, size_t buf_offset)const noexcept;
+        //anything a storage_view takes: a storage, a slice, a member view
+        template<typename Src>
+        requires(requires(const Src& src){storage_view(src);})
+        opres bufdata(const buf_t& buffer, const Src& src, size_t buf_offset=0)const noexcept
+        {
+            const auto view=storage_view(src);
+            return bufdata(buffer, view.data(), view.size(), sizeof(*view.data()),
+                view.stride(), buf_offset);
+        }
         void free(buf_t&)const noexcept;
 
         /*VTX LAYOUT*/
@@ -66,15 +82,24 @@ namespace aico
             };
             type T;
         };
+        //the lists draw from the default resource unless built on another
+        //one, see with(). vtxlayout_t keeps its own copy on the default
+        //resource, so a scratch arena is fine here
         struct vtxlayout_info
         {
-            std::vector<bindinfo> buffers;
-            std::vector<attribinfo> attribs;
+            std::pmr::vector<bindinfo> buffers;
+            std::pmr::vector<attribinfo> attribs;
             enum class indexfmt : uint8_t
             {
                 U8, U16, U32
             };
             std::optional<std::pair<buf_t, indexfmt>> indexbuf_fmt = std::nullopt;
+
+            //empty lists drawing from `mr`
+            static vtxlayout_info with(std::pmr::memory_resource* mr)
+            {
+                return {std::pmr::vector<bindinfo>(mr), std::pmr::vector<attribinfo>(mr)};
+            }
         };
         struct vtxlayout_t
         {
@@ -0,0 +1,310 @@
+#pragma once
+
+#include "malc.h"
+#include "opres.h"
+#include "storage.h"
+
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace aico
+{
+    //dynamic storage with room for N elements inline. growing past N spills
+    //to Alloc'd memory and stays there, so short lists never touch the
+    //allocator. same calls as a DYNAMIC storage, except that elements
+    //[0, size()) are always constructed, there is no liveness tracking.
+    //moving an inlined hybrid moves its elements, moving a spilled one
+    //steals the allocation
+    template<typename T, size_t N, memalloc_t Alloc=&alloc_bind,
+        memfree_t Free=&sys::rel, growth_t Growth=&grow_geometric>
+    requires(N>0&&std::is_destructible_v<T>)
+    class hybrid_storage
+    {
+    public: //XXX testing
+        T* _data;
+        size_t _dynmsz;     //number of elements
+        size_t _capacity;   //N while inlined
+        alignas(T) char _buf[sizeof(T)*N];
+
+        static constexpr bool Relocate_Trivially=std::is_trivially_copyable_v<T>;
+        static constexpr bool Nothrow_Relocate=Relocate_Trivially||
+            std::is_nothrow_move_constructible_v<T>;
+    public:
+        /*SIZE*/
+
+        inline size_t size()const noexcept{return _dynmsz;}
+        inline size_t capacity()const noexcept{return _capacity;}
+        //elements still live in the inline buffer
+        inline bool inlined()const noexcept{return (const void*)_data==(const void*)_buf;}
+
+        /*INDEXING*/
+
+        inline T& at(size_t idx)noexcept
+        {
+            assert(idx<this->size() && "out of bounds");
+            return _data[idx];
+        }
+        inline const T& at(size_t idx)const noexcept
+        {
+            assert(idx<this->size() && "out of bounds");
+            return _data[idx];
+        }
+        inline const T& operator[](size_t idx)const noexcept{return at(idx);}
+        inline       T& operator[](size_t idx)      noexcept{return at(idx);}
+
+        /*ITERATOR*/
+
+        inline const T* begin()const noexcept{return _data;}
+        inline       T* begin()      noexcept{return _data;}
+        inline const T* end()const noexcept{return _data+_dynmsz;}
+        inline       T* end()      noexcept{return _data+_dynmsz;}
+
+        /*CONSTRUCTOR*/
+
+        hybrid_storage()noexcept:_data((T*)_buf), _dynmsz(0), _capacity(N){}
+        //default construction
+        explicit hybrid_storage(size_t dynamic_size)requires(requires{T();})
+            :hybrid_storage()
+        {
+            if(rsvcpct(dynamic_size)!=opres::SUCCESS)
+                throw std::bad_alloc();
+            try{std::uninitialized_default_construct_n(_data, dynamic_size);}
+            catch(...){_unspill(); throw;}
+            _dynmsz=dynamic_size;
+        }
+        //copy construction
+        explicit hybrid_storage(size_t dynamic_size, const T& fillval)
+            requires(requires{T(std::declval<const T&>());})
+            :hybrid_storage()
+        {
+            if(rsvcpct(dynamic_size)!=opres::SUCCESS)
+                throw std::bad_alloc();
+            try{std::uninitialized_fill_n(_data, dynamic_size, fillval);}
+            catch(...){_unspill(); throw;}
+            _dynmsz=dynamic_size;
+        }
+
+            /*COPY*/
+
+        //use copyinto(). be explicit.
+        hybrid_storage(const hybrid_storage&)=delete;
+
+            /*MOVE*/
+
+        hybrid_storage(hybrid_storage&& other)noexcept(Nothrow_Relocate)
+            requires(requires{T(std::declval<T&&>());})
+            :hybrid_storage()
+        {
+            if(!other.inlined())
+            {
+                _data=other._data;
+                _dynmsz=other._dynmsz;
+                _capacity=other._capacity;
+                other._data=(T*)other._buf;
+                other._dynmsz=0;
+                other._capacity=N;
+                return;
+            }
+            _relocate(other._data, other._dynmsz, _data);
+            _dynmsz=other._dynmsz;
+            other._dynmsz=0;
+        }
+
+        hybrid_storage& operator=(const hybrid_storage&)=delete;
+        hybrid_storage& operator=(hybrid_storage&&)=delete;
+
+        /*DATA*/
+
+        //std::less is a total order, a raw < between unrelated pointers isn't
+        inline bool _owns(const T* p)const noexcept
+        {
+            return std::greater_equal<const T*>{}(p, begin())&&std::less<const T*>{}(p, end());
+        }
+        //moves `n` elements from `src` into raw `dst` and destroys the
+        //sources. copies instead when a move could throw, like
+        //std::move_if_noexcept, so on throw `dst` holds nothing and `src` is
+        //intact. a move-only T whose move throws can't promise that, the
+        //elements moved before the throw are left moved-from
+        inline static void _relocate(T* src, size_t n, T* dst)noexcept(Nothrow_Relocate)
+        {
+            if constexpr(Relocate_Trivially)
+            {
+                if(n)
+                    std::memcpy((void*)dst, (const void*)src, n*sizeof(T));
+                return;
+            }
+            else
+            {
+                if constexpr(std::is_nothrow_move_constructible_v<T>||
+                    !std::is_copy_constructible_v<T>)
+                    std::uninitialized_move_n(src, n, dst);
+                else
+                    std::uninitialized_copy_n(src, n, dst);
+                std::destroy_n(src, n);
+            }
+        }
+        //back to the empty inline buffer, elements must be gone already
+        inline void _unspill()noexcept
+        {
+            if(!inlined())
+                Free(_data);
+            _data=(T*)_buf;
+            _capacity=N;
+        }
+
+            /*RESERVE*/
+
+        inline opres rsvcpct(size_t newcpct)noexcept(Nothrow_Relocate)
+            requires(requires{T(std::declval<T&&>());}||
+                requires{T(std::declval<const T&>());})
+        {
+            if(newcpct<=_capacity)   //noalloc
+                return opres::SUCCESS;
+            //already spilled and malc backed, try growing without a copy
+            if constexpr(Relocate_Trivially&&same_fn<Free, &sys::rel>)
+                if(!inlined())
+                    if(T* grown=(T*)sys::regrow(_data, sizeof(T)*newcpct); grown)
+                    {
+                        _data=grown;
+                        _capacity=newcpct;
+                        return opres::SUCCESS;
+                    }
+            T* newaddr=(T*)Alloc(sizeof(T)*newcpct);
+            if(!newaddr) //Alloc fault
+                return opres::MEM_ERR;
+            if constexpr(Nothrow_Relocate)
+                _relocate(_data, _dynmsz, newaddr);
+            else try{_relocate(_data, _dynmsz, newaddr);}
+            catch(...){Free(newaddr); throw;}
+            if(!inlined())
+                Free(_data);
+            _data=newaddr;
+            _capacity=newcpct;
+            return opres::SUCCESS;
+        }
+
+            /*RESIZE*/
+
+        inline opres resize(size_t newsize)
+            noexcept(noexcept(rsvcpct(std::declval<size_t>()))&&
+                std::is_nothrow_default_constructible_v<T>)
+            requires(requires{T();})
+        {
+            if(newsize<=_dynmsz)
+            {
+                std::destroy(begin()+newsize, end());
+                _dynmsz=newsize;
+                return opres::SUCCESS;
+            }
+            if(opres res=rsvcpct(newsize); res!=opres::SUCCESS)
+                return res;
+            std::uninitialized_default_construct(end(), _data+newsize);
+            _dynmsz=newsize;
+            return opres::SUCCESS;
+        }
+        inline opres resize(size_t newsize, const T& fillval)
+            noexcept(noexcept(rsvcpct(std::declval<size_t>()))&&
+                std::is_nothrow_constructible_v<T, const T&>)
+            requires(requires{T(std::declval<const T&>());})
+        {
+            if(newsize<=_dynmsz)
+            {
+                std::destroy(begin()+newsize, end());
+                _dynmsz=newsize;
+                return opres::SUCCESS;
+            }
+            if(newsize>_capacity&&_owns(&fillval))
+            {
+                const T tmp(fillval);
+                return resize(newsize, tmp);
+            }
+            if(opres res=rsvcpct(newsize); res!=opres::SUCCESS)
+                return res;
+            std::uninitialized_fill(end(), _data+newsize, fillval);
+            _dynmsz=newsize;
+            return opres::SUCCESS;
+        }
+
+            /*COPY*/
+
+        //copy constructs [src_startidx, src_startidx+n_elements) into raw
+        //`dst`
+        template<typename U=T>
+        inline opres copyinto(U* dst, size_t n_elements, size_t src_startidx=0)const
+            noexcept(std::is_nothrow_constructible_v<U, const T&>)
+            requires(requires{U(std::declval<const T&>());})
+        {
+            assert(n_elements+src_startidx<=this->size());
+            if(n_elements+src_startidx>this->size())
+                return opres::BOUNDS_ERR;
+            if constexpr(std::is_trivially_copyable_v<T>&&std::is_same_v<T, U>)
+            {
+                if(n_elements)
+                    std::memcpy(dst, begin()+src_startidx, n_elements*sizeof(T));
+            }
+            else
+                std::uninitialized_copy_n(begin()+src_startidx, n_elements, dst);
+            return opres::SUCCESS;
+        }
+
+            /*APPEND*/
+
+        //constructs in place past the end, spills once the inline buffer is
+        //full. on throw, size is unchanged
+        template<typename...Args>
+        opres inline emplace_back(Args&&...args)
+            noexcept(noexcept(rsvcpct(std::declval<size_t>()))&&
+                std::is_nothrow_constructible_v<T, Args...>)
+            requires(requires{T(std::declval<Args>()...);})
+        {
+            if(_dynmsz==_capacity)
+            {
+                const size_t newcpct=Growth(_capacity, _dynmsz+1);
+                assert(newcpct>_dynmsz && "growth policy must make room");
+                if(opres res=rsvcpct(newcpct); res!=opres::SUCCESS)
+                    return res;
+            }
+            std::construct_at(_data+_dynmsz, std::forward<Args>(args)...);
+            ++_dynmsz;
+            return opres::SUCCESS;
+        }
+        opres inline push_back(const T& obj)
+            noexcept(noexcept(emplace_back(std::declval<const T&>())))
+            requires(requires{emplace_back(std::declval<const T&>());})
+        {
+            //obj may live in _data, which spilling would pull out from under it
+            if(_dynmsz==_capacity&&_owns(&obj))
+            {
+                const T tmp(obj);
+                return emplace_back(tmp);
+            }
+            return emplace_back(obj);
+        }
+        opres inline push_back(T&& obj)
+            noexcept(noexcept(emplace_back(std::declval<T&&>())))
+            requires(requires{emplace_back(std::declval<T&&>());})
+        {
+            if(_dynmsz==_capacity&&_owns(&obj))
+            {
+                T tmp(std::move(obj));
+                return emplace_back(std::move(tmp));
+            }
+            return emplace_back(std::move(obj));
+        }
+
+        /*DESTRUCTOR*/
+
+        ~hybrid_storage()noexcept(std::is_nothrow_destructible_v<T>)
+        {
+            std::destroy(begin(), end());
+            if(!inlined())
+                Free(_data);
+        }
+    };
+}
@@ -3,9 +3,26 @@
 #include "opres.h"
 #include "debug.h"
 
+#include <algorithm>
+#include <atomic>
+#include <bit>
 #include <cstddef>
 #include <cstdint>
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
+
+#if defined(__unix__)||defined(__APPLE__)
+#include <sys/mman.h>
+#include <unistd.h>
+#define AICO_MALC_MMAP 1
+#endif
+
+//define AICO_MALC_TRACE before including to compile in the trace hooks
+#ifdef AICO_MALC_TRACE
+#include <chrono>
+#include <mutex>
+#endif
 
 namespace aico::sys
 {
@@ -15,30 +32,149 @@ namespace aico::sys
     struct freenode_t
     {
         freenode_t* next;
+        freenode_t* prev;
+    };
+
+    //boundary tag, sits at the start of every heap block. a block spans
+    //[tag, tag+size), the user allocation starts right after the tag. blocks
+    //aligned past alignof(blktag_t) put a PADDED tag right before the user
+    //pointer instead, its prevsize is the distance back to the real tag
+    struct alignas(alignof(max_align_t)) blktag_t
+    {
+        size_t size;     //block bytes including tag, low bits hold flagbits
+        size_t prevsize; //bytes of the physically preceding block, 0 if first
+        enum flagbits:size_t
+        {
+            FREE=1<<0,
+            LISTED=1<<1,/*free block lives in heap_t::freelist, not in bins*/
+            PADDED=1<<2 /*not a block, points back to the tag of its block*/
+        };
+        static constexpr size_t FLAGMASK=alignof(max_align_t)-1;
+        //allocated blocks keep their memtag_t in the top byte of `size`
+        static constexpr unsigned TAGSHIFT=56;
+        static constexpr size_t TAGMASK=(size_t)0xff<<TAGSHIFT;
     };
+    //free blocks keep their freenode_t right after the tag
+    constexpr size_t BLOCK_MIN=sizeof(blktag_t)+sizeof(freenode_t);
+    //remainders smaller than this stay attached to the allocation
+    constexpr size_t SPLIT_MIN=4*BLOCK_MIN;
+
+    //size classes: powers of two split into quarter steps from
+    //SIZECLASS_MIN up to SIZECLASS_MAX. blocks are whole tags and at least
+    //BLOCK_MIN, so the classes in use run 32, 48, 64, 80, 96, 112, 128,
+    //160, 192, 224, 256, 320... blocks above SIZECLASS_MAX go through the
+    //first-fit freelist
+    constexpr size_t SIZECLASS_MIN=16;
+    constexpr size_t SIZECLASS_MAX=64*KB;
+    constexpr uint8_t SIZECLASSES=1+4*(std::bit_width(SIZECLASS_MAX-1)-
+        std::bit_width(SIZECLASS_MIN-1));
+    
+    //smallest class whose block size is >= bytes, bytes<=SIZECLASS_MAX
+    constexpr uint8_t sizeclass(size_t bytes)
+    {
+        if(bytes<=SIZECLASS_MIN) return 0;
+        const size_t lg=std::bit_width(bytes-1)-1; //bytes-1 in [2^lg, 2^(lg+1))
+        const size_t quarter=((bytes-1)>>(lg-2))&3;
+        return (uint8_t)((lg-std::bit_width(SIZECLASS_MIN-1))*4+quarter+1);
+    }
+    //block size of class `cls`
+    constexpr size_t classbytes(uint8_t cls)
+    {
+        if(cls==0) return SIZECLASS_MIN;
+        const size_t lg=(cls-1)/4+std::bit_width(SIZECLASS_MIN-1);
+        return ((size_t)1<<lg)+((cls-1)%4+1)*((size_t)1<<(lg-2));
+    }
+    //largest class whose block size is <= bytes, bytes>=SIZECLASS_MIN
+    constexpr uint8_t floorclass(size_t bytes)
+    {
+        const uint8_t cls=sizeclass(bytes);
+        return classbytes(cls)==bytes?cls:cls-1;
+    }
+    static_assert(classbytes(SIZECLASSES-1)==SIZECLASS_MAX);
+    static_assert(sizeclass(SIZECLASS_MAX)==SIZECLASSES-1);
+    static_assert(SIZECLASSES<=64, "heap_t::binmask holds one bit per class");
+
     struct heap_t
     {
         size_t bytes;
         void* addr;
         size_t offset=0;
         freenode_t* freelist=nullptr;
+        freenode_t* bins[SIZECLASSES]{}; //bins[c]: blocks of [classbytes(c), classbytes(c+1))
+        uint64_t binmask=0;              //bit c set iff bins[c] is non-empty
+        size_t lastblk=0;                //bytes of the block ending at offset
+        size_t touched=0;                //bump high-water since the last trim
+        
+        //only the owning thread touches the fields above. other threads hand
+        //blocks back through `remote`, a lock-free stack the owner drains
+        std::atomic<uint32_t> owner{0};
+        std::atomic<freenode_t*> remote{nullptr};
+        
+        //telemetry, written by the owner only (see stat_add), read by anyone.
+        //counts belong to the slot and survive trim() and reuse
+        std::atomic<size_t> live{0};     //bytes in allocated blocks, tags included
+        std::atomic<size_t> livepeak{0};
+        std::atomic<uint64_t> malcs{0};
+        std::atomic<uint64_t> rels{0};   //remote frees count once drained
+        enum ownerbits:uint32_t
+        {
+            UNUSED=0,             /*slot not published yet*/
+            RELEASED=UINT32_MAX-1,/*unmapped by trim(), slot can be reused*/
+            ORPHANED=UINT32_MAX   /*owner exited, up for adoption*/
+        };
     };
     constexpr size_t HEAPS_MAX=UINT8_MAX;
     inline heap_t g_heaps[HEAPS_MAX];
-    inline uint8_t g_heapsz=0;
+    inline std::atomic<uint8_t> g_heapsz=0;
+    //bytes mapped for heaps and DEDICATED blocks, changes once per mapping
+    inline std::atomic<size_t> g_reserved=0;
+    inline std::atomic<size_t> g_reservedpeak=0;
+    inline std::atomic<size_t> g_dedicated=0;      //outstanding DEDICATED blocks
+    inline std::atomic<size_t> g_dedicatedbytes=0;
 
+    //heaps are owned per thread, a thread's heaps are orphaned when it exits
+    //and adopted by the next thread that runs out of space
+    inline std::atomic<uint32_t> g_threadids=0;
+    struct threadheaps_t
+    {
+        const uint32_t id=++g_threadids;
+        uint64_t malcs=0;       //heap allocations made by this thread
+        uint64_t seen=0;        //malcs at the last trim_idle() tick
+        unsigned idle=0;        //consecutive trim_idle() ticks without a malc
+        ~threadheaps_t()
+        {
+            for(uint8_t i=0; i<g_heapsz; ++i)
+            {
+                uint32_t expected=id;
+                g_heaps[i].owner.compare_exchange_strong(expected, 
+                    heap_t::ORPHANED, std::memory_order_release);
+            }
+        }
+    };
+    inline threadheaps_t& thread_heaps()
+    {
+        thread_local threadheaps_t t;
+        return t;
+    }
+    inline uint32_t thread_id()
+    {
+        return thread_heaps().id;
+    }
+
+    //DEDICATED blocks only, heap blocks are found through the page map and
+    //their boundary tag
     struct alignas(alignof(max_align_t)) 
-        hdr_t //size:16, align:16 (64 bit)
+        hdr_t //size:32, align:16 (64 bit)
     {
         uint32_t magic=0xC0FFEE;
         size_t bytes; 
         void* base;
         uint16_t flags=0;
+        uint8_t memtag=0;
         enum flagbits:uint8_t
         {
             DEDICATED=1<<0/*big alloc*/
         };
-        uint8_t heapid;
     };
 
     inline float g_powerfactor=2.f;//consider making this a ratio of ints
@@ -49,6 +185,19 @@ namespace aico::sys
         POWER, LINEAR, CONSTANT 
     };
     inline alloc_strat g_strat=alloc_strat::POWER;
+    //NOTE: g_strat, g_fitstrat and the bump knobs are plain config, set them
+    //before other threads start allocating
+
+    enum class fit_strat: uint8_t
+    {
+        FIRST,      //linear scan of the heap freelist
+        SEGREGATED  //per size class freelists, O(1) for blocks<=SIZECLASS_MAX
+    };
+    inline fit_strat g_fitstrat=fit_strat::SEGREGATED;
+    
+    constexpr size_t HUGEPAGE=2*MB;
+    inline bool g_hugepages=false;//opt-in THP hint for heaps>=HUGEPAGE
+    inline unsigned g_autotrim=0;//idle trim_idle() ticks before trimming, 0 is off
     
     //assumes enough space after base
     inline void* align_up(void* base, size_t align)
@@ -79,41 +228,610 @@ namespace aico::sys
     {
         return num /*not 0*/ && !(num & (num - 1)) /*power of 2*/;
     }
-    //TODO most naive part of the alloctor
-    inline void* heap_fit(heap_t& h, size_t maxbytes)
+
+    /*OS*/
+
+#ifdef AICO_MALC_MMAP
+    inline size_t os_pagesize()
     {
-        //TODO consider the case where we allocate X bytes at
-        //Y alignment, then free the first allocation and make the
-        //same request again. note how that second request might never
-        //use the first allocation's space, due to the pessimistic nature
-        //of maxbytes. consider "simulating" an allocation within a certain
-        //wiggle room, (say, [userbytes, userbytes+worst_overhead])
-            freenode_t* node=h.freelist;
-        freenode_t* prev=nullptr;
-        while(node)
+        static const size_t pagesz=(size_t)sysconf(_SC_PAGESIZE);
+        return pagesz;
+    }
+    //maps zeroed pages, physical memory is only committed on first touch
+    inline void* os_map(size_t bytes, size_t align)
+    {
+        //mmap only guarantees page alignment, over-map and cut the excess
+        const size_t slack=align>os_pagesize()?align:0;
+        void* addr=mmap(nullptr, bytes+slack, PROT_READ|PROT_WRITE, 
+            MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+        if(addr==MAP_FAILED)
+            return nullptr;
+        if(!slack)
+            return addr;
+        char* aligned=(char*)align_up(addr, align);
+        const size_t head=aligned-(char*)addr;
+        if(head)
+            munmap(addr, head);
+        if(slack-head)
+            munmap(aligned+bytes, slack-head);
+        return aligned;
+    }
+    inline void os_unmap(void* addr, size_t bytes)
+    {
+        munmap(addr, bytes);
+    }
+    //gives back the pages past `keep`, both page multiples
+    inline void os_shrink(void* addr, size_t bytes, size_t keep)
+    {
+        if(keep<bytes)
+            munmap((char*)addr+keep, bytes-keep);
+    }
+    //drops the physical pages, the range stays mapped and reads back as zeroes
+    inline void os_discard(void* addr, size_t bytes)
+    {
+        madvise(addr, bytes, MADV_DONTNEED);
+    }
+    inline void os_hugepages([[maybe_unused]]void* addr, [[maybe_unused]]size_t bytes)
+    {
+#ifdef MADV_HUGEPAGE
+        madvise(addr, bytes, MADV_HUGEPAGE);
+#endif
+    }
+    //resizes a mapping in place, or moves it to a fresh `align` aligned
+    //range. nullptr if the OS can't
+    inline void* os_remap([[maybe_unused]]void* addr, [[maybe_unused]]size_t bytes, 
+        [[maybe_unused]]size_t newbytes, [[maybe_unused]]size_t align)
+    {
+#if defined(MREMAP_MAYMOVE)&&defined(MREMAP_FIXED)
+        if(void* same=mremap(addr, bytes, newbytes, 0); same!=MAP_FAILED)
+            return same;
+        void* target=os_map(newbytes, align);
+        if(!target)
+            return nullptr;
+        void* moved=mremap(addr, bytes, newbytes, MREMAP_MAYMOVE|MREMAP_FIXED, target);
+        if(moved==MAP_FAILED)
         {
-            if(hdr_t* header=gethdr(node); header)
-                if(maxbytes<=header->bytes)
-                {
-                    //not free anymore, unlink
-                    if(prev)
-                        prev->next=node->next;
-                    else
-                        h.freelist=node->next;
-                    return header->base;
-                }
-            prev=node;
-            node=node->next;
+            os_unmap(target, newbytes);
+            return nullptr;
         }
+        return moved;
+#else
+        return nullptr;
+#endif
+    }
+#else
+    //no virtual memory API, fall back to the C heap. nothing is handed back
+    //to the OS short of freeing a whole mapping
+    inline size_t os_pagesize(){return 4*KB;}
+    inline void* os_map(size_t bytes, size_t align)
+    {
+#ifdef _WIN32
+        void* addr=_aligned_malloc(bytes, align);
+#else
+        void* addr=aligned_alloc(align, (bytes+align-1)&~(align-1));
+#endif
+        return addr?memset(addr, 0, bytes):nullptr;
+    }
+    inline void os_unmap(void* addr, size_t)
+    {
+#ifdef _WIN32
+        _aligned_free(addr);
+#else
+        free(addr);
+#endif
+    }
+    inline void os_shrink(void*, size_t, size_t){}
+    inline void os_discard(void*, size_t){}
+    inline void os_hugepages(void*, size_t){}
+    inline void* os_remap(void*, size_t, size_t, size_t){return nullptr;}
+#endif
+
+    /*STATS*/
+
+    //single writer counters, a plain load+store instead of a locked RMW
+    inline void stat_add(std::atomic<size_t>& c, size_t n)
+    {
+        c.store(c.load(std::memory_order_relaxed)+n, std::memory_order_relaxed);
+    }
+    inline void stat_sub(std::atomic<size_t>& c, size_t n)
+    {
+        c.store(c.load(std::memory_order_relaxed)-n, std::memory_order_relaxed);
+    }
+    inline void stat_inc(std::atomic<uint64_t>& c, uint64_t n=1)
+    {
+        c.store(c.load(std::memory_order_relaxed)+n, std::memory_order_relaxed);
+    }
+    inline void stat_live(heap_t& h, size_t added)
+    {
+        stat_add(h.live, added);
+        if(const size_t live=h.live.load(std::memory_order_relaxed); 
+            live>h.livepeak.load(std::memory_order_relaxed))
+            h.livepeak.store(live, std::memory_order_relaxed);
+    }
+    //mappings come and go rarely, shared counters are fine here
+    inline void stat_map(size_t bytes)
+    {
+        const size_t now=g_reserved.fetch_add(bytes, std::memory_order_relaxed)+bytes;
+        size_t peak=g_reservedpeak.load(std::memory_order_relaxed);
+        while(now>peak&&!g_reservedpeak.compare_exchange_weak(peak, now, 
+            std::memory_order_relaxed));
+    }
+    inline void stat_unmap(size_t bytes)
+    {
+        g_reserved.fetch_sub(bytes, std::memory_order_relaxed);
+    }
+
+    /*TAGS*/
+
+    //allocation tags: a small subsystem id every block is charged to, taken
+    //from the thread's tag_scope unless passed explicitly. 0 is untagged and
+    //not counted, so untagged allocations skip the shared counters
+    typedef uint8_t memtag_t;
+    constexpr size_t TAGS_MAX=UINT8_MAX+1;
+    struct tagstate_t
+    {
+        std::atomic<size_t> live{0};     //block bytes, like heap_t::live
+        std::atomic<size_t> livepeak{0};
+        std::atomic<size_t> soft{0};     //budgets, 0 is unlimited
+        std::atomic<size_t> hard{0};
+        std::atomic<const char*> name{nullptr};
+    };
+    inline tagstate_t g_tags[TAGS_MAX];
+    //called on the allocating thread when a block takes its tag past the soft
+    //budget (once per crossing, `live` includes the block), or when the hard
+    //budget refuses it (`live` is what it would have been). must not
+    //allocate under the offending tag
+    typedef void(*budget_cb_t)(memtag_t tag, size_t live, size_t budget, bool hard);
+    inline std::atomic<budget_cb_t> g_budgetcb=nullptr;
+
+    inline memtag_t& bound_tag()
+    {
+        thread_local memtag_t tag=0;
+        return tag;
+    }
+    //tags the calling thread's allocations for the lifetime of the scope
+    struct tag_scope
+    {
+        memtag_t prev;
+        explicit tag_scope(memtag_t tag)noexcept:prev(bound_tag()){bound_tag()=tag;}
+        tag_scope(const tag_scope&)=delete;
+        tag_scope& operator=(const tag_scope&)=delete;
+        ~tag_scope()noexcept{bound_tag()=prev;}
+    };
+    inline void tag_name(memtag_t tag, const char* name)
+    {
+        g_tags[tag].name.store(name, std::memory_order_relaxed);
+    }
+    //allocations past `hard` fail with BUDGET_ERR, checked before the block
+    //is charged, so racing threads can overshoot by a block each
+    inline void tag_budget(memtag_t tag, size_t soft, size_t hard=0)
+    {
+        g_tags[tag].soft.store(soft, std::memory_order_relaxed);
+        g_tags[tag].hard.store(hard, std::memory_order_relaxed);
+    }
+    inline void on_budget(budget_cb_t cb)
+    {
+        g_budgetcb.store(cb, std::memory_order_release);
+    }
+    inline size_t tag_live(memtag_t tag)
+    {
+        return g_tags[tag].live.load(std::memory_order_relaxed);
+    }
+    //false if the hard budget of `tag` refuses `bytes` more
+    inline bool tag_admit(memtag_t tag, size_t bytes)
+    {
+        tagstate_t& t=g_tags[tag];
+        const size_t hard=t.hard.load(std::memory_order_relaxed);
+        if(!tag||!hard)
+            return true;
+        const size_t live=t.live.load(std::memory_order_relaxed)+bytes;
+        if(live<=hard)
+            return true;
+        if(budget_cb_t cb=g_budgetcb.load(std::memory_order_acquire))
+            cb(tag, live, hard, true);
+        return false;
+    }
+    inline void tag_charge(memtag_t tag, size_t bytes)
+    {
+        if(!tag)
+            return;
+        tagstate_t& t=g_tags[tag];
+        const size_t live=t.live.fetch_add(bytes, std::memory_order_relaxed)+bytes;
+        size_t peak=t.livepeak.load(std::memory_order_relaxed);
+        while(live>peak&&!t.livepeak.compare_exchange_weak(peak, live, 
+            std::memory_order_relaxed));
+        const size_t soft=t.soft.load(std::memory_order_relaxed);
+        if(soft&&live>soft&&live-bytes<=soft)
+            if(budget_cb_t cb=g_budgetcb.load(std::memory_order_acquire))
+                cb(tag, live, soft, false);
+    }
+    inline void tag_uncharge(memtag_t tag, size_t bytes)
+    {
+        if(tag)
+            g_tags[tag].live.fetch_sub(bytes, std::memory_order_relaxed);
+    }
+
+    /*TRACE*/
+
+    //binary trace format: one tracehdr_t, then tracerec_t records in chunks
+    //per thread. chunks of different threads interleave, sort by `ns` to get
+    //the global order
+    enum class traceop:uint8_t
+    {
+        MALC,   /*addr, bytes, alignment*/
+        REL,    /*addr*/
+        REGROW, /*addr before the call, new bytes*/
+        MOVE,   /*follows a REGROW that moved the block, addr after the call*/
+        CTR,    /*alloctr's malc*/
+        DTR     /*dtrel's rel*/
+    };
+    struct tracerec_t
+    {
+        uint64_t ns;        //since trace_begin()
+        uint64_t addr;
+        uint64_t bytes;
+        uint32_t thread;    //thread_id()
+        traceop op;
+        uint8_t alignlog2;
+        uint16_t pad=0;
+    };
+    static_assert(sizeof(tracerec_t)==32);
+    struct tracehdr_t
+    {
+        char magic[8]={'A', 'I', 'C', 'O', 'T', 'R', 'C', 0};
+        uint32_t version=1;
+        uint32_t recbytes=sizeof(tracerec_t);
+    };
+#ifdef AICO_MALC_TRACE
+    inline std::mutex g_tracemtx;      //guards g_trace
+    inline FILE* g_trace=nullptr;
+    inline std::atomic<bool> g_tracing=false;
+    inline std::atomic<uint32_t> g_tracesession=0;
+    inline std::chrono::steady_clock::time_point g_tracestart;
+
+    //records are buffered per thread and written a chunk at a time
+    struct tracebuf_t
+    {
+        static constexpr size_t RECS=512;
+        tracerec_t recs[RECS];
+        size_t n=0;
+        uint32_t session=0;     //records of an ended session are dropped
+        traceop as=traceop::MALC;
+        bool relabel=false;     //set by trace_as
+        ~tracebuf_t(){flush();}
+        inline void flush()
+        {
+            std::lock_guard lock(g_tracemtx);
+            if(g_trace&&n&&session==g_tracesession.load(std::memory_order_relaxed))
+                std::fwrite(recs, sizeof(tracerec_t), n, g_trace);
+            n=0;
+        }
+    };
+    inline tracebuf_t& trace_buf()
+    {
+        thread_local tracebuf_t b;
+        return b;
+    }
+    inline void trace_op(traceop op, const void* addr, size_t bytes=0, 
+        size_t alignment=1)
+    {
+        if(!g_tracing.load(std::memory_order_acquire))
+            return;
+        const auto now=std::chrono::steady_clock::now();
+        tracebuf_t& b=trace_buf();
+        if(const uint32_t s=g_tracesession.load(std::memory_order_relaxed); 
+            b.session!=s)
+        {
+            b.n=0;
+            b.session=s;
+        }
+        if(b.relabel&&(op==traceop::MALC||op==traceop::REL))
+        {
+            op=b.as;
+            b.relabel=false;
+        }
+        if(b.n==tracebuf_t::RECS)
+            b.flush();
+        b.recs[b.n++]={
+            .ns=(uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                now-g_tracestart).count(),
+            .addr=(uint64_t)(uintptr_t)addr, .bytes=bytes, .thread=thread_id(), 
+            .op=op, .alignlog2=(uint8_t)std::countr_zero(alignment)};
+    }
+    //relabels the calling thread's next malc or rel, used by alloctr/dtrel
+    struct trace_as
+    {
+        explicit trace_as(traceop op)noexcept
+        {
+            tracebuf_t& b=trace_buf();
+            b.as=op;
+            b.relabel=true;
+        }
+        trace_as(const trace_as&)=delete;
+        trace_as& operator=(const trace_as&)=delete;
+        ~trace_as()noexcept{trace_buf().relabel=false;}
+    };
+    //starts recording every malc, rel and regrow to `out`, which stays owned
+    //by the caller. false if a trace is already running or the header can't
+    //be written
+    inline bool trace_begin(FILE* out)
+    {
+        std::lock_guard lock(g_tracemtx);
+        const tracehdr_t hdr;
+        if(g_trace||!out||std::fwrite(&hdr, sizeof(hdr), 1, out)!=1)
+            return false;
+        g_trace=out;
+        g_tracesession.fetch_add(1, std::memory_order_relaxed);
+        g_tracestart=std::chrono::steady_clock::now();
+        g_tracing.store(true, std::memory_order_release);
+        return true;
+    }
+    //stops recording and flushes the calling thread's records. other threads
+    //flush theirs when their buffer fills up or when they exit, so join them
+    //first, whatever they still hold afterwards is dropped.
+    //false on a write error
+    inline bool trace_end()
+    {
+        g_tracing.store(false, std::memory_order_relaxed);
+        trace_buf().flush();
+        std::lock_guard lock(g_tracemtx);
+        if(!g_trace)
+            return false;
+        const bool ok=std::fflush(g_trace)==0&&!std::ferror(g_trace);
+        g_trace=nullptr;
+        return ok;
+    }
+#else
+    inline void trace_op(traceop, const void*, size_t=0, size_t=1){}
+    struct trace_as{explicit trace_as(traceop)noexcept{}};
+#endif
+
+    /*PAGEMAP*/
+
+    //ownership by address: every GRANULE of the address space maps to the
+    //heap that owns it (heap id+1), to MAP_DEDICATED, or to MAP_NONE. heaps
+    //and DEDICATED mappings are granule aligned and sized, so no granule is
+    //ever shared. two level radix over 48 bit addresses, leaves are mapped
+    //on first use and never handed back
+    constexpr size_t GRANULE=64*KB;
+    constexpr size_t MAP_ADDRBITS=48;
+    constexpr size_t MAP_LEAFBITS=16;
+    constexpr size_t MAP_ROOTBITS=MAP_ADDRBITS-MAP_LEAFBITS-(std::bit_width(GRANULE)-1);
+    constexpr uint16_t MAP_NONE=0;
+    constexpr uint16_t MAP_DEDICATED=UINT16_MAX;
+    static_assert(HEAPS_MAX<MAP_DEDICATED, "heap ids must fit the page map");
+
+    typedef std::atomic<uint16_t> mapleaf_t[(size_t)1<<MAP_LEAFBITS];
+    inline std::atomic<mapleaf_t*> g_pagemap[(size_t)1<<MAP_ROOTBITS];
+
+    inline std::atomic<uint16_t>* map_entry(const void* addr, bool create)
+    {
+        const uintptr_t granule=(uintptr_t)addr>>(std::bit_width(GRANULE)-1);
+        if(granule>>(MAP_ROOTBITS+MAP_LEAFBITS))
+            return nullptr;//outside the mapped range, can't be ours
+        std::atomic<mapleaf_t*>& root=g_pagemap[granule>>MAP_LEAFBITS];
+        mapleaf_t* leaf=root.load(std::memory_order_acquire);
+        if(!leaf&&create)
+        {
+            leaf=(mapleaf_t*)os_map(sizeof(mapleaf_t), os_pagesize());//zeroed
+            if(!leaf)
+                return nullptr;
+            mapleaf_t* expected=nullptr;
+            if(!root.compare_exchange_strong(expected, leaf, std::memory_order_acq_rel))
+            {
+                os_unmap(leaf, sizeof(mapleaf_t));
+                leaf=expected;
+            }
+        }
+        return leaf?&(*leaf)[granule&(((size_t)1<<MAP_LEAFBITS)-1)]:nullptr;
+    }
+    //tags [addr, addr+bytes) with `owner`, false if a leaf could not be mapped.
+    //entries only need to be visible to threads that get hold of a pointer
+    //into the range, which already synchronizes with this thread
+    inline bool map_set(void* addr, size_t bytes, uint16_t owner)
+    {
+        for(char* at=(char*)addr; at<(char*)addr+bytes; at+=GRANULE)
+        {
+            std::atomic<uint16_t>* entry=map_entry(at, owner!=MAP_NONE);
+            if(entry)
+                entry->store(owner, std::memory_order_relaxed);
+            else if(owner!=MAP_NONE)
+                return false;
+        }
+        return true;
+    }
+    inline uint16_t map_owner(const void* addr)
+    {
+        const std::atomic<uint16_t>* entry=map_entry(addr, false);
+        return entry?entry->load(std::memory_order_relaxed):MAP_NONE;
+    }
+
+    /*BLOCKS*/
+
+    inline size_t blksize(const blktag_t* tag)
+    {
+        return tag->size&~(blktag_t::FLAGMASK|blktag_t::TAGMASK);
+    }
+    inline memtag_t blkmemtag(const blktag_t* tag)
+    {
+        return (memtag_t)(tag->size>>blktag_t::TAGSHIFT);
+    }
+    inline freenode_t* blknode(blktag_t* tag)
+    {
+        return (freenode_t*)(tag+1);
+    }
+    inline blktag_t* nodeblk(freenode_t* node)
+    {
+        return (blktag_t*)node-1;
+    }
+    //tag of the heap block holding user pointer `usraddr`
+    inline blktag_t* usrblk(void* usraddr)
+    {
+        blktag_t* tag=(blktag_t*)usraddr-1;
+        if(tag->size&blktag_t::PADDED)
+            tag=(blktag_t*)((char*)usraddr-tag->prevsize);
+        return tag;
+    }
+    inline char* heap_end(const heap_t& h)
+    {
+        return (char*)h.addr+h.offset;
+    }
+    //list a free block. coalescing keeps free blocks apart, so callers never
+    //link a block next to another free one or at the end of the heap
+    inline void heap_link(heap_t& h, blktag_t* tag)
+    {
+        const size_t size=blksize(tag);
+        const bool binned=g_fitstrat==fit_strat::SEGREGATED&&size<=SIZECLASS_MAX;
+        freenode_t** list=&h.freelist;
+        if(binned)
+        {
+            const uint8_t cls=floorclass(size);
+            list=&h.bins[cls];
+            h.binmask|=(uint64_t)1<<cls;
+        }
+        tag->size=size|blktag_t::FREE|(binned?0:(size_t)blktag_t::LISTED);
+        freenode_t* node=blknode(tag);
+        node->prev=nullptr;
+        node->next=*list;
+        if(*list)
+            (*list)->prev=node;
+        *list=node;
+    }
+    inline void heap_unlink(heap_t& h, blktag_t* tag)
+    {
+        const size_t size=blksize(tag);
+        const bool binned=!(tag->size&blktag_t::LISTED);
+        const uint8_t cls=binned?floorclass(size):0;
+        freenode_t* node=blknode(tag);
+        if(node->prev)
+            node->prev->next=node->next;
+        else if(binned)
+            h.bins[cls]=node->next;
+        else
+            h.freelist=node->next;
+        if(node->next)
+            node->next->prev=node->prev;
+        if(binned&&!h.bins[cls])
+            h.binmask&=~((uint64_t)1<<cls);
+        tag->size=size;
+    }
+    //shrinks an unlinked block to `bytes`, relisting the tail if it is worth it
+    inline void heap_split(heap_t& h, blktag_t* tag, size_t bytes)
+    {
+        const size_t size=blksize(tag);
+        if(size-bytes<SPLIT_MIN)
+            return;
+        tag->size=bytes|(tag->size&blktag_t::TAGMASK);
+        blktag_t* rest=(blktag_t*)((char*)tag+bytes);
+        rest->size=size-bytes;
+        rest->prevsize=bytes;
+        //free blocks are never last, so rest always has a successor
+        ((blktag_t*)((char*)rest+blksize(rest)))->prevsize=blksize(rest);
+        heap_link(h, rest);
+    }
+    inline void* heap_bump(heap_t& h, size_t maxbytes)
+    {
         size_t remain=h.bytes-h.offset;
         if(remain>=maxbytes)
         {
-            void* addr=(char*)h.addr+h.offset;
+            blktag_t* tag=(blktag_t*)heap_end(h);
+            *tag={.size=maxbytes, .prevsize=h.lastblk};
             h.offset+=maxbytes;
-            return addr;
+            h.lastblk=maxbytes;
+            if(h.offset>h.touched) h.touched=h.offset;
+            return tag;
         }
         return nullptr;
     }
+    //first free block of at least `maxbytes` in the heap freelist
+    inline blktag_t* heap_first(heap_t& h, size_t maxbytes)
+    {
+        for(freenode_t* node=h.freelist; node; node=node->next)
+            if(blktag_t* tag=nodeblk(node); blksize(tag)>=maxbytes)
+                return tag;
+        return nullptr;
+    }
+    //any block of a class >= sizeclass(maxbytes) fits, O(1)
+    inline blktag_t* heap_bin(heap_t& h, size_t maxbytes)
+    {
+        const uint64_t fits=h.binmask&(~(uint64_t)0<<sizeclass(maxbytes));
+        if(!fits)
+            return nullptr;
+        return nodeblk(h.bins[std::countr_zero(fits)]);
+    }
+    //maxbytes must be a multiple of alignof(blktag_t)
+    inline void* heap_fit(heap_t& h, size_t maxbytes)
+    {
+        blktag_t* tag=nullptr;
+        if(g_fitstrat==fit_strat::SEGREGATED&&maxbytes<=SIZECLASS_MAX)
+            tag=heap_bin(h, maxbytes);
+        if(!tag)
+            tag=heap_first(h, maxbytes);
+        if(!tag)
+            return heap_bump(h, maxbytes);
+        heap_unlink(h, tag);
+        heap_split(h, tag, maxbytes);
+        return tag;
+    }
+    //returns a block to the heap, merging it with free neighbours. blocks
+    //that end up touching the bump offset are handed back to the bump region
+    inline void heap_release(heap_t& h, blktag_t* tag)
+    {
+        size_t size=blksize(tag);
+        stat_sub(h.live, size);
+        stat_inc(h.rels);
+        if(blktag_t* next=(blktag_t*)((char*)tag+size); 
+            (char*)next<heap_end(h)&&(next->size&blktag_t::FREE))
+        {
+            heap_unlink(h, next);
+            size+=blksize(next);
+        }
+        if(tag->prevsize)
+            if(blktag_t* prev=(blktag_t*)((char*)tag-tag->prevsize);
+                prev->size&blktag_t::FREE)
+            {
+                heap_unlink(h, prev);
+                size+=blksize(prev);
+                tag=prev;
+            }
+        tag->size=size;
+        if((char*)tag+size==heap_end(h))
+        {
+            h.offset-=size;
+            h.lastblk=tag->prevsize;
+            return;
+        }
+        ((blktag_t*)((char*)tag+size))->prevsize=size;
+        heap_link(h, tag);
+    }
+    //release from a thread that does not own `h`, lock-free
+    inline void heap_defer(heap_t& h, blktag_t* tag)
+    {
+        freenode_t* node=blknode(tag);
+        node->next=h.remote.load(std::memory_order_relaxed);
+        while(!h.remote.compare_exchange_weak(node->next, node, 
+            std::memory_order_release, std::memory_order_relaxed));
+    }
+    //owner only, releases everything other threads handed back
+    inline void heap_drain(heap_t& h)
+    {
+        if(!h.remote.load(std::memory_order_relaxed))
+            return;
+        freenode_t* node=h.remote.exchange(nullptr, std::memory_order_acquire);
+        while(node)
+        {
+            freenode_t* next=node->next;
+            heap_release(h, nodeblk(node));
+            node=next;
+        }
+    }
+    //claims an orphaned heap for the calling thread
+    inline bool heap_adopt(heap_t& h)
+    {
+        uint32_t expected=heap_t::ORPHANED;
+        return h.owner.compare_exchange_strong(expected, thread_id(), 
+            std::memory_order_acquire);
+    }
     inline size_t grow(size_t base_size)
     {
         size_t bytes=0;
@@ -131,20 +849,204 @@ namespace aico::sys
         }
         return bytes;
     }
+    //returns a heap owned by the calling thread
     [[nodiscard]]inline heap_t* alloc_heap(size_t bytes) //page aligned
     {
-        //HACK assume 4096, sane default on x86, also technically UB cast
-        size_t page_aligned=(uintptr_t)align_up((void*)bytes, 4*KB);
-        void* addr=malloc(page_aligned);
-        if(addr)
+        const bool huge=g_hugepages&&bytes>=HUGEPAGE;
+        const size_t align=std::max(huge?HUGEPAGE:os_pagesize(), GRANULE);
+        //technically UB cast
+        const size_t page_aligned=(uintptr_t)align_up((void*)bytes, align);
+        void* addr=os_map(page_aligned, align);
+        if(!addr)
+            return nullptr;
+        if(huge)
+            os_hugepages(addr, page_aligned);
+        stat_map(page_aligned);
+        
+        const uint32_t me=thread_id();
+        heap_t* h=nullptr;
+        for(uint8_t i=0, n=g_heapsz; i<n&&!h; ++i)//recycle slots trim() freed
+        {
+            uint32_t expected=heap_t::RELEASED;
+            if(g_heaps[i].owner.compare_exchange_strong(expected, me, 
+                std::memory_order_acquire))
+                h=&g_heaps[i];
+        }
+        if(!h)
+        {
+            uint8_t idx=g_heapsz.load(std::memory_order_relaxed);
+            do
+            {
+                if(idx>=HEAPS_MAX)
+                {
+                    os_unmap(addr, page_aligned);
+                    stat_unmap(page_aligned);
+                    return nullptr;
+                }
+            }while(!g_heapsz.compare_exchange_weak(idx, idx+1, 
+                std::memory_order_relaxed));
+            h=&g_heaps[idx];
+        }
+        if(!map_set(addr, page_aligned, (uint16_t)(h-g_heaps+1)))
         {
-            g_heaps[g_heapsz++]={.bytes=page_aligned, .addr=addr, .offset=0, 
-                .freelist=nullptr};
-            return &g_heaps[g_heapsz-1];
+            map_set(addr, page_aligned, MAP_NONE);
+            os_unmap(addr, page_aligned);
+            stat_unmap(page_aligned);
+            h->addr=nullptr;
+            h->bytes=0;
+            h->owner.store(heap_t::RELEASED, std::memory_order_release);
+            return nullptr;
         }
-        else return nullptr;
+        h->bytes=page_aligned;
+        h->addr=addr;
+        h->offset=0;
+        h->lastblk=0;
+        h->touched=0;
+        h->freelist=nullptr;
+        h->binmask=0;
+        std::fill_n(h->bins, SIZECLASSES, nullptr);
+        h->owner.store(me, std::memory_order_release);//publish
+        return h;
     }
-    inline void* malc(size_t bytes, size_t alignment=alignof(hdr_t), opres* res=nullptr)
+    //hands fully free heaps back to the OS and drops the pages under free
+    //blocks and stale bump space. sees the heaps of the calling thread only,
+    //orphaned heaps are adopted first.
+    //returns the number of bytes unmapped or discarded
+    inline size_t trim()
+    {
+        const uint32_t me=thread_id();
+        const size_t page=os_pagesize();
+        size_t released=0;
+        auto discard=[&](void* from, void* to)
+        {
+            from=align_up(from, page);
+            to=align_down(to, page);
+            if(from<to)
+            {
+                os_discard(from, (char*)to-(char*)from);
+                released+=(char*)to-(char*)from;
+            }
+        };
+        for(uint8_t i=0, n=g_heapsz; i<n; ++i)
+        {
+            heap_t& h=g_heaps[i];
+            const uint32_t owner=h.owner.load(std::memory_order_acquire);
+            if(!(owner==me||(owner==heap_t::ORPHANED&&heap_adopt(h))))
+                continue;
+            heap_drain(h);
+            //no live blocks left means no one can push to `remote` either
+            if(h.offset==0)
+            {
+                map_set(h.addr, h.bytes, MAP_NONE);
+                os_unmap(h.addr, h.bytes);
+                stat_unmap(h.bytes);
+                released+=h.bytes;
+                h.addr=nullptr;
+                h.bytes=0;
+                h.owner.store(heap_t::RELEASED, std::memory_order_release);
+                continue;
+            }
+            discard(heap_end(h), (char*)h.addr+h.touched);
+            h.touched=h.offset;
+            //free block interiors, tags and nodes stay resident
+            auto blocks=[&](freenode_t* node)
+            {
+                for(; node; node=node->next)
+                {
+                    blktag_t* tag=nodeblk(node);
+                    discard((char*)tag+BLOCK_MIN, (char*)tag+blksize(tag));
+                }
+            };
+            blocks(h.freelist);
+            for(uint64_t mask=h.binmask; mask; mask&=mask-1)
+                blocks(h.bins[std::countr_zero(mask)]);
+        }
+        return released;
+    }
+    //call this from idle points (e.g. once per frame), trims once the calling
+    //thread went g_autotrim ticks without allocating. no-op while g_autotrim=0
+    inline size_t trim_idle()
+    {
+        threadheaps_t& t=thread_heaps();
+        if(!g_autotrim)
+            return 0;
+        if(t.malcs!=t.seen)
+        {
+            t.seen=t.malcs;
+            t.idle=0;
+            return 0;
+        }
+        if(t.idle<g_autotrim&&++t.idle==g_autotrim)
+            return trim();
+        return 0;
+    }
+    //heap blocks are headerless, the tag is all the overhead unless the
+    //alignment asks for padding (which then ends in a PADDED tag)
+    inline size_t heap_blkbytes(size_t bytes, size_t alignment)
+    {
+        const size_t padding=alignment>alignof(blktag_t)?
+            alignment-alignof(blktag_t):0;
+        size_t blockbytes=(uintptr_t)align_up((void*)(bytes+padding+
+            sizeof(blktag_t)), alignof(blktag_t));
+        if(g_fitstrat==fit_strat::SEGREGATED&&blockbytes<=SIZECLASS_MAX)
+            blockbytes=classbytes(sizeclass(blockbytes));
+        return blockbytes;
+    }
+    //user pointer of a fresh block, writes the PADDED tag if there is padding
+    inline void* blkusr(blktag_t* tag, size_t alignment)
+    {
+        void* usr_aligned=align_up((char*)tag+sizeof(blktag_t), alignment);
+        if(usr_aligned!=(char*)tag+sizeof(blktag_t))
+            *((blktag_t*)usr_aligned-1)={.size=blktag_t::PADDED, 
+                .prevsize=(size_t)((char*)usr_aligned-(char*)tag)};
+        return usr_aligned;
+    }
+    //an unlisted block of at least `blockbytes` from the calling thread's
+    //heaps, then from orphaned ones, then from a new heap sized for `bytes`
+    inline blktag_t* heap_take(size_t blockbytes, size_t bytes, uint8_t& heapid,
+        opres* res)
+    {
+        const uint32_t me=thread_id();
+        void* base=nullptr;
+        size_t lastbytes=0;//this thread's newest heap, drives growth
+        for(uint8_t i=0, n=g_heapsz; i<n&&!base; ++i)
+        {
+            heap_t& h=g_heaps[i];
+            if(h.owner.load(std::memory_order_acquire)!=me)
+                continue;
+            heap_drain(h);
+            lastbytes=h.bytes;
+            if((base=heap_fit(h, blockbytes))) heapid=i;
+        }
+        for(uint8_t i=0, n=g_heapsz; i<n&&!base; ++i)
+        {
+            heap_t& h=g_heaps[i];
+            if(h.owner.load(std::memory_order_relaxed)!=heap_t::ORPHANED||
+                !heap_adopt(h))
+                continue;
+            heap_drain(h);
+            if((base=heap_fit(h, blockbytes))) heapid=i;
+        }
+        if(!base)
+        {
+            //no heap fits, allocate new heap. with every slot taken
+            //alloc_heap can still recycle one trim() released
+            size_t next_size=lastbytes==0?/*default init*/2*MB:grow(lastbytes);
+            while(bytes>=next_size/3)//heuristic, measure later
+                next_size=grow(next_size);
+            heap_t* h=alloc_heap(next_size);
+            if(!h)
+            {
+                if(res) *res=g_heapsz>=HEAPS_MAX?opres::NO_HEAPS:opres::MEM_ERR;
+                return nullptr;
+            }
+            base=heap_bump(*h, blockbytes);
+            heapid=(uint8_t)(h-g_heaps);
+        }
+        return (blktag_t*)base;
+    }
+    inline void* malc(size_t bytes, size_t alignment=alignof(hdr_t), opres* res=nullptr,
+        memtag_t memtag=bound_tag())
     {
         if(!is_pow2(alignment)||(alignment<alignof(void*)))
         {
@@ -153,17 +1055,25 @@ namespace aico::sys
             return nullptr;
         }
         if(bytes<sizeof(freenode_t)) bytes=sizeof(freenode_t);
-        //worst case, user pointer can end up in
-        //base+(sizeof(hdr)+alignof(hdr-1))+(alignment-1), +1 makes sure this case 
-        //lands at a valid address
-        const size_t worst_overhead=sizeof(hdr_t)+(alignof(hdr_t)-1)+(alignment-1)+1;
-        const size_t hdr_buffer=sizeof(hdr_t)+(alignof(hdr_t)-1);
         const bool largealloc=bytes>=64*MB;//heuristic
         const bool badalloc=g_strat==alloc_strat::CONSTANT&&
             bytes>g_constantbump;//dumbass
         if(largealloc||badalloc)//handle tyrant allocs 
         {
-            void*addr=malloc(bytes+worst_overhead);
+            //worst case, user pointer can end up in
+            //base+(sizeof(hdr)+alignof(hdr-1))+(alignment-1), +1 makes sure this
+            //case lands at a valid address
+            const size_t worst_overhead=sizeof(hdr_t)+(alignof(hdr_t)-1)+
+                (alignment-1)+1;
+            const size_t hdr_buffer=sizeof(hdr_t)+(alignof(hdr_t)-1);
+            const size_t mapped=(uintptr_t)align_up((void*)(bytes+worst_overhead),
+                GRANULE);
+            if(!tag_admit(memtag, mapped))
+            {
+                if(res) *res=opres::BUDGET_ERR;
+                return nullptr;
+            }
+            void*addr=os_map(mapped, GRANULE);
             if(!addr) 
             {
                 if(res) *res=opres::MEM_ERR;
@@ -172,65 +1082,488 @@ namespace aico::sys
             void* aligned=align_up((char*)addr+hdr_buffer, alignment);
             *(header_addr(aligned))={.magic=0xC0FFEE, 
                 .bytes=bytes+((char*)aligned-(char*)addr), 
-                .base=addr, .flags=hdr_t::DEDICATED, .heapid=0};
+                .base=addr, .flags=hdr_t::DEDICATED, .memtag=memtag};
+            //keep exactly the granules rel() will unmap
+            const size_t kept=(uintptr_t)align_up((void*)header_addr(aligned)->bytes, 
+                GRANULE);
+            os_shrink(addr, mapped, kept);
+            if(!map_set(addr, kept, MAP_DEDICATED))
+            {
+                map_set(addr, kept, MAP_NONE);
+                os_unmap(addr, kept);
+                if(res) *res=opres::MEM_ERR;
+                return nullptr;
+            }
+            stat_map(kept);
+            g_dedicated.fetch_add(1, std::memory_order_relaxed);
+            g_dedicatedbytes.fetch_add(kept, std::memory_order_relaxed);
+            tag_charge(memtag, kept);
+            trace_op(traceop::MALC, aligned, bytes, alignment);
             if(res) *res=opres::SUCCESS;
             return aligned;
         }
-        for(uint8_t i=0; i<g_heapsz; ++i)
+        const size_t blockbytes=heap_blkbytes(bytes, alignment);
+        if(!tag_admit(memtag, blockbytes))
         {
-            heap_t& h=g_heaps[i];
-            void* base=heap_fit(h, bytes+worst_overhead);
-            if(!base)
+            if(res) *res=opres::BUDGET_ERR;
+            return nullptr;
+        }
+        ++thread_heaps().malcs;
+        uint8_t heapid;
+        blktag_t* tag=heap_take(blockbytes, bytes, heapid, res);
+        if(!tag)
+            return nullptr;
+        tag->size|=(size_t)memtag<<blktag_t::TAGSHIFT;
+        stat_live(g_heaps[heapid], blksize(tag));
+        stat_inc(g_heaps[heapid].malcs);
+        tag_charge(memtag, blksize(tag));
+        void* usr_aligned=blkusr(tag, alignment);
+        trace_op(traceop::MALC, usr_aligned, bytes, alignment);
+        if(res) *res=opres::SUCCESS;
+        return usr_aligned;
+    }
+    //`usraddr` must be live, releasing a block twice is undefined: once
+    //freed its tag may be merged into a neighbour or the bump region
+    inline void rel(void* usraddr)noexcept
+    {
+        const uint16_t owner=map_owner(usraddr);
+        if(owner==MAP_NONE) return; //not from malc, can't do shit
+        if(owner==MAP_DEDICATED)
+        {
+            hdr_t* hdr=gethdr(usraddr);
+            if(!hdr) return; //points into the block, not at it
+            trace_op(traceop::REL, usraddr);
+            const size_t mapped=(uintptr_t)align_up((void*)hdr->bytes, GRANULE);
+            void* base=hdr->base;
+            tag_uncharge(hdr->memtag, mapped);
+            hdr->magic=0;
+            map_set(base, mapped, MAP_NONE);
+            os_unmap(base, mapped);
+            stat_unmap(mapped);
+            g_dedicated.fetch_sub(1, std::memory_order_relaxed);
+            g_dedicatedbytes.fetch_sub(mapped, std::memory_order_relaxed);
+            return;
+        }
+        heap_t& h=g_heaps[owner-1];
+        blktag_t* tag=usrblk(usraddr);
+        //only the owner can hand the heap to someone else, so a match is stable
+        if(h.owner.load(std::memory_order_relaxed)==thread_id())
+        {
+            trace_op(traceop::REL, usraddr);
+            tag_uncharge(blkmemtag(tag), blksize(tag));
+            heap_release(h, tag);
+        }
+        else
+        {
+            trace_op(traceop::REL, usraddr);
+            tag_uncharge(blkmemtag(tag), blksize(tag));
+            heap_defer(h, tag);
+        }
+    }
+    //rel() for `count` pointers. runs of blocks that sit next to each other
+    //in the same heap, in order, are released as one block, e.g. what
+    //malc_n() hands out
+    inline void rel_n(void* const* ptrs, size_t count)noexcept
+    {
+        const uint32_t me=thread_id();
+        for(size_t i=0; i<count; ++i)
+        {
+            void* usraddr=ptrs[i];
+            const uint16_t owner=map_owner(usraddr);
+            if(owner==MAP_NONE||owner==MAP_DEDICATED||
+                g_heaps[owner-1].owner.load(std::memory_order_relaxed)!=me)
+            {
+                rel(usraddr);
                 continue;
-            void* usr_aligned=align_up((char*)base+hdr_buffer, alignment);
-            *(header_addr(usr_aligned))={.magic=0xC0FFEE, 
-                .bytes=bytes+((char*)usr_aligned-(char*)base),
-                .base=base, .flags=0, .heapid=i};
+            }
+            heap_t& h=g_heaps[owner-1];
+            blktag_t* tag=usrblk(usraddr);
+            trace_op(traceop::REL, usraddr);
+            tag_uncharge(blkmemtag(tag), blksize(tag));
+            size_t size=blksize(tag);
+            uint64_t n=1;
+            for(; i+1<count; ++i, ++n)
+            {
+                void* nextaddr=ptrs[i+1];
+                blktag_t* next=(blktag_t*)((char*)tag+size);
+                if((char*)next>=heap_end(h)||map_owner(nextaddr)!=owner||
+                    usrblk(nextaddr)!=next||(next->size&blktag_t::FREE))
+                    break;
+                trace_op(traceop::REL, nextaddr);
+                tag_uncharge(blkmemtag(next), blksize(next));
+                size+=blksize(next);
+            }
+            tag->size=size;
+            heap_release(h, tag);
+            stat_inc(h.rels, n-1);
+        }
+    }
+    //largest run malc_n() carves out of a single heap block
+    constexpr size_t BATCH_RUN=1*MB;
+    //`count` blocks of `bytes` each, written to `out`. blocks are carved out
+    //of runs of up to BATCH_RUN bytes, one heap lookup per run, and are
+    //released one by one with rel() or together with rel_n().
+    //all or nothing, nothing stays allocated on failure
+    inline opres malc_n(size_t count, size_t bytes, size_t alignment, void** out,
+        memtag_t memtag=bound_tag())
+    {
+        if(!is_pow2(alignment)||(alignment<alignof(void*)))
+            return opres::ALIGN_ERR;
+        if(bytes<sizeof(freenode_t)) bytes=sizeof(freenode_t);
+        if(bytes>=64*MB||(g_strat==alloc_strat::CONSTANT&&bytes>g_constantbump))
+        {
+            //DEDICATED, one mapping per block anyway
+            for(size_t i=0; i<count; ++i)
+            {
+                opres res;
+                if(!(out[i]=malc(bytes, alignment, &res, memtag)))
+                {
+                    rel_n(out, i);
+                    return res;
+                }
+            }
+            return opres::SUCCESS;
+        }
+        const size_t blockbytes=heap_blkbytes(bytes, alignment);
+        const size_t perrun=std::max<size_t>(1, BATCH_RUN/blockbytes);
+        thread_heaps().malcs+=count;
+        for(size_t done=0; done<count;)
+        {
+            const size_t n=std::min(perrun, count-done);
+            if(!tag_admit(memtag, n*blockbytes))
+            {
+                rel_n(out, done);
+                return opres::BUDGET_ERR;
+            }
+            uint8_t heapid;
+            opres res=opres::SUCCESS;
+            blktag_t* tag=heap_take(n*blockbytes, n*blockbytes, heapid, &res);
+            if(!tag)
+            {
+                rel_n(out, done);
+                return res;
+            }
+            heap_t& h=g_heaps[heapid];
+            const size_t runbytes=blksize(tag);
+            //the last block keeps whatever the run has left over
+            const size_t lastbytes=runbytes-(n-1)*blockbytes;
+            size_t prevsize=tag->prevsize;
+            for(size_t i=0; i<n; ++i)
+            {
+                const size_t size=i+1<n?blockbytes:lastbytes;
+                *tag={.size=size|(size_t)memtag<<blktag_t::TAGSHIFT, 
+                    .prevsize=prevsize};
+                out[done+i]=blkusr(tag, alignment);
+                trace_op(traceop::MALC, out[done+i], bytes, alignment);
+                prevsize=size;
+                tag=(blktag_t*)((char*)tag+size);
+            }
+            if((char*)tag==heap_end(h))
+                h.lastblk=lastbytes;
+            else
+                tag->prevsize=lastbytes;
+            stat_live(h, runbytes);
+            stat_inc(h.malcs, n);
+            tag_charge(memtag, runbytes);
+            done+=n;
+        }
+        return opres::SUCCESS;
+    }
+    //what the page map and the block know about a live allocation
+    struct blkinfo_t
+    {
+        void* base;      //block tag, or mapping start for DEDICATED blocks
+        size_t bytes;    //usable bytes from the user pointer on
+        uint16_t owner;  //heap id+1, or MAP_DEDICATED
+        memtag_t memtag;
+    };
+    //false if `usraddr` isn't a live malc pointer as far as can be told
+    inline bool blkinfo(void* usraddr, blkinfo_t* info)
+    {
+        const uint16_t owner=map_owner(usraddr);
+        if(owner==MAP_NONE)
+            return false;
+        if(owner==MAP_DEDICATED)
+        {
+            hdr_t* hdr=gethdr(usraddr);
+            if(!hdr)
+                return false;
+            const size_t lead=(char*)usraddr-(char*)hdr->base;
+            *info={.base=hdr->base, .bytes=(uintptr_t)align_up((void*)hdr->bytes, 
+                GRANULE)-lead, .owner=owner, .memtag=hdr->memtag};
+            return true;
+        }
+        blktag_t* tag=usrblk(usraddr);
+        if(tag->size&blktag_t::FREE)
+            return false;
+        *info={.base=tag, .bytes=blksize(tag)-((char*)usraddr-(char*)tag), 
+            .owner=owner, .memtag=blkmemtag(tag)};
+        return true;
+    }
+    //grows (or shrinks) an allocation without copying it. heap blocks extend
+    //into a free successor or into the bump region when they are the last 
+    //block of their heap, DEDICATED blocks are remapped and may move.
+    //returns the (possibly moved) user pointer, or nullptr if the block can't
+    //grow in place, in which case it is left untouched
+    inline void* regrow(void* usraddr, size_t newbytes, opres* res=nullptr)
+    {
+        const uint16_t owner=map_owner(usraddr);
+        hdr_t* hdr=owner==MAP_DEDICATED?gethdr(usraddr):nullptr;
+        if(owner==MAP_NONE||(owner==MAP_DEDICATED&&!hdr))
+        {
+            if(res) *res=opres::FAILURE;
+            return nullptr;
+        }
+        if(hdr)
+        {
+            const size_t lead=(char*)usraddr-(char*)hdr->base;//header, padding
+            const size_t mapped=(uintptr_t)align_up((void*)hdr->bytes, GRANULE);
+            const size_t needed=(uintptr_t)align_up((void*)(lead+newbytes), GRANULE);
+            void* const oldbase=hdr->base;
+            void* base=oldbase;
+            const memtag_t memtag=hdr->memtag;//hdr moves along with a remap
+            if(needed>mapped&&!tag_admit(memtag, needed-mapped))
+            {
+                if(res) *res=opres::BUDGET_ERR;
+                return nullptr;
+            }
+            if(needed!=mapped)
+            {
+                if(!(base=os_remap(oldbase, mapped, needed, GRANULE)))
+                {
+                    if(res) *res=opres::MEM_ERR;
+                    return nullptr;
+                }
+                //a leaf failing to map here leaves the block untracked, rel()
+                //then ignores it
+                if(base!=oldbase)
+                {
+                    map_set(oldbase, mapped, MAP_NONE);
+                    map_set(base, needed, MAP_DEDICATED);
+                }
+                else if(needed<mapped)
+                    map_set((char*)base+needed, mapped-needed, MAP_NONE);
+                else
+                    map_set((char*)base+mapped, needed-mapped, MAP_DEDICATED);
+            }
+            if(needed>mapped)
+            {
+                stat_map(needed-mapped);
+                g_dedicatedbytes.fetch_add(needed-mapped, std::memory_order_relaxed);
+                tag_charge(memtag, needed-mapped);
+            }
+            else
+            {
+                stat_unmap(mapped-needed);
+                g_dedicatedbytes.fetch_sub(mapped-needed, std::memory_order_relaxed);
+                tag_uncharge(memtag, mapped-needed);
+            }
+            trace_op(traceop::REGROW, usraddr, newbytes);
+            usraddr=(char*)base+lead;//the header moved along with the data
+            if(base!=oldbase)
+                trace_op(traceop::MOVE, usraddr);
+            header_addr(usraddr)->base=base;
+            header_addr(usraddr)->bytes=lead+newbytes;
             if(res) *res=opres::SUCCESS;
-            return usr_aligned;
+            return usraddr;
         }
-        //no heap fits, allocate new heap
-        if(g_heapsz>=HEAPS_MAX)
+        heap_t& h=g_heaps[owner-1];
+        blktag_t* tag=usrblk(usraddr);
+        const size_t lead=(char*)usraddr-(char*)tag;//tag, padding
+        if(h.owner.load(std::memory_order_relaxed)!=thread_id())
         {
-            if(res) *res=opres::NO_HEAPS;
+            if(res) *res=opres::FAILURE;//only the owner may reshape its heap
             return nullptr;
         }
-        size_t next_size=g_heapsz==0?/*default init*/2*MB:
-            grow(g_heaps[g_heapsz-1].bytes);
-        while(bytes>=next_size/3)//heuristic, measure later
-            next_size=grow(next_size);
-        heap_t* h=alloc_heap(next_size);
-        if(!h)
+        const size_t size=blksize(tag);
+        const size_t needed=(uintptr_t)align_up((void*)(lead+newbytes), 
+            alignof(blktag_t));
+        const memtag_t memtag=blkmemtag(tag);
+        if(needed>size&&!tag_admit(memtag, needed-size))
         {
-            if(res) *res=opres::MEM_ERR;
+            if(res) *res=opres::BUDGET_ERR;
             return nullptr;
         }
-        void* base=heap_fit(*h, bytes+worst_overhead);
-        void* usr_aligned=align_up((char*)base+hdr_buffer, alignment);
-        *(header_addr(usr_aligned))={.magic=0xC0FFEE, 
-            .bytes=bytes+((char*)usr_aligned-(char*)base), 
-            .base=base, .flags=0, .heapid=(uint8_t)(g_heapsz-1)};
+        if(needed>size)
+        {
+            blktag_t* next=(blktag_t*)((char*)tag+size);
+            if((char*)next==heap_end(h))//last block, bump further
+            {
+                if(h.bytes-h.offset<needed-size)
+                {
+                    if(res) *res=opres::MEM_ERR;
+                    return nullptr;
+                }
+                tag->size=needed|(size_t)memtag<<blktag_t::TAGSHIFT;
+                h.offset+=needed-size;
+                h.lastblk=needed;
+                if(h.offset>h.touched) h.touched=h.offset;
+            }
+            else if((next->size&blktag_t::FREE)&&size+blksize(next)>=needed)
+            {
+                heap_unlink(h, next);
+                tag->size=(size+blksize(next))|(size_t)memtag<<blktag_t::TAGSHIFT;
+                ((blktag_t*)((char*)tag+blksize(tag)))->prevsize=blksize(tag);
+                heap_split(h, tag, needed);
+            }
+            else
+            {
+                if(res) *res=opres::MEM_ERR;
+                return nullptr;
+            }
+            stat_live(h, blksize(tag)-size);
+            tag_charge(memtag, blksize(tag)-size);
+        }
+        trace_op(traceop::REGROW, usraddr, newbytes);
         if(res) *res=opres::SUCCESS;
-        return usr_aligned;
+        return usraddr;
     }
-    inline void rel(void* usraddr)noexcept
+
+    /*TELEMETRY*/
+
+    struct heapstats_t
     {
-        hdr_t* hdr=gethdr(usraddr);
-        if(!hdr) return; //invalid address, can't do shit
-        if(hdr->flags&hdr_t::DEDICATED)
+        uint8_t id;
+        uint32_t owner;        //thread id or a heap_t::ownerbits sentinel
+        size_t reserved;       //bytes mapped
+        size_t live;           //bytes in allocated blocks, tags included
+        size_t livepeak;
+        uint64_t malcs, rels;
+        //free block census, only filled in for the calling thread's heaps
+        bool walked;
+        size_t freeblocks, freebytes;
+    };
+    struct tagstats_t
+    {
+        memtag_t tag;
+        const char* name;      //nullptr if unnamed
+        size_t live, livepeak;
+        size_t soft, hard;
+    };
+    struct malcstats_t
+    {
+        size_t reserved;       //heaps and DEDICATED blocks
+        size_t reservedpeak;   //high-water of `reserved`
+        size_t live;           //sum of heap live bytes
+        uint64_t malcs, rels;  //heap allocations, DEDICATED ones are not counted
+        size_t dedicated;      //outstanding DEDICATED blocks
+        size_t dedicatedbytes;
+        //free list lengths over walked heaps, by bin and for the large freelist
+        uint32_t binlens[SIZECLASSES];
+        uint32_t listlen;
+        size_t listbytes;
+        uint8_t heapsz;
+        heapstats_t heaps[HEAPS_MAX];
+        //tags that are named, budgeted or were ever charged
+        uint16_t tagsz;
+        tagstats_t tags[TAGS_MAX];
+    };
+
+    //snapshot of the allocator counters. counters are relaxed reads of values
+    //other threads keep updating, so totals are approximate under load.
+    //free lists are walked for the calling thread's heaps only, other heaps
+    //belong to threads that may be relinking them
+    inline malcstats_t malc_stats()
+    {
+        malcstats_t st{};
+        const uint32_t me=thread_id();
+        st.reserved=g_reserved.load(std::memory_order_relaxed);
+        st.reservedpeak=g_reservedpeak.load(std::memory_order_relaxed);
+        st.dedicated=g_dedicated.load(std::memory_order_relaxed);
+        st.dedicatedbytes=g_dedicatedbytes.load(std::memory_order_relaxed);
+        st.heapsz=g_heapsz.load(std::memory_order_acquire);
+        for(uint8_t i=0; i<st.heapsz; ++i)
         {
-            free(hdr->base);
-            return;
+            heap_t& h=g_heaps[i];
+            heapstats_t& hs=st.heaps[i];
+            hs.id=i;
+            hs.owner=h.owner.load(std::memory_order_acquire);
+            hs.live=h.live.load(std::memory_order_relaxed);
+            hs.livepeak=h.livepeak.load(std::memory_order_relaxed);
+            hs.malcs=h.malcs.load(std::memory_order_relaxed);
+            hs.rels=h.rels.load(std::memory_order_relaxed);
+            st.live+=hs.live;
+            st.malcs+=hs.malcs;
+            st.rels+=hs.rels;
+            if(hs.owner!=me)
+                continue;
+            hs.reserved=h.bytes;
+            hs.walked=true;
+            auto count=[&](freenode_t* node, uint32_t& len)
+            {
+                for(; node; node=node->next, ++len)
+                {
+                    ++hs.freeblocks;
+                    hs.freebytes+=blksize(nodeblk(node));
+                }
+            };
+            for(uint64_t mask=h.binmask; mask; mask&=mask-1)
+            {
+                const uint8_t cls=(uint8_t)std::countr_zero(mask);
+                count(h.bins[cls], st.binlens[cls]);
+            }
+            const size_t bytes=hs.freebytes;
+            count(h.freelist, st.listlen);
+            st.listbytes+=hs.freebytes-bytes;
         }
-        auto& heap=g_heaps[hdr->heapid];
-
-        freenode_t* node=(freenode_t*)usraddr;
-        node->next=heap.freelist;
-        heap.freelist=node;
+        for(size_t i=1; i<TAGS_MAX; ++i)
+        {
+            const tagstate_t& t=g_tags[i];
+            const tagstats_t ts{.tag=(memtag_t)i, 
+                .name=t.name.load(std::memory_order_relaxed),
+                .live=t.live.load(std::memory_order_relaxed),
+                .livepeak=t.livepeak.load(std::memory_order_relaxed),
+                .soft=t.soft.load(std::memory_order_relaxed),
+                .hard=t.hard.load(std::memory_order_relaxed)};
+            if(ts.name||ts.livepeak||ts.soft||ts.hard)
+                st.tags[st.tagsz++]=ts;
+        }
+        return st;
+    }
+    //writes `st` as one JSON object, returns false on a write error
+    inline bool malc_stats_json(const malcstats_t& st, FILE* out)
+    {
+        int err=0;
+        auto put=[&](int n){if(n<0) err=1;};
+        put(fprintf(out, "{\"reserved\":%zu,\"reserved_peak\":%zu,\"live\":%zu,"
+            "\"malcs\":%llu,\"rels\":%llu,\"dedicated\":%zu,"
+            "\"dedicated_bytes\":%zu,\"freelist\":{\"len\":%u,\"bytes\":%zu},",
+            st.reserved, st.reservedpeak, st.live, (unsigned long long)st.malcs,
+            (unsigned long long)st.rels, st.dedicated, st.dedicatedbytes,
+            st.listlen, st.listbytes));
+        put(fprintf(out, "\"bins\":["));
+        bool first=true;
+        for(uint8_t c=0; c<SIZECLASSES; ++c)
+            if(st.binlens[c])
+            {
+                put(fprintf(out, "%s{\"size\":%zu,\"len\":%u}", first?"":",", 
+                    classbytes(c), st.binlens[c]));
+                first=false;
+            }
+        put(fprintf(out, "],\"heaps\":["));
+        for(uint8_t i=0; i<st.heapsz; ++i)
+        {
+            const heapstats_t& hs=st.heaps[i];
+            put(fprintf(out, "%s{\"id\":%u,\"owner\":%u,\"live\":%zu,"
+                "\"live_peak\":%zu,\"malcs\":%llu,\"rels\":%llu", i?",":"", 
+                (unsigned)hs.id, hs.owner, hs.live, hs.livepeak, 
+                (unsigned long long)hs.malcs, (unsigned long long)hs.rels));
+            if(hs.walked)
+                put(fprintf(out, ",\"reserved\":%zu,\"free_blocks\":%zu,"
+                    "\"free_bytes\":%zu", hs.reserved, hs.freeblocks, hs.freebytes));
+            put(fprintf(out, "}"));
+        }
+        put(fprintf(out, "],\"tags\":["));
+        for(uint16_t i=0; i<st.tagsz; ++i)
+        {
+            const tagstats_t& ts=st.tags[i];
+            put(fprintf(out, "%s{\"tag\":%u,", i?",":"", (unsigned)ts.tag));
+            if(ts.name)//names are code literals, not escaped
+                put(fprintf(out, "\"name\":\"%s\",", ts.name));
+            put(fprintf(out, "\"live\":%zu,\"live_peak\":%zu,\"soft\":%zu,"
+                "\"hard\":%zu}", ts.live, ts.livepeak, ts.soft, ts.hard));
+        }
+        put(fprintf(out, "]}\n"));
+        return !err;
     }
 }
-
-
-
-
-
@@ -0,0 +1,240 @@
+#pragma once
+
+#include "malc.h"
+#include "opres.h"
+#include "view.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <type_traits>
+#include <utility>
+
+#ifdef AICO_MALC_MMAP
+#include <fcntl.h>
+#include <sys/stat.h>
+#endif
+
+namespace aico
+{
+    //how the pages of a mapping will be touched
+    enum class map_hint : uint8_t
+    {
+        NORMAL,
+        SEQUENTIAL, //read ahead aggressively, drop pages behind
+        RANDOM,     //no read ahead
+        WILLNEED    //start reading everything in now
+    };
+
+    namespace sys
+    {
+#ifdef AICO_MALC_MMAP
+        inline void os_advise(void* addr, size_t bytes, map_hint hint)
+        {
+            static constexpr int advice[]{MADV_NORMAL, MADV_SEQUENTIAL, MADV_RANDOM,
+                MADV_WILLNEED};
+            madvise(addr, bytes, advice[(size_t)hint]);
+        }
+#else
+        inline void os_advise(void*, size_t, map_hint){}
+#endif
+    }
+
+    //a file's bytes as `size()` Ts, mapped instead of read. pages fault in
+    //on first touch and are unmapped on destruction, the file is never
+    //copied into malc memory. mapped_storage<const T> maps read-only,
+    //mapped_storage<T> copy-on-write: writes stay private to the mapping.
+    //fixed size, it converts to a storage_view wherever a storage would be
+    //read. without mmap the file is read into fresh pages instead
+    template<typename T>
+    requires(std::is_trivially_copyable_v<T>)
+    class mapped_storage
+    {
+    public: //XXX testing
+        T* _data=nullptr;
+        size_t _size=0;
+        void* _base=nullptr;    //page aligned start of the mapping
+        size_t _mapbytes=0;
+
+        //maps [offset, offset+count*sizeof(T)) of the file
+        inline opres _open(const char* path, map_hint hint, size_t offset, size_t count)noexcept
+        {
+            if(offset%alignof(T))
+                return opres::ALIGN_ERR;
+#ifdef AICO_MALC_MMAP
+            const int fd=open(path, O_RDONLY|O_CLOEXEC);
+            if(fd<0)
+                return opres::FAILURE;
+            struct stat st;
+            if(fstat(fd, &st)!=0)
+            {
+                close(fd);
+                return opres::FAILURE;
+            }
+            const size_t filebytes=(size_t)st.st_size;
+#else
+            FILE* f=fopen(path, "rb");
+            if(!f)
+                return opres::FAILURE;
+            fseek(f, 0, SEEK_END);
+            const long end=ftell(f);
+            if(end<0)
+            {
+                fclose(f);
+                return opres::FAILURE;
+            }
+            const size_t filebytes=(size_t)end;
+#endif
+            opres res=opres::SUCCESS;
+            if(offset>filebytes)
+                res=opres::BOUNDS_ERR;
+            else if(count==npos)
+                count=(filebytes-offset)/sizeof(T);
+            else if(count>(filebytes-offset)/sizeof(T))
+                res=opres::BOUNDS_ERR;
+            if(res!=opres::SUCCESS||count==0)
+                count=0;
+#ifdef AICO_MALC_MMAP
+            else
+            {
+                //mmap offsets are page multiples, map from the page before
+                const size_t head=offset%sys::os_pagesize();
+                const size_t bytes=head+count*sizeof(T);
+                void* addr=mmap(nullptr, bytes,
+                    std::is_const_v<T>?PROT_READ:PROT_READ|PROT_WRITE, MAP_PRIVATE, fd,
+                    (off_t)(offset-head));
+                if(addr==MAP_FAILED)
+                    res=opres::FAILURE;
+                else
+                {
+                    sys::os_advise(addr, bytes, hint);
+                    _base=addr;
+                    _mapbytes=bytes;
+                    _data=(T*)((char*)addr+head);
+                    _size=count;
+                }
+            }
+            close(fd);
+#else
+            else
+            {
+                (void)hint;
+                const size_t bytes=count*sizeof(T);
+                void* addr=sys::os_map(bytes, sys::os_pagesize());
+                if(!addr)
+                    res=opres::MEM_ERR;
+                else if(fseek(f, (long)offset, SEEK_SET)!=0||fread(addr, 1, bytes, f)!=bytes)
+                {
+                    sys::os_unmap(addr, bytes);
+                    res=opres::FAILURE;
+                }
+                else
+                {
+                    _base=addr;
+                    _mapbytes=bytes;
+                    _data=(T*)addr;
+                    _size=count;
+                }
+            }
+            fclose(f);
+#endif
+            return res;
+        }
+        inline void _unmap()noexcept
+        {
+            if(_base)
+                sys::os_unmap(_base, _mapbytes);
+            _data=nullptr;
+            _size=_mapbytes=0;
+            _base=nullptr;
+        }
+    public:
+        static constexpr size_t npos=~size_t(0);
+
+        /*SIZE*/
+
+        inline size_t size()const noexcept{return _size;}
+        inline bool empty()const noexcept{return _size==0;}
+        inline T* data()const noexcept{return _data;}
+
+        /*INDEXING*/
+
+        inline T& at(size_t idx)const noexcept
+        {
+            assert(idx<this->size() && "out of bounds");
+            return _data[idx];
+        }
+        inline T& operator[](size_t idx)const noexcept{return at(idx);}
+
+        /*ITERATION*/
+
+        inline T* begin()const noexcept{return _data;}
+        inline T* end()const noexcept{return _data+_size;}
+
+        /*CONSTRUCTOR*/
+
+        mapped_storage()noexcept=default;
+        //`count` Ts starting `offset` bytes into the file, or as many whole
+        //ones as follow it. offset must suit alignof(T). empty on failure:
+        //FAILURE if the file can't be opened or mapped, BOUNDS_ERR if it is
+        //too short, ALIGN_ERR for a misaligned offset
+        explicit mapped_storage(const char* path, opres* res=nullptr,
+            map_hint hint=map_hint::NORMAL, size_t offset=0, size_t count=npos)noexcept
+        {
+            const opres r=_open(path, hint, offset, count);
+            if(res) *res=r;
+        }
+        mapped_storage(mapped_storage&& other)noexcept:_data(other._data), _size(other._size),
+            _base(other._base), _mapbytes(other._mapbytes)
+        {
+            other._data=nullptr;
+            other._size=other._mapbytes=0;
+            other._base=nullptr;
+        }
+        mapped_storage& operator=(mapped_storage&& other)noexcept
+        {
+            if(this!=&other)
+            {
+                _unmap();
+                std::swap(_data, other._data);
+                std::swap(_size, other._size);
+                std::swap(_base, other._base);
+                std::swap(_mapbytes, other._mapbytes);
+            }
+            return *this;
+        }
+        mapped_storage(const mapped_storage&)=delete;
+        mapped_storage& operator=(const mapped_storage&)=delete;
+
+        /*HINTS*/
+
+        //re-hints the pages under `count` elements from `first`, e.g.
+        //WILLNEED on the part about to be drawn
+        inline void advise(map_hint hint, size_t first=0, size_t count=npos)const noexcept
+        {
+            assert(first<=size() && "out of bounds");
+            count=std::min(count, size()-first);
+            if(!count)
+                return;
+            const size_t page=sys::os_pagesize();
+            char* begin=(char*)((uintptr_t)(_data+first)&~(page-1));
+            sys::os_advise(begin, (size_t)((char*)(_data+first+count)-begin), hint);
+        }
+
+        /*VIEW*/
+
+        inline storage_view<T> view()const noexcept{return {_data, _size};}
+        template<typename U>
+        inline operator storage_view<U>()const noexcept
+            requires(std::is_same_v<U, T>||std::is_same_v<U, const T>)
+        {
+            return {_data, _size};
+        }
+
+        /*DESTRUCTOR*/
+
+        ~mapped_storage()noexcept{_unmap();}
+    };
+}
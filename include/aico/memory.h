@@ -11,6 +11,10 @@
 
 namespace aico::sys
 {
+    //alloctr keeps the element count right before the first element, this
+    //many bytes so the elements stay aligned
+    template<typename T>
+    inline constexpr size_t ctr_lead=alignof(T)>sizeof(size_t)?alignof(T):sizeof(size_t);
     
     template<typename T> requires(!std::is_void_v<T>)
     inline T* malc(size_t count, size_t alignment=alignof(hdr_t), opres* res=nullptr)
@@ -25,9 +29,12 @@ namespace aico::sys
     {
         if(count==0) return nullptr;
         opres res;
-        auto addr=(T*)malc(sizeof(T)*count, 
+        trace_as as(traceop::CTR);
+        char* base=(char*)malc(ctr_lead<T>+sizeof(T)*count, 
             alignof(T)>=alignof(void*)?alignof(T):alignof(void*), &res);
-        if(!(res==opres::SUCCESS&&addr)) return nullptr;
+        if(!(res==opres::SUCCESS&&base)) return nullptr;
+        auto addr=(T*)(base+ctr_lead<T>);
+        ((size_t*)addr)[-1]=count;
         if constexpr (std::is_trivially_constructible_v<T, Args...>/*no-op ctor*/) 
         {
             if constexpr (sizeof...(Args) == 0)
@@ -38,41 +45,114 @@ namespace aico::sys
             return addr;
         }
         //non-trivial ctor
-        size_t ctd=0;
-        for(T* it=addr; it<addr+count; ++it)
-            try{new (it) T(std::forward<Args>(args)...); ++ctd;}
+        if constexpr(std::is_nothrow_constructible_v<T, Args...>)
+            for(T* it=addr; it<addr+count; ++it)
+                new (it) T(std::forward<Args>(args)...);
+        else
+        {
+            size_t ctd=0;
+            for(T* it=addr; it<addr+count; ++it)
+                try{new (it) T(std::forward<Args>(args)...); ++ctd;}
+                catch(...)
+                {
+                    for(T* end=addr+ctd; end!=addr;)
+                        (--end)->~T();
+                    rel(base);
+                    throw;
+                }
+        }
+        return addr;
+    }
+    
+    //`count` separate objects from one malc_n, each one can go to dtrel on
+    //its own. every object is built from the same `args`, passed as lvalues
+    //so the first can't move from them
+    template<typename T, typename... Args>
+        requires(requires{T(std::declval<Args&>()...);}&&!std::is_void_v<T>)
+    inline opres alloctr(T** out, size_t count, Args&&...args)
+        noexcept(std::is_nothrow_constructible_v<T, Args&...>)
+    {
+        if(count==0) return opres::SUCCESS;
+        const opres res=malc_n(count, ctr_lead<T>+sizeof(T),
+            alignof(T)>=alignof(void*)?alignof(T):alignof(void*), (void**)out);
+        if(res!=opres::SUCCESS) return res;
+        for(size_t i=0; i<count; ++i)
+        {
+            out[i]=(T*)((char*)out[i]+ctr_lead<T>);
+            ((size_t*)out[i])[-1]=1;
+        }
+        if constexpr (std::is_trivially_constructible_v<T, Args&...>)
+        {
+            for(size_t i=0; i<count; ++i)
+                if constexpr (sizeof...(Args) == 0)
+                    std::uninitialized_value_construct_n(out[i], 1);
+                else
+                    std::uninitialized_fill_n(out[i], 1, args...);
+            return opres::SUCCESS;
+        }
+        for(size_t i=0; i<count; ++i)
+            if constexpr(std::is_nothrow_constructible_v<T, Args&...>)
+                new (out[i]) T(args...);
+            else try{new (out[i]) T(args...);}
             catch(...)
             {
-                for(T* end=addr+ctd; end!=addr;)
-                    (--end)->~T();
-                rel(addr);
+                for(size_t j=0; j<count; ++j)
+                {
+                    if(j<i) out[j]->~T();
+                    ((void**)out)[j]=(char*)out[j]-ctr_lead<T>;
+                }
+                rel_n((void**)out, count);
                 throw;
             }
-        return addr;
+        return opres::SUCCESS;
     }
     
     //WARN: this function assumes memory is properly initialized
     template<typename T>
-    requires(!std::is_void_v<T>&&requires{~T();})
+    requires(!std::is_void_v<T>&&std::is_destructible_v<T>)
     inline void dtrel(T* addr) noexcept(std::is_nothrow_destructible_v<T>)
     {
-        if constexpr(std::is_trivially_destructible_v<T>)
+        if(!addr) return;
+        char* base=(char*)addr-ctr_lead<T>;
+        if constexpr(!std::is_trivially_destructible_v<T>)
         {
-            rel(addr);
-            return;
+            const size_t nrTs=((size_t*)addr)[-1];
+            for(T* end=addr+nrTs; end!=addr;)
+                if constexpr(std::is_nothrow_destructible_v<T>)
+                    (--end)->~T();
+                else try{(--end)->~T();}
+                    catch(...)
+                    {
+                        trace_as as(traceop::DTR);
+                        rel(base); //dumb user, eat memory leaks
+                        throw;
+                    }
         }
-        auto hdr=gethdr(addr);
-        if(!hdr) return; //the fuck?
-        //XXX this is fragile, relies on hdr_t too much, consider storing obj count
-        //in metadata directly
-        size_t nrTs=(hdr->bytes-((uintptr_t)addr-(uintptr_t)hdr->base))/sizeof(T);
-        for(T* end=addr+nrTs; end!=addr;)
-            try{(--end)->~T();}
-            catch(...)
+        //right before rel, destructors may rel memory of their own
+        trace_as as(traceop::DTR);
+        rel(base);
+    }
+    //dtrel for `count` objects, blocks that came out of one alloctr batch
+    //are released together
+    template<typename T>
+    requires(!std::is_void_v<T>&&std::is_nothrow_destructible_v<T>)
+    inline void dtrel(T* const* objs, size_t count)noexcept
+    {
+        constexpr size_t CHUNK=64;
+        void* bases[CHUNK];
+        for(size_t i=0; i<count;)
+        {
+            size_t n=0;
+            for(; i<count&&n<CHUNK; ++i)
             {
-                rel(addr); //dumb user, eat memory leaks
-                throw;
+                T* addr=objs[i];
+                if(!addr) continue;
+                if constexpr(!std::is_trivially_destructible_v<T>)
+                    for(T* end=addr+((size_t*)addr)[-1]; end!=addr;)
+                        (--end)->~T();
+                bases[n++]=(char*)addr-ctr_lead<T>;
             }
-        rel(addr);
+            rel_n(bases, n);
+        }
     }
 }
@@ -4,12 +4,16 @@
 #include "vec.h"
 #include "storage.h"
 
+#include <memory_resource>
 
 namespace aico
 {
     struct vertex{vec3 pos, normal; vec2 uv;};
 
-    storage<vertex> parseobj(const char* filename, opres* res);
+    //triangulated vertices of every face in the file. attribute lists read
+    //along the way are scratch and draw from `mr`, e.g. a frame's arena
+    storage<vertex> parseobj(const char* filename, opres* res,
+        std::pmr::memory_resource* mr=std::pmr::get_default_resource());
 
     //TODO
     class obj;
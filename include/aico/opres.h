@@ -12,6 +12,7 @@ namespace aico
         BOUNDS_ERR, 
         ALIGN_ERR, 
         NO_HEAPS, 
-        CONTEXT_CURRENT
+        CONTEXT_CURRENT,
+        BUDGET_ERR
     };
 }
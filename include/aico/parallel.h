@@ -0,0 +1,353 @@
+#pragma once
+
+#include "malc.h"
+#include "opres.h"
+#include "storage.h"
+#include "view.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+namespace aico
+{
+    //fork-join workers. run() hands indices out to the workers and the
+    //calling thread until all are taken, then waits for the stragglers.
+    //one run at a time, a run may not start another from inside
+    class worker_pool
+    {
+    public: //XXX testing
+        storage<std::thread> _workers{0};
+        std::mutex _runlock;            //one run at a time
+        std::mutex _m;
+        std::condition_variable _wake, _done;
+        uint64_t _gen=0;                //bumped per run, workers wait on it
+        size_t _pending=0;              //workers not done with this run
+        bool _stop=false;
+
+        void(*_fn)(void*, size_t)=nullptr;
+        void* _ctx=nullptr;
+        size_t _n=0;
+        std::atomic<size_t> _next{0};
+
+        inline static thread_local const worker_pool* _inside=nullptr;
+
+        inline void _drain()noexcept
+        {
+            for(size_t i; (i=_next.fetch_add(1, std::memory_order_relaxed))<_n;)
+                _fn(_ctx, i);
+        }
+        inline void _shutdown()noexcept
+        {
+            {
+                std::lock_guard lk(_m);
+                _stop=true;
+            }
+            _wake.notify_all();
+            for(std::thread& t : _workers)
+                if(t.joinable())
+                    t.join();
+        }
+        inline void _work()noexcept
+        {
+            _inside=this;
+            uint64_t seen=0;
+            for(;;)
+            {
+                {
+                    std::unique_lock lk(_m);
+                    _wake.wait(lk, [&]{return _stop||_gen!=seen;});
+                    if(_stop)
+                        return;
+                    seen=_gen;
+                }
+                _drain();
+                std::lock_guard lk(_m);
+                if(--_pending==0)
+                    _done.notify_one();
+            }
+        }
+    public:
+        /*CONSTRUCTOR*/
+
+        //`workers` threads besides the caller, by default one per core left
+        explicit worker_pool(size_t workers=std::max(1u, std::thread::hardware_concurrency())-1)
+        {
+            if(_workers.rsvcpct(workers)!=opres::SUCCESS)
+                throw std::bad_alloc();
+            try
+            {
+                for(size_t i=0; i<workers; ++i)
+                    _workers.emplace_back([this]{_work();});
+            }
+            catch(...)
+            {
+                _shutdown();
+                throw;
+            }
+        }
+        worker_pool(const worker_pool&)=delete;
+        worker_pool& operator=(const worker_pool&)=delete;
+
+        /*SIZE*/
+
+        //threads a run spreads over, the caller included
+        inline size_t lanes()const noexcept{return _workers.size()+1;}
+
+        /*RUN*/
+
+        //f(i) for every i in [0, n), from any of the lanes, returns once all
+        //are done. f may not throw
+        template<typename F>
+        inline void run(size_t n, F&& f)noexcept
+        {
+            assert(_inside!=this && "nested run");
+            if(n==0)
+                return;
+            if(n==1||_workers.size()==0)
+            {
+                for(size_t i=0; i<n; ++i)
+                    f(i);
+                return;
+            }
+            std::lock_guard serial(_runlock);
+            {
+                std::lock_guard lk(_m);
+                _fn=[](void* ctx, size_t i){(*(std::remove_reference_t<F>*)ctx)(i);};
+                _ctx=(void*)std::addressof(f);
+                _n=n;
+                _next.store(0, std::memory_order_relaxed);
+                _pending=_workers.size();
+                ++_gen;
+            }
+            _wake.notify_all();
+            _drain();
+            std::unique_lock lk(_m);
+            _done.wait(lk, [&]{return _pending==0;});
+        }
+
+        /*DESTRUCTOR*/
+
+        ~worker_pool()noexcept{_shutdown();}
+    };
+
+    //ranges smaller than this are not worth waking the pool for
+    inline constexpr size_t PAR_MIN_BYTES=1*sys::MB;
+    //copies and fills bigger than this use streaming stores, the data
+    //would only evict everything else from the cache on its way through
+    inline constexpr size_t NT_MIN_BYTES=16*sys::MB;
+
+    //f(begin, end) over [0, n) split in about one run per lane. runs start
+    //at indices that are multiples of 64 once offset by `base`, so per run
+    //alive-bit updates of a storage indexed from `base` never share a byte
+    template<typename F>
+    inline void par_runs(worker_pool& pool, size_t base, size_t n, size_t elemsize, F&& f)
+        noexcept
+    {
+        if(n==0)
+            return;
+        if(n*elemsize<PAR_MIN_BYTES||pool.lanes()==1)
+            return f(size_t(0), n);
+        const size_t per=((n+pool.lanes()-1)/pool.lanes()+63)&~size_t(63);
+        const size_t skew=(64-base%64)%64;  //first run ends on a boundary
+        const size_t runs=n<=skew+per?1:2+(n-skew-per-1)/per;
+        pool.run(runs, [&](size_t r)
+            {
+                const size_t begin=r?skew+r*per:0;
+                f(begin, std::min(n, skew+(r+1)*per));
+            });
+    }
+
+    //memcpy with streaming stores past the destination's first 16 byte
+    //boundary. plain memcpy without SSE2
+    inline void copy_nt(void* dst, const void* src, size_t bytes)noexcept
+    {
+#ifdef AICO_BITS_SSE2
+        char* d=(char*)dst;
+        const char* s=(const char*)src;
+        const size_t head=std::min(bytes, (16-(uintptr_t)d%16)%16);
+        std::memcpy(d, s, head);
+        d+=head, s+=head, bytes-=head;
+        for(; bytes>=64; d+=64, s+=64, bytes-=64)
+        {
+            const __m128i a=_mm_loadu_si128((const __m128i*)s);
+            const __m128i b=_mm_loadu_si128((const __m128i*)(s+16));
+            const __m128i c=_mm_loadu_si128((const __m128i*)(s+32));
+            const __m128i e=_mm_loadu_si128((const __m128i*)(s+48));
+            _mm_stream_si128((__m128i*)d, a);
+            _mm_stream_si128((__m128i*)(d+16), b);
+            _mm_stream_si128((__m128i*)(d+32), c);
+            _mm_stream_si128((__m128i*)(d+48), e);
+        }
+        for(; bytes>=16; d+=16, s+=16, bytes-=16)
+            _mm_stream_si128((__m128i*)d, _mm_loadu_si128((const __m128i*)s));
+        std::memcpy(d, s, bytes);
+        _mm_sfence();   //streamed stores are weakly ordered
+#else
+        std::memcpy(dst, src, bytes);
+#endif
+    }
+    //`count` copies of the `elemsize` bytes at elem, streamed. elemsize
+    //divides 16, so every aligned 16 bytes hold the same pattern
+    inline void fill_nt(void* dst, const void* elem, size_t elemsize, size_t count)noexcept
+    {
+        assert(elemsize&&16%elemsize==0);
+        char* d=(char*)dst;
+        size_t bytes=elemsize*count;
+#ifdef AICO_BITS_SSE2
+        const size_t head=std::min(bytes, (16-(uintptr_t)d%16)%16);
+        alignas(16) char pattern[16];
+        for(size_t i=0; i<16; ++i)  //as seen from the first aligned byte
+            pattern[i]=((const char*)elem)[(head+i)%elemsize];
+        for(size_t i=0; i<head; ++i)
+            d[i]=((const char*)elem)[i%elemsize];
+        const __m128i v=_mm_load_si128((const __m128i*)pattern);
+        char* p=d+head;
+        bytes-=head;
+        for(; bytes>=64; p+=64, bytes-=64)
+        {
+            _mm_stream_si128((__m128i*)p, v);
+            _mm_stream_si128((__m128i*)(p+16), v);
+            _mm_stream_si128((__m128i*)(p+32), v);
+            _mm_stream_si128((__m128i*)(p+48), v);
+        }
+        for(; bytes>=16; p+=16, bytes-=16)
+            _mm_stream_si128((__m128i*)p, v);
+        std::memcpy(p, pattern, bytes);
+        _mm_sfence();
+#else
+        for(size_t i=0; i<count; ++i)
+            std::memcpy(d+i*elemsize, elem, elemsize);
+#endif
+    }
+
+    //copyinto split across the pool. same contract as storage::copyinto,
+    //alive bits of dst are set run by run. elements may not throw
+    template<typename T, typename U, size_t Mc, memalloc_t A, memfree_t F, growth_t G,
+        size_t OMc, memalloc_t OA, memfree_t OF, growth_t OG>
+    requires(std::is_nothrow_constructible_v<U, const T&>&&std::is_nothrow_assignable_v<U&, const T&>)
+    inline opres par_copyinto(worker_pool& pool, const storage<T, DYNAMIC, false, Mc, A, F, G>& src,
+        storage<U, DYNAMIC, false, OMc, OA, OF, OG>& dst, size_t n_elements,
+        size_t dst_startidx=0, size_t src_startidx=0, bool initialize=false)noexcept
+    {
+        assert(n_elements+src_startidx<=src.size());
+        if(n_elements+src_startidx>src.size())
+            return opres::BOUNDS_ERR;
+        assert(n_elements+dst_startidx<=dst.size());
+        if(n_elements+dst_startidx>dst.size())
+            return opres::BOUNDS_ERR;
+        using dst_t=storage<U, DYNAMIC, false, OMc, OA, OF, OG>;
+        const bool stream=n_elements*sizeof(U)>=NT_MIN_BYTES;
+        par_runs(pool, dst_startidx, n_elements, sizeof(U), [&](size_t begin, size_t end)
+            {
+                if constexpr(std::is_trivially_copyable_v<T>&&std::is_same_v<T, U>)
+                {
+                    if(stream)
+                        copy_nt(dst.begin()+dst_startidx+begin, src.begin()+src_startidx+begin,
+                            (end-begin)*sizeof(U));
+                    else
+                        std::memcpy(dst.begin()+dst_startidx+begin,
+                            src.begin()+src_startidx+begin, (end-begin)*sizeof(U));
+                }
+                else
+                    src.copyinto(dst.begin(), end-begin, dst_startidx+begin,
+                        src_startidx+begin, initialize);
+                if constexpr(dst_t::Alivebit_Cond)
+                    dst._setbits(dst_startidx+begin, dst_startidx+end);
+            });
+        return opres::SUCCESS;
+    }
+
+    //storage::copy split across the pool
+    template<typename T, size_t Mc, memalloc_t A, memfree_t F, growth_t G>
+    requires(std::is_nothrow_copy_constructible_v<T>&&std::is_nothrow_copy_assignable_v<T>)
+    inline storage<T, DYNAMIC, false, Mc, A, F>
+    par_copy(worker_pool& pool, const storage<T, DYNAMIC, false, Mc, A, F, G>& src,
+        size_t n_elements, size_t fromidx=0, opres* res=nullptr)
+    {
+        using ret_t=storage<T, DYNAMIC, false, Mc, A, F>;
+        assert(n_elements+fromidx<=src.size());
+        if(n_elements+fromidx>src.size())
+        {
+            if(res)
+                *res=opres::BOUNDS_ERR;
+            return ret_t{};
+        }
+        if constexpr(ret_t::Alivebit_Cond)
+            if(!src._allalive())    //only the live ones get copied
+                return src.copy(n_elements, fromidx, res);
+        if(n_elements==0)
+        {
+            if(res)
+                *res=opres::SUCCESS;
+            return ret_t{};
+        }
+        T* resdata=(T*)A(std::max(n_elements, Mc)*sizeof(T));
+        if(!resdata)
+        {
+            if(res)
+                *res=opres::MEM_ERR;
+            return ret_t{};
+        }
+        //nothing throws below, the result starts out fully alive
+        ret_t result(resdata, n_elements, true);
+        par_copyinto(pool, src, result, n_elements, 0, fromidx, true);
+        if(res)
+            *res=opres::SUCCESS;
+        return result;
+    }
+
+    //storage::resize(newsize, fillval) split across the pool
+    template<typename T, size_t Mc, memalloc_t A, memfree_t F, growth_t G>
+    requires(std::is_nothrow_copy_constructible_v<T>)
+    inline opres par_resize(worker_pool& pool, storage<T, DYNAMIC, false, Mc, A, F, G>& s,
+        size_t newsize, const T& fillval)noexcept
+    {
+        using storage_t=storage<T, DYNAMIC, false, Mc, A, F, G>;
+        const size_t oldsize=s.size();
+        if(opres res=s._resize_noinit(newsize); res!=opres::SUCCESS||newsize<=oldsize)
+            return res;
+        constexpr bool patterned=std::is_trivially_copyable_v<T>&&16%sizeof(T)==0;
+        const bool stream=patterned&&(newsize-oldsize)*sizeof(T)>=NT_MIN_BYTES;
+        par_runs(pool, oldsize, newsize-oldsize, sizeof(T), [&](size_t begin, size_t end)
+            {
+                T* first=s.begin()+oldsize+begin;
+                if(stream)
+                    fill_nt(first, std::addressof(fillval), sizeof(T), end-begin);
+                else
+                    std::uninitialized_fill_n(first, end-begin, fillval);
+                if constexpr(storage_t::Alivebit_Cond)
+                    s._setbits(oldsize+begin, oldsize+end);
+            });
+        return opres::SUCCESS;
+    }
+
+    //dst[i]=f(src[i]) for every element of src, split across the pool.
+    //dst holds at least as many elements, either may be strided. f is
+    //called from several threads at once
+    template<typename T, typename U, typename Fn>
+    requires(std::is_nothrow_invocable_v<Fn&, const T&>&&
+        std::is_assignable_v<U&, std::invoke_result_t<Fn&, const T&>>)
+    inline opres par_transform(worker_pool& pool, storage_view<const T> src, storage_view<U> dst,
+        Fn f)noexcept
+    {
+        assert(src.size()<=dst.size());
+        if(src.size()>dst.size())
+            return opres::BOUNDS_ERR;
+        par_runs(pool, 0, src.size(), sizeof(T)+sizeof(U), [&](size_t begin, size_t end)
+            {
+                for(size_t i=begin; i<end; ++i)
+                    dst[i]=f(src[i]);
+            });
+        return opres::SUCCESS;
+    }
+}
@@ -0,0 +1,154 @@
+#pragma once
+
+#include "malc.h"
+#include "opres.h"
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+namespace aico::sys
+{
+    //fixed size block allocator. blocks are carved out of SlabBytes slabs taken
+    //from malc, released blocks go on an intrusive freelist and are handed out
+    //first. slabs are only returned when the pool dies. not thread safe, see
+    //thread_pool() for one pool per thread
+    template<size_t Bytes, size_t Align=alignof(max_align_t), size_t SlabBytes=16*KB>
+    requires(Bytes>0&&(Align&(Align-1))==0)
+    struct pool
+    {
+        struct slab_t{slab_t* next;};
+        static constexpr size_t BLOCK_ALIGN=Align>alignof(void*)?Align:alignof(void*);
+        //every block must be able to hold a freelist link
+        static constexpr size_t BLOCK=(std::max(Bytes, sizeof(void*))+BLOCK_ALIGN-1)&
+            ~(BLOCK_ALIGN-1);
+        static constexpr size_t FIRST=(sizeof(slab_t)+BLOCK_ALIGN-1)&~(BLOCK_ALIGN-1);
+        static constexpr size_t PER_SLAB=(SlabBytes-FIRST)/BLOCK;
+        static_assert(PER_SLAB>0, "slab too small for a single block");
+
+        pool()noexcept=default;
+        pool(const pool&)=delete;
+        pool& operator=(const pool&)=delete;
+        //slabs whose blocks all came back are returned. a block still out
+        //can't come back once the pool is gone, its slab stays mapped so
+        //the block stays readable, and leaks
+        ~pool()noexcept
+        {
+            //unlink first, the freelist runs through the slabs being freed
+            slab_t* idle=nullptr;
+            const slab_t* head=_slabs;
+            for(slab_t** link=&_slabs; *link;)
+            {
+                slab_t* s=*link;
+                if(_live&&_inuse(s, s==head?PER_SLAB-_carved:0))
+                {
+                    link=&s->next;
+                    continue;
+                }
+                *link=s->next;
+                s->next=idle;
+                idle=s;
+            }
+            for(slab_t* s=idle; s;)
+            {
+                slab_t* next=s->next;
+                sys::rel(s);
+                s=next;
+            }
+        }
+
+        inline void* alloc(opres* res=nullptr)noexcept
+        {
+            void* blk=_free;
+            if(blk)
+                _free=*(void**)blk;
+            else if(_carved<PER_SLAB)
+                blk=(char*)_slabs+FIRST+BLOCK*_carved++;
+            else
+            {
+                //lazily carved, untouched blocks of a fresh slab cost nothing
+                slab_t* s=(slab_t*)sys::malc(SlabBytes,
+                    BLOCK_ALIGN>alignof(hdr_t)?BLOCK_ALIGN:alignof(hdr_t));
+                if(!s)
+                {
+                    if(res) *res=opres::MEM_ERR;
+                    return nullptr;
+                }
+                s->next=_slabs;
+                _slabs=s;
+                _carved=1;
+                blk=(char*)s+FIRST;
+            }
+            ++_live;
+            if(res) *res=opres::SUCCESS;
+            return blk;
+        }
+        //`blk` must come from this pool
+        inline void rel(void* blk)noexcept
+        {
+            if(!blk)
+                return;
+            assert(_live);
+            *(void**)blk=_free;
+            _free=blk;
+            --_live;
+        }
+
+        template<typename T, typename...Args>
+        requires(sizeof(T)<=Bytes&&alignof(T)<=BLOCK_ALIGN&&
+            requires{T(std::declval<Args>()...);})
+        inline T* make(Args&&...args)
+            noexcept(std::is_nothrow_constructible_v<T, Args...>)
+        {
+            void* blk=alloc();
+            if(!blk)
+                return nullptr;
+            if constexpr(std::is_nothrow_constructible_v<T, Args...>)
+                return new (blk) T(std::forward<Args>(args)...);
+            else try{return new (blk) T(std::forward<Args>(args)...);}
+                catch(...){rel(blk); throw;}
+        }
+        template<typename T>
+        inline void destroy(T* obj)noexcept(std::is_nothrow_destructible_v<T>)
+        {
+            if(!obj)
+                return;
+            std::destroy_at(obj);
+            rel(obj);
+        }
+
+        inline size_t live()const noexcept{return _live;}
+
+        //whether any block of `s` is out, `uncarved` of its blocks were
+        //never handed out. O(freelist), only the pool's destructor asks,
+        //blocks don't know their slab
+        inline bool _inuse(const slab_t* s, size_t uncarved)const noexcept
+        {
+            const char* first=(const char*)s+FIRST;
+            const char* end=first+BLOCK*PER_SLAB;
+            size_t idle=uncarved;
+            for(void* blk=_free; blk; blk=*(void**)blk)
+                idle+=std::less_equal<const char*>{}(first, (const char*)blk)&&
+                    std::less<const char*>{}((const char*)blk, end);
+            return idle<PER_SLAB;
+        }
+
+        void* _free=nullptr;
+        slab_t* _slabs=nullptr; //newest first, only the head is being carved
+        size_t _carved=PER_SLAB;//blocks handed out of _slabs so far
+        size_t _live=0;
+    };
+
+    //the calling thread's pool for blocks of this shape. blocks must be
+    //released on the thread that allocated them
+    template<size_t Bytes, size_t Align=alignof(max_align_t), size_t SlabBytes=16*KB>
+    inline pool<Bytes, Align, SlabBytes>& thread_pool()
+    {
+        thread_local pool<Bytes, Align, SlabBytes> p;
+        return p;
+    }
+}
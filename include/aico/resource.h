@@ -0,0 +1,71 @@
+#pragma once
+
+#include "arena.h"
+#include "malc.h"
+#include "opres.h"
+
+#include <cstddef>
+#include <memory_resource>
+#include <new>
+
+namespace aico::sys
+{
+    //std::pmr front for malc. containers on it are served from malc's heaps
+    //and show up in malc_stats, charged to `memtag`, or to the tag bound at
+    //allocation time when it is 0. any malc_resource frees what another one
+    //allocated
+    struct malc_resource final : std::pmr::memory_resource
+    {
+        explicit malc_resource(memtag_t memtag=0)noexcept:memtag(memtag){}
+
+        memtag_t memtag;
+    private:
+        void* do_allocate(size_t bytes, size_t alignment)override
+        {
+            opres res;
+            void* p=malc(bytes, alignment<alignof(void*)?alignof(void*):alignment,
+                &res, memtag?memtag:bound_tag());
+            if(!p)
+                throw std::bad_alloc();
+            return p;
+        }
+        void do_deallocate(void* p, size_t, size_t)noexcept override{rel(p);}
+        bool do_is_equal(const std::pmr::memory_resource& other)const noexcept override
+        {
+            return dynamic_cast<const malc_resource*>(&other)!=nullptr;
+        }
+    };
+
+    //the untagged malc resource, sys::init makes it the default resource
+    inline malc_resource* malc_default_resource()noexcept
+    {
+        static malc_resource r;
+        return &r;
+    }
+
+    //std::pmr front for an arena, e.g. the frame's scratch arena. deallocation
+    //is a no-op, memory comes back when the arena is rolled back or reset, so
+    //containers on it must not outlive that
+    struct arena_resource final : std::pmr::memory_resource
+    {
+        explicit arena_resource(arena& a)noexcept:_arena(&a){}
+
+        inline arena& get()const noexcept{return *_arena;}
+    private:
+        void* do_allocate(size_t bytes, size_t alignment)override
+        {
+            void* p=_arena->alloc(bytes?bytes:1, alignment);
+            if(!p)
+                throw std::bad_alloc();
+            return p;
+        }
+        void do_deallocate(void*, size_t, size_t)noexcept override{}
+        bool do_is_equal(const std::pmr::memory_resource& other)const noexcept override
+        {
+            auto* o=dynamic_cast<const arena_resource*>(&other);
+            return o&&o->_arena==_arena;
+        }
+
+        arena* _arena;
+    };
+}
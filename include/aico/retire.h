@@ -0,0 +1,164 @@
+#pragma once
+
+#include "malc.h"
+#include "opres.h"
+#include "storage.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+
+namespace aico::sys
+{
+    //releases a batch of deferred objects, all deferred with this function
+    typedef void(*retire_fn)(void* const* objs, size_t n);
+
+    inline void rel_batch(void* const* objs, size_t n){rel_n(objs, n);}
+
+    //deferred releases keyed on frame index. everything deferred between two
+    //close() calls belongs to one frame, retire(frame) releases every closed
+    //frame up to `frame`, once whatever was still using them (e.g. the GPU,
+    //signalled through a fence) is done. objects deferred with the same
+    //retire_fn are released in one call per retire(), memory through
+    //sys::rel_n. a retire_fn must not defer into the queue it runs from.
+    //not thread safe
+    struct retire_queue
+    {
+        struct entry_t
+        {
+            retire_fn fn;
+            void* obj;
+        };
+        struct mark_t
+        {
+            uint64_t frame;
+            size_t end;     //entries [previous end, end) belong to `frame`
+        };
+
+        retire_queue()=default;
+        retire_queue(const retire_queue&)=delete;
+        retire_queue& operator=(const retire_queue&)=delete;
+        //whatever is still pending is released, make sure nothing uses it
+        ~retire_queue()noexcept{flush();}
+
+        //SUCCESS or MEM_ERR, in which case the caller still owns `obj`
+        inline opres defer(retire_fn fn, void* obj)noexcept
+        {
+            return _entries.push_back({fn, obj});
+        }
+        //sys::rel once the frame retires
+        inline opres defer(void* mem)noexcept
+        {
+            return mem?defer(&rel_batch, mem):opres::SUCCESS;
+        }
+
+        //index of the frame deferrals currently go to
+        inline uint64_t frame()const noexcept{return _frame;}
+        //closes the current frame, returns its index
+        inline uint64_t close()noexcept
+        {
+            const uint64_t closed=_frame++;
+            const size_t end=_entries.size();
+            if(end==(_marks.size()?_marks[_marks.size()-1].end:0))
+                return closed; //nothing deferred, nothing to track
+            //no room to track it, its entries then ride along with the next
+            //frame that closes, which retires later, never earlier
+            (void)_marks.push_back({closed, end});
+            return closed;
+        }
+        //releases every closed frame <= `frame`, returns the number of
+        //objects released
+        inline size_t retire(uint64_t frame)noexcept
+        {
+            size_t k=0;
+            while(k<_marks.size()&&_marks[k].frame<=frame)
+                ++k;
+            if(k==0)
+                return 0;
+            const size_t end=_marks[k-1].end;
+            _release(end);
+            _shift(_marks, k);
+            for(mark_t& m : _marks)
+                m.end-=end;
+            return end;
+        }
+        //releases everything, the open frame included
+        inline size_t flush()noexcept
+        {
+            const size_t n=_entries.size();
+            _release(n);
+            _marks.resize(0);
+            return n;
+        }
+        inline size_t pending()const noexcept{return _entries.size();}
+
+        //runs [0, n) grouped by function, then drops them
+        inline void _release(size_t n)noexcept
+        {
+            if(n==0)
+                return;
+            entry_t* e=_entries.begin();
+            std::stable_sort(e, e+n, [](const entry_t& a, const entry_t& b)
+                {return std::less<retire_fn>()(a.fn, b.fn);});
+            for(size_t i=0; i<n;)
+            {
+                size_t j=i;
+                _objs.resize(0);
+                for(; j<n&&e[j].fn==e[i].fn; ++j)
+                    if(_objs.push_back(e[j].obj)!=opres::SUCCESS)
+                        break;
+                if(_objs.size())
+                    e[i].fn(_objs.begin(), _objs.size());
+                else //no room to gather, one at a time
+                    e[i].fn(&e[i].obj, 1), ++j;
+                i=j;
+            }
+            _shift(_entries, n);
+        }
+        template<typename S>
+        inline static void _shift(S& s, size_t n)noexcept
+        {
+            std::memmove((void*)s.begin(), (void*)(s.begin()+n),
+                (s.size()-n)*sizeof(*s.begin()));
+            s.resize(s.size()-n);
+        }
+
+        storage<entry_t> _entries;
+        storage<mark_t> _marks;
+        storage<void*> _objs;   //gather buffer for one retire_fn
+        uint64_t _frame=0;
+    };
+
+    //the calling thread's retire queue, wndctx::loop binds the window's
+    //queue here while the render function runs
+    inline retire_queue*& bound_retire()
+    {
+        thread_local retire_queue* q=nullptr;
+        return q;
+    }
+    //binds a queue to the calling thread for the lifetime of the scope
+    struct retire_scope
+    {
+        retire_queue* prev;
+        explicit retire_scope(retire_queue& q)noexcept:prev(bound_retire())
+        {bound_retire()=&q;}
+        retire_scope(const retire_scope&)=delete;
+        retire_scope& operator=(const retire_scope&)=delete;
+        ~retire_scope()noexcept{bound_retire()=prev;}
+    };
+    //releases through the bound queue, right away if none is bound or it
+    //has no room
+    inline void retire(retire_fn fn, void* obj)noexcept
+    {
+        if(retire_queue* q=bound_retire(); q&&q->defer(fn, obj)==opres::SUCCESS)
+            return;
+        fn(&obj, 1);
+    }
+    inline void rel_deferred(void* mem)noexcept
+    {
+        if(mem)
+            retire(&rel_batch, mem);
+    }
+}
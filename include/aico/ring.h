@@ -0,0 +1,329 @@
+#pragma once
+
+#include "storage.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace aico
+{
+    //false sharing granularity, indices written by different threads live
+    //this far apart
+    inline constexpr size_t CACHELINE=64;
+
+    //bounded lock-free queue between one producer thread and one consumer
+    //thread. N slots inline in a fixed storage, indices run freely and
+    //wrap through a mask. each side keeps a cached copy of the other's
+    //index on its own line and reloads it only when the ring looks full
+    //or empty, so a steady stream touches the shared lines once per batch
+    template<typename T, size_t N>
+    requires(std::has_single_bit(N)&&std::is_nothrow_destructible_v<T>&&
+        std::is_move_assignable_v<T>)
+    class spsc_ring
+    {
+    public: //XXX testing
+        static constexpr size_t MASK=N-1;
+
+        //producer's line
+        alignas(CACHELINE) std::atomic<size_t> _tail{0};
+        size_t _headcache=0;
+        //consumer's line
+        alignas(CACHELINE) std::atomic<size_t> _head{0};
+        size_t _tailcache=0;
+
+        alignas(CACHELINE) storage<T, N> _slots;
+
+        inline T* _at(size_t i)noexcept{return _slots.begin()+(i&MASK);}
+
+        //free slots as the producer sees them, reloading the consumer's
+        //index when fewer than `want`
+        inline size_t _room(size_t tail, size_t want)noexcept
+        {
+            if(N-(tail-_headcache)<want)
+                _headcache=_head.load(std::memory_order_acquire);
+            return N-(tail-_headcache);
+        }
+        inline size_t _ready(size_t head, size_t want)noexcept
+        {
+            if(_tailcache-head<want)
+                _tailcache=_tail.load(std::memory_order_acquire);
+            return _tailcache-head;
+        }
+    public:
+        /*SIZE*/
+
+        static constexpr size_t capacity()noexcept{return N;}
+        //exact only while neither side is running
+        inline size_t size()const noexcept
+        {
+            return _tail.load(std::memory_order_acquire)-_head.load(std::memory_order_acquire);
+        }
+        inline bool empty()const noexcept{return size()==0;}
+
+        /*CONSTRUCTOR*/
+
+        spsc_ring()noexcept=default;
+        spsc_ring(const spsc_ring&)=delete;
+        spsc_ring& operator=(const spsc_ring&)=delete;
+
+        /*PRODUCER*/
+
+        //false when full
+        template<typename...Args>
+        inline bool try_emplace(Args&&...args)
+            noexcept(std::is_nothrow_constructible_v<T, Args...>)
+            requires(requires{T(std::declval<Args>()...);})
+        {
+            const size_t tail=_tail.load(std::memory_order_relaxed);
+            if(!_room(tail, 1))
+                return false;
+            std::construct_at(_at(tail), std::forward<Args>(args)...);
+            _tail.store(tail+1, std::memory_order_release);
+            return true;
+        }
+        inline bool try_push(const T& obj)noexcept(noexcept(try_emplace(obj)))
+        {
+            return try_emplace(obj);
+        }
+        inline bool try_push(T&& obj)noexcept(noexcept(try_emplace(std::move(obj))))
+        {
+            return try_emplace(std::move(obj));
+        }
+        //copies up to n elements from src in at most two runs, published
+        //with one store. returns how many made it. on throw nothing is
+        //published
+        inline size_t push_n(const T* src, size_t n)
+            noexcept(std::is_nothrow_copy_constructible_v<T>)
+        {
+            const size_t tail=_tail.load(std::memory_order_relaxed);
+            n=std::min(n, _room(tail, n));
+            if(!n)
+                return 0;
+            const size_t first=std::min(n, N-(tail&MASK));
+            std::uninitialized_copy_n(src, first, _at(tail));
+            if constexpr(std::is_nothrow_copy_constructible_v<T>)
+                std::uninitialized_copy_n(src+first, n-first, _at(0));
+            else try
+            {
+                std::uninitialized_copy_n(src+first, n-first, _at(0));
+            }
+            catch(...)
+            {
+                std::destroy_n(_at(tail), first);
+                throw;
+            }
+            _tail.store(tail+n, std::memory_order_release);
+            return n;
+        }
+
+        /*CONSUMER*/
+
+        //false when empty
+        inline bool try_pop(T& out)noexcept(std::is_nothrow_move_assignable_v<T>)
+        {
+            const size_t head=_head.load(std::memory_order_relaxed);
+            if(!_ready(head, 1))
+                return false;
+            T* slot=_at(head);
+            out=std::move(*slot);
+            std::destroy_at(slot);
+            _head.store(head+1, std::memory_order_release);
+            return true;
+        }
+        //moves up to n elements into dst, returns how many
+        inline size_t pop_n(T* dst, size_t n)noexcept(std::is_nothrow_move_assignable_v<T>)
+        {
+            const size_t head=_head.load(std::memory_order_relaxed);
+            n=std::min(n, _ready(head, n));
+            if(!n)
+                return 0;
+            const size_t first=std::min(n, N-(head&MASK));
+            std::move(_at(head), _at(head)+first, dst);
+            std::move(_at(0), _at(0)+(n-first), dst+first);
+            std::destroy_n(_at(head), first);
+            std::destroy_n(_at(0), n-first);
+            _head.store(head+n, std::memory_order_release);
+            return n;
+        }
+
+        /*DESTRUCTOR*/
+
+        ~spsc_ring()noexcept
+        {
+            if constexpr(!std::is_trivially_destructible_v<T>)
+                for(size_t i=_head.load(std::memory_order_relaxed),
+                    end=_tail.load(std::memory_order_relaxed); i!=end; ++i)
+                    std::destroy_at(_at(i));
+        }
+    };
+
+    //bounded lock-free queue for any number of producers and consumers.
+    //every cell carries a sequence number telling which lap may use it
+    //next: a producer may fill cell i&MASK at ticket i once its sequence
+    //is i, a consumer may empty it once it is i+1. tickets are claimed by
+    //CAS on the shared index, batches claim a run of ready cells at once
+    template<typename T, size_t N>
+    requires(std::has_single_bit(N)&&std::is_nothrow_destructible_v<T>&&
+        std::is_move_assignable_v<T>)
+    class mpmc_ring
+    {
+    public: //XXX testing
+        static constexpr size_t MASK=N-1;
+
+        struct cell_t
+        {
+            std::atomic<size_t> seq;
+            alignas(T) unsigned char val[sizeof(T)];
+
+            inline T* get()noexcept{return std::launder((T*)val);}
+        };
+
+        alignas(CACHELINE) std::atomic<size_t> _tail{0};
+        alignas(CACHELINE) std::atomic<size_t> _head{0};
+        alignas(CACHELINE) storage<cell_t, N> _cells;
+
+        inline cell_t& _at(size_t i)noexcept{return _cells.begin()[i&MASK];}
+
+        //claims up to n tickets at `index` whose cells have sequence
+        //ticket+lag, i.e. are ready for this side. returns {first, count},
+        //count 0 when the first cell is not ready
+        inline std::pair<size_t, size_t> _claim(std::atomic<size_t>& index, size_t lag,
+            size_t n)noexcept
+        {
+            size_t pos=index.load(std::memory_order_relaxed);
+            for(;;)
+            {
+                const intptr_t dif=(intptr_t)(_at(pos).seq.load(std::memory_order_acquire)-
+                    (pos+lag));
+                if(dif<0)   //full or empty
+                    return {pos, 0};
+                if(dif>0)   //someone else took it
+                {
+                    pos=index.load(std::memory_order_relaxed);
+                    continue;
+                }
+                //cells stay ready until claimed, and only the CAS claims
+                size_t k=1;
+                while(k<n&&_at(pos+k).seq.load(std::memory_order_acquire)==pos+k+lag)
+                    ++k;
+                if(index.compare_exchange_weak(pos, pos+k, std::memory_order_relaxed))
+                    return {pos, k};
+            }
+        }
+    public:
+        /*SIZE*/
+
+        static constexpr size_t capacity()noexcept{return N;}
+        //a snapshot, claimed but unpublished cells count
+        inline size_t size()const noexcept
+        {
+            const size_t head=_head.load(std::memory_order_acquire);
+            const size_t tail=_tail.load(std::memory_order_acquire);
+            return tail>head?tail-head:0;
+        }
+        inline bool empty()const noexcept{return size()==0;}
+
+        /*CONSTRUCTOR*/
+
+        mpmc_ring()noexcept
+        {
+            for(size_t i=0; i<N; ++i)
+            {
+                std::construct_at(_cells.begin()+i);
+                _cells.begin()[i].seq.store(i, std::memory_order_relaxed);
+            }
+        }
+        mpmc_ring(const mpmc_ring&)=delete;
+        mpmc_ring& operator=(const mpmc_ring&)=delete;
+
+        /*PRODUCER*/
+
+        //false when full. construction may not throw, a claimed cell
+        //must be published or the ring wedges
+        template<typename...Args>
+        inline bool try_emplace(Args&&...args)noexcept
+            requires(std::is_nothrow_constructible_v<T, Args...>)
+        {
+            const auto [pos, k]=_claim(_tail, 0, 1);
+            if(!k)
+                return false;
+            cell_t& c=_at(pos);
+            std::construct_at(c.get(), std::forward<Args>(args)...);
+            c.seq.store(pos+1, std::memory_order_release);
+            return true;
+        }
+        inline bool try_push(const T& obj)noexcept requires(std::is_nothrow_copy_constructible_v<T>)
+        {
+            return try_emplace(obj);
+        }
+        inline bool try_push(T&& obj)noexcept requires(std::is_nothrow_move_constructible_v<T>)
+        {
+            return try_emplace(std::move(obj));
+        }
+        //copies up to n elements from src, one CAS for the lot. returns how
+        //many made it
+        inline size_t push_n(const T* src, size_t n)noexcept
+            requires(std::is_nothrow_copy_constructible_v<T>)
+        {
+            if(!n)
+                return 0;
+            const auto [pos, k]=_claim(_tail, 0, std::min(n, N));
+            for(size_t i=0; i<k; ++i)
+            {
+                cell_t& c=_at(pos+i);
+                std::construct_at(c.get(), src[i]);
+                c.seq.store(pos+i+1, std::memory_order_release);
+            }
+            return k;
+        }
+
+        /*CONSUMER*/
+
+        //false when empty
+        inline bool try_pop(T& out)noexcept requires(std::is_nothrow_move_assignable_v<T>)
+        {
+            const auto [pos, k]=_claim(_head, 1, 1);
+            if(!k)
+                return false;
+            cell_t& c=_at(pos);
+            out=std::move(*c.get());
+            std::destroy_at(c.get());
+            c.seq.store(pos+N, std::memory_order_release);
+            return true;
+        }
+        //moves up to n elements into dst, returns how many
+        inline size_t pop_n(T* dst, size_t n)noexcept
+            requires(std::is_nothrow_move_assignable_v<T>)
+        {
+            if(!n)
+                return 0;
+            const auto [pos, k]=_claim(_head, 1, std::min(n, N));
+            for(size_t i=0; i<k; ++i)
+            {
+                cell_t& c=_at(pos+i);
+                dst[i]=std::move(*c.get());
+                std::destroy_at(c.get());
+                c.seq.store(pos+i+N, std::memory_order_release);
+            }
+            return k;
+        }
+
+        /*DESTRUCTOR*/
+
+        //no thread may be inside a push or pop
+        ~mpmc_ring()noexcept
+        {
+            if constexpr(!std::is_trivially_destructible_v<T>)
+                for(size_t i=_head.load(std::memory_order_relaxed),
+                    end=_tail.load(std::memory_order_relaxed); i!=end; ++i)
+                    std::destroy_at(_at(i).get());
+        }
+    };
+}
@@ -0,0 +1,244 @@
+#pragma once
+
+#include "malc.h"
+#include "opres.h"
+#include "storage.h"
+
+#include <bit>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <span>
+#include <type_traits>
+#include <utility>
+
+namespace aico
+{
+    //default chunk length: about 16KB worth of T, a power of two
+    template<typename T>
+    inline constexpr size_t seg_chunk_default=std::bit_floor(std::max<size_t>(1, 16*1024/sizeof(T)));
+
+    //segmented storage: elements live in fixed size chunks of ChunkElems,
+    //growing only ever adds chunks, so element addresses stay put for as
+    //long as the element does and nothing is relocated or copied. indexing
+    //is a shift and a mask into the chunk table, which is a storage of
+    //chunk pointers. elements [0, size()) are always constructed.
+    //chunk(i) and for_chunks hand out contiguous runs, each one safe to
+    //process on its own thread
+    template<typename T, size_t ChunkElems=seg_chunk_default<T>,
+        memalloc_t Alloc=&alloc_bind, memfree_t Free=&sys::rel>
+    requires(std::has_single_bit(ChunkElems)&&std::is_destructible_v<T>)
+    class segmented_storage
+    {
+    public: //XXX testing
+        static constexpr size_t SHIFT=(size_t)std::countr_zero(ChunkElems);
+        static constexpr size_t MASK=ChunkElems-1;
+
+        storage<T*, DYNAMIC, false, 8, Alloc, Free> _chunks;
+        size_t _dynmsz=0;
+
+        inline static size_t _nchunks(size_t n)noexcept{return (n+MASK)>>SHIFT;}
+    public:
+        /*SIZE*/
+
+        inline size_t size()const noexcept{return _dynmsz;}
+        //elements that fit in the chunks held right now
+        inline size_t capacity()const noexcept{return _chunks.size()<<SHIFT;}
+        static constexpr size_t chunk_elems()noexcept{return ChunkElems;}
+
+        /*INDEXING*/
+
+        inline T& at(size_t idx)noexcept
+        {
+            assert(idx<this->size() && "out of bounds");
+            return _chunks[idx>>SHIFT][idx&MASK];
+        }
+        inline const T& at(size_t idx)const noexcept
+        {
+            assert(idx<this->size() && "out of bounds");
+            return _chunks[idx>>SHIFT][idx&MASK];
+        }
+        inline const T& operator[](size_t idx)const noexcept{return at(idx);}
+        inline       T& operator[](size_t idx)      noexcept{return at(idx);}
+
+        /*CHUNKS*/
+
+        //chunks holding elements, the last one may be partially filled
+        inline size_t chunks()const noexcept{return _nchunks(_dynmsz);}
+        //the live elements of chunk `c`, contiguous
+        inline std::span<T> chunk(size_t c)noexcept
+        {
+            assert(c<chunks() && "out of bounds");
+            return {_chunks[c], std::min(ChunkElems, _dynmsz-(c<<SHIFT))};
+        }
+        inline std::span<const T> chunk(size_t c)const noexcept
+        {
+            assert(c<chunks() && "out of bounds");
+            return {_chunks[c], std::min(ChunkElems, _dynmsz-(c<<SHIFT))};
+        }
+        //f(span, index of its first element) for every chunk in
+        //[first, last), e.g. one contiguous range of chunks per worker
+        template<typename F>
+        inline void for_chunks(size_t first, size_t last, F&& f)
+        {
+            assert(first<=last&&last<=chunks());
+            for(size_t c=first; c<last; ++c)
+                f(chunk(c), c<<SHIFT);
+        }
+        template<typename F>
+        inline void for_chunks(F&& f){for_chunks(0, chunks(), std::forward<F>(f));}
+
+        /*CONSTRUCTOR*/
+
+        segmented_storage():_chunks(0){}
+        //default construction
+        explicit segmented_storage(size_t dynamic_size)requires(requires{T();})
+            :_chunks(0)
+        {
+            opres res;
+            //a throwing T() leaves _dynmsz at what is constructed
+            try{res=resize(dynamic_size);}
+            catch(...){_release(); throw;}
+            if(res!=opres::SUCCESS)
+            {
+                _release();
+                throw std::bad_alloc();
+            }
+        }
+
+            /*COPY*/
+
+        segmented_storage(const segmented_storage&)=delete;
+
+            /*MOVE*/
+
+        //chunks change hands, element addresses survive the move
+        segmented_storage(segmented_storage&& other)noexcept
+            :_chunks(std::move(other._chunks)), _dynmsz(other._dynmsz)
+        {
+            other._dynmsz=0;
+        }
+
+        segmented_storage& operator=(const segmented_storage&)=delete;
+        segmented_storage& operator=(segmented_storage&&)=delete;
+
+        /*RESERVE*/
+
+        //adds chunks until `newcpct` elements fit, nothing moves
+        inline opres rsvcpct(size_t newcpct)noexcept
+        {
+            const size_t need=_nchunks(newcpct);
+            if(need<=_chunks.size())   //noalloc
+                return opres::SUCCESS;
+            while(_chunks.size()<need)
+            {
+                T* c=(T*)Alloc(sizeof(T)*ChunkElems);
+                if(!c) //Alloc fault, the chunks so far stay for later
+                    return opres::MEM_ERR;
+                if(opres res=_chunks.push_back(c); res!=opres::SUCCESS)
+                {
+                    Free(c);
+                    return res;
+                }
+            }
+            return opres::SUCCESS;
+        }
+        //releases chunks no element lives in, returns how many
+        inline size_t shrink()noexcept
+        {
+            const size_t keep=chunks();
+            const size_t dropped=_chunks.size()-keep;
+            for(size_t c=keep; c<_chunks.size(); ++c)
+                Free(_chunks[c]);
+            _chunks.resize(keep);
+            return dropped;
+        }
+
+        /*RESIZE*/
+
+        inline opres resize(size_t newsize)
+            noexcept(std::is_nothrow_default_constructible_v<T>)
+            requires(requires{T();})
+        {
+            if(newsize<=_dynmsz)
+            {
+                _destroy(newsize, _dynmsz);
+                _dynmsz=newsize;
+                return opres::SUCCESS;
+            }
+            if(opres res=rsvcpct(newsize); res!=opres::SUCCESS)
+                return res;
+            //chunk by chunk, size tracks what is constructed
+            while(_dynmsz<newsize)
+            {
+                const size_t run=std::min(newsize-_dynmsz, ChunkElems-(_dynmsz&MASK));
+                std::uninitialized_default_construct_n(&_slot(_dynmsz), run);
+                _dynmsz+=run;
+            }
+            return opres::SUCCESS;
+        }
+
+        /*APPEND*/
+
+        //constructs in place past the end. never moves an element, a full
+        //last chunk just gets a new one after it
+        template<typename...Args>
+        opres inline emplace_back(Args&&...args)
+            noexcept(std::is_nothrow_constructible_v<T, Args...>)
+            requires(requires{T(std::declval<Args>()...);})
+        {
+            if(_dynmsz==capacity())
+                if(opres res=rsvcpct(_dynmsz+1); res!=opres::SUCCESS)
+                    return res;
+            std::construct_at(&_slot(_dynmsz), std::forward<Args>(args)...);
+            ++_dynmsz;
+            return opres::SUCCESS;
+        }
+        //obj may alias an element, which stays where it is, no copy needed
+        opres inline push_back(const T& obj)
+            noexcept(noexcept(emplace_back(std::declval<const T&>())))
+            requires(requires{emplace_back(std::declval<const T&>());})
+        {
+            return emplace_back(obj);
+        }
+        opres inline push_back(T&& obj)
+            noexcept(noexcept(emplace_back(std::declval<T&&>())))
+            requires(requires{emplace_back(std::declval<T&&>());})
+        {
+            return emplace_back(std::move(obj));
+        }
+
+        /*DATA*/
+
+        inline T& _slot(size_t idx)noexcept{return _chunks[idx>>SHIFT][idx&MASK];}
+        //destroys [begin, end) in reverse, a chunk at a time
+        inline void _destroy(size_t begin, size_t end)noexcept(std::is_nothrow_destructible_v<T>)
+        {
+            if constexpr(!std::is_trivially_destructible_v<T>)
+                while(end>begin)
+                {
+                    const size_t from=std::max(begin, (end-1)&~MASK);
+                    T* c=_chunks[from>>SHIFT];
+                    for(size_t i=end; i-->from;)
+                        c[i&MASK].~T();
+                    end=from;
+                }
+        }
+        inline void _release()noexcept(std::is_nothrow_destructible_v<T>)
+        {
+            _destroy(0, _dynmsz);
+            _dynmsz=0;
+            for(T* c : _chunks)
+                Free(c);
+            _chunks.resize(0);
+        }
+
+        /*DESTRUCTOR*/
+
+        ~segmented_storage()noexcept(std::is_nothrow_destructible_v<T>)
+        {
+            _release();
+        }
+    };
+}
@@ -0,0 +1,241 @@
+#pragma once
+
+#include "malc.h"
+#include "opres.h"
+#include "storage.h"
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <type_traits>
+#include <utility>
+
+namespace aico
+{
+    //32 bit handle: low IndexBits pick the slot, the rest are the slot's
+    //generation when the handle was issued. all bits set is never issued
+    template<size_t IndexBits=20>
+    requires(IndexBits>0&&IndexBits<32)
+    struct slot_handle
+    {
+        static constexpr uint32_t INDEX_MASK=(1u<<IndexBits)-1;
+        static constexpr uint32_t GEN_MAX=~0u>>IndexBits;
+
+        uint32_t bits=~0u;
+
+        static constexpr slot_handle make(uint32_t index, uint32_t gen)noexcept
+        {
+            return {index|gen<<IndexBits};
+        }
+        inline constexpr uint32_t index()const noexcept{return bits&INDEX_MASK;}
+        inline constexpr uint32_t gen()const noexcept{return bits>>IndexBits;}
+        inline constexpr bool null()const noexcept{return bits==~0u;}
+        inline constexpr explicit operator bool()const noexcept{return !null();}
+        constexpr bool operator==(const slot_handle&)const noexcept=default;
+    };
+
+    //generational slot map: values packed in a dense storage, a sparse slot
+    //table mapping handles to dense indices. insert, erase and lookup are
+    //O(1), iteration walks the dense values contiguously in no set order.
+    //erase moves the last value into the hole, so pointers into the map
+    //last until the next erase or insert, handles last until their own
+    //erase. a slot whose generation runs out is retired, never reused, so
+    //a stale handle can not alias a newer value
+    template<typename T, size_t IndexBits=20,
+        memalloc_t Alloc=&alloc_bind, memfree_t Free=&sys::rel>
+    requires(std::is_move_constructible_v<T>&&std::is_move_assignable_v<T>)
+    class slot_map
+    {
+    public:
+        using handle_t=slot_handle<IndexBits>;
+    public: //XXX testing
+        static constexpr uint32_t NIL=~0u;
+        static constexpr size_t MAX_SLOTS=size_t(1)<<IndexBits;
+
+        struct slot_t
+        {
+            uint32_t dense;     //dense index while live, next free slot after
+            uint32_t gen;
+        };
+
+        storage<T, DYNAMIC, false, 8, Alloc, Free> _values;
+        storage<uint32_t, DYNAMIC, false, 8, Alloc, Free> _owners; //slot of each value
+        storage<slot_t, DYNAMIC, false, 8, Alloc, Free> _slots;
+        uint32_t _freehead=NIL;
+
+        inline slot_t* _find(handle_t h)noexcept
+        {
+            if(h.index()>=_slots.size())
+                return nullptr;
+            //erase bumps the generation, GEN_MAX only ever marks a retired slot
+            slot_t& s=_slots[h.index()];
+            return s.gen==h.gen()&&s.gen!=handle_t::GEN_MAX?&s:nullptr;
+        }
+        inline const slot_t* _find(handle_t h)const noexcept
+        {
+            return const_cast<slot_map*>(this)->_find(h);
+        }
+        //drops the last value, the rollback of a failed insert
+        inline void _pop()noexcept(std::is_nothrow_destructible_v<T>)
+        {
+            _values.resize(_values.size()-1);
+        }
+    public:
+        /*SIZE*/
+
+        inline size_t size()const noexcept{return _values.size();}
+        inline bool empty()const noexcept{return _values.size()==0;}
+
+        /*LOOKUP*/
+
+        //nullptr for a stale or null handle
+        inline T* get(handle_t h)noexcept
+        {
+            slot_t* s=_find(h);
+            return s?&_values[s->dense]:nullptr;
+        }
+        inline const T* get(handle_t h)const noexcept
+        {
+            const slot_t* s=_find(h);
+            return s?&_values[s->dense]:nullptr;
+        }
+        inline bool contains(handle_t h)const noexcept{return _find(h)!=nullptr;}
+        inline T& operator[](handle_t h)noexcept
+        {
+            T* v=get(h);
+            assert(v && "stale handle");
+            return *v;
+        }
+        inline const T& operator[](handle_t h)const noexcept
+        {
+            const T* v=get(h);
+            assert(v && "stale handle");
+            return *v;
+        }
+
+        /*ITERATION*/
+
+        //live values, contiguous
+        inline       T* begin()      noexcept{return _values.begin();}
+        inline const T* begin()const noexcept{return _values.begin();}
+        inline       T* end()      noexcept{return _values.end();}
+        inline const T* end()const noexcept{return _values.end();}
+        inline std::span<T> values()noexcept{return {begin(), size()};}
+        inline std::span<const T> values()const noexcept{return {begin(), size()};}
+        //handle of the value at dense index `i`, for walks that need both
+        inline handle_t handle_at(size_t i)const noexcept
+        {
+            assert(i<size() && "out of bounds");
+            const uint32_t idx=_owners[i];
+            return handle_t::make(idx, _slots[idx].gen);
+        }
+
+        /*CONSTRUCTOR*/
+
+        slot_map()=default;
+
+            /*COPY*/
+
+        slot_map(const slot_map&)=delete;
+
+            /*MOVE*/
+
+        slot_map(slot_map&& other)noexcept:_values(std::move(other._values)),
+            _owners(std::move(other._owners)), _slots(std::move(other._slots)),
+            _freehead(other._freehead)
+        {
+            other._freehead=NIL;
+        }
+
+        slot_map& operator=(const slot_map&)=delete;
+        slot_map& operator=(slot_map&&)=delete;
+
+        /*RESERVE*/
+
+        inline opres rsvcpct(size_t newcpct)noexcept
+        {
+            if(newcpct>MAX_SLOTS)
+                return opres::BOUNDS_ERR;
+            if(opres res=_values.rsvcpct(newcpct); res!=opres::SUCCESS)
+                return res;
+            if(opres res=_owners.rsvcpct(newcpct); res!=opres::SUCCESS)
+                return res;
+            return _slots.rsvcpct(newcpct);
+        }
+
+        /*INSERT*/
+
+        //null handle on failure: out of memory, or every slot in use or retired
+        template<typename...Args>
+        [[nodiscard]] inline handle_t emplace(Args&&...args)
+            noexcept(std::is_nothrow_constructible_v<T, Args...>)
+            requires(requires{T(std::declval<Args>()...);})
+        {
+            if(_freehead==NIL&&_slots.size()==MAX_SLOTS)
+                return {};
+            if(_values.emplace_back(std::forward<Args>(args)...)!=opres::SUCCESS)
+                return {};
+            uint32_t idx=_freehead;
+            if(idx==NIL)
+            {
+                idx=(uint32_t)_slots.size();
+                if(_slots.push_back(slot_t{0, 0})!=opres::SUCCESS)
+                    return _pop(), handle_t{};
+            }
+            if(_owners.push_back(idx)!=opres::SUCCESS)
+            {
+                if(idx!=_freehead)  //fresh slot, hand it back
+                    _slots.resize(_slots.size()-1);
+                return _pop(), handle_t{};
+            }
+            slot_t& s=_slots[idx];
+            if(idx==_freehead)
+                _freehead=s.dense;
+            s.dense=(uint32_t)_values.size()-1;
+            return handle_t::make(idx, s.gen);
+        }
+        [[nodiscard]] inline handle_t insert(const T& obj)
+            noexcept(noexcept(emplace(obj)))
+        {
+            return emplace(obj);
+        }
+        [[nodiscard]] inline handle_t insert(T&& obj)
+            noexcept(noexcept(emplace(std::move(obj))))
+        {
+            return emplace(std::move(obj));
+        }
+
+        /*ERASE*/
+
+        //the last value moves into the erased one's place
+        inline opres erase(handle_t h)
+            noexcept(std::is_nothrow_move_assignable_v<T>&&std::is_nothrow_destructible_v<T>)
+        {
+            slot_t* s=_find(h);
+            if(!s)
+                return opres::BOUNDS_ERR;
+            const uint32_t hole=s->dense, last=(uint32_t)_values.size()-1;
+            if(hole!=last)
+            {
+                _values[hole]=std::move(_values[last]);
+                _owners[hole]=_owners[last];
+                _slots[_owners[hole]].dense=hole;
+            }
+            _pop();
+            _owners.resize(last);
+            if(++s->gen!=handle_t::GEN_MAX) //else retired
+            {
+                s->dense=_freehead;
+                _freehead=h.index();
+            }
+            return opres::SUCCESS;
+        }
+        //erases every value, outstanding handles go stale
+        inline void clear()noexcept(std::is_nothrow_destructible_v<T>)
+        {
+            while(size())
+                (void)erase(handle_at(size()-1));
+        }
+    };
+}
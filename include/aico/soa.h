@@ -0,0 +1,232 @@
+#pragma once
+
+#include "malc.h"
+#include "opres.h"
+#include "storage.h"
+#include "view.h"
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <span>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace aico
+{
+    //struct-of-arrays: every field in its own array, all of them sharing one
+    //size and one malc block. columns start COL_ALIGN aligned and stay
+    //readable up to the next COL_ALIGN boundary past capacity(), so kernels
+    //may run whole vectors over the tail. fields are trivially copyable,
+    //new elements are left uninitialized like a trivial DYNAMIC storage's
+    template<typename...Fields>
+    requires(sizeof...(Fields)>0&&(std::is_trivially_copyable_v<Fields>&&...))
+    class soa_storage
+    {
+    public: //XXX testing
+        static constexpr size_t COL_ALIGN=64;
+        static constexpr size_t Mincpct=8;
+        static constexpr size_t NFIELDS=sizeof...(Fields);
+        using fields_t=std::tuple<Fields...>;
+        template<size_t I>
+        using field_t=std::tuple_element_t<I, fields_t>;
+
+        std::tuple<Fields*...> _cols{};
+        size_t _dynmsz=0;
+        size_t _capacity=0;
+
+        inline static constexpr size_t _colbytes(size_t bytes)noexcept
+        {
+            return (bytes+COL_ALIGN-1)&~(COL_ALIGN-1);
+        }
+        inline static constexpr size_t _blockbytes(size_t cpct)noexcept
+        {
+            return (_colbytes(cpct*sizeof(Fields))+...);
+        }
+        inline void* _block()const noexcept{return (void*)std::get<0>(_cols);}
+    public:
+        /*SIZE*/
+
+        inline size_t size()const noexcept{return _dynmsz;}
+        inline size_t capacity()const noexcept{return _capacity;}
+
+        /*COLUMNS*/
+
+        //zero-copy view of field I, valid until the next reallocation
+        template<size_t I>
+        inline std::span<field_t<I>> column()noexcept
+        {
+            return {std::get<I>(_cols), _dynmsz};
+        }
+        template<size_t I>
+        inline std::span<const field_t<I>> column()const noexcept
+        {
+            return {std::get<I>(_cols), _dynmsz};
+        }
+        template<size_t I>
+        inline field_t<I>* data()noexcept{return std::get<I>(_cols);}
+        template<size_t I>
+        inline const field_t<I>* data()const noexcept{return std::get<I>(_cols);}
+
+        /*INDEXING*/
+
+        template<size_t I>
+        inline field_t<I>& at(size_t idx)noexcept
+        {
+            assert(idx<this->size() && "out of bounds");
+            return std::get<I>(_cols)[idx];
+        }
+        template<size_t I>
+        inline const field_t<I>& at(size_t idx)const noexcept
+        {
+            assert(idx<this->size() && "out of bounds");
+            return std::get<I>(_cols)[idx];
+        }
+        //every field of one element
+        inline std::tuple<Fields&...> operator[](size_t idx)noexcept
+        {
+            assert(idx<this->size() && "out of bounds");
+            return std::apply([idx](Fields*...cols){return std::tie(cols[idx]...);}, _cols);
+        }
+        inline std::tuple<const Fields&...> operator[](size_t idx)const noexcept
+        {
+            assert(idx<this->size() && "out of bounds");
+            return std::apply([idx](Fields*...cols)
+                {return std::tuple<const Fields&...>(cols[idx]...);}, _cols);
+        }
+
+        /*CONSTRUCTOR*/
+
+        soa_storage()
+        {
+            if(rsvcpct(Mincpct)!=opres::SUCCESS)
+                throw std::bad_alloc();
+        }
+        //fields are left uninitialized
+        explicit soa_storage(size_t dynamic_size)
+        {
+            if(rsvcpct(std::max(Mincpct, dynamic_size))!=opres::SUCCESS)
+                throw std::bad_alloc();
+            _dynmsz=dynamic_size;
+        }
+
+            /*COPY*/
+
+        soa_storage(const soa_storage&)=delete;
+
+            /*MOVE*/
+
+        soa_storage(soa_storage&& other)noexcept:_cols(other._cols),
+            _dynmsz(other._dynmsz), _capacity(other._capacity)
+        {
+            other._cols={};
+            other._dynmsz=0;
+            other._capacity=0;
+        }
+
+        soa_storage& operator=(const soa_storage&)=delete;
+        soa_storage& operator=(soa_storage&&)=delete;
+
+        /*RESERVE*/
+
+        inline opres rsvcpct(size_t newcpct)noexcept
+        {
+            if(newcpct<=_capacity)   //noalloc
+                return opres::SUCCESS;
+            opres res=opres::SUCCESS;
+            char* block=(char*)sys::malc(_blockbytes(newcpct), COL_ALIGN, &res);
+            if(!block)
+                return res==opres::SUCCESS?opres::MEM_ERR:res;
+            std::tuple<Fields*...> cols;
+            [&]<size_t...I>(std::index_sequence<I...>)
+            {
+                size_t offset=0;
+                ((std::get<I>(cols)=(field_t<I>*)(block+offset),
+                    offset+=_colbytes(newcpct*sizeof(field_t<I>))), ...);
+                if(_dynmsz)
+                    (std::memcpy((void*)std::get<I>(cols), (const void*)std::get<I>(_cols),
+                        _dynmsz*sizeof(field_t<I>)), ...);
+            }(std::index_sequence_for<Fields...>{});
+            sys::rel(_block());
+            _cols=cols;
+            _capacity=newcpct;
+            return opres::SUCCESS;
+        }
+
+        /*RESIZE*/
+
+        //new fields are left uninitialized
+        inline opres resize(size_t newsize)noexcept
+        {
+            if(newsize>_capacity)
+                if(opres res=rsvcpct(std::max(newsize, grow_geometric(_capacity, newsize)));
+                    res!=opres::SUCCESS)
+                    return res;
+            _dynmsz=newsize;
+            return opres::SUCCESS;
+        }
+
+        /*APPEND*/
+
+        opres inline push_back(const Fields&...fields)noexcept
+        {
+            if(_dynmsz==_capacity)
+                if(opres res=rsvcpct(grow_geometric(_capacity, _dynmsz+1));
+                    res!=opres::SUCCESS)
+                    return res;
+            std::apply([&](Fields*...cols){((cols[_dynmsz]=fields), ...);}, _cols);
+            ++_dynmsz;
+            return opres::SUCCESS;
+        }
+
+        /*CONVERSION*/
+
+        //replaces the contents with `n` structs, Members name the struct
+        //member feeding each field, in field order:
+        //soa.from_aos<&vertex::pos, &vertex::normal, &vertex::uv>(vtx.begin(), n)
+        template<auto...Members, typename S>
+        requires(sizeof...(Members)==NFIELDS&&
+            (std::is_same_v<typename member_of<Members>::owner, S>&&...)&&
+            (std::is_same_v<typename member_of<Members>::type, Fields>&&...))
+        inline opres from_aos(const S* src, size_t n)noexcept
+        {
+            if(opres res=resize(n); res!=opres::SUCCESS)
+                return res;
+            //one pass over the structs, every column written sequentially
+            std::apply([src, n](Fields*...cols)
+                {
+                    for(size_t i=0; i<n; ++i)
+                        ((cols[i]=src[i].*Members), ...);
+                }, _cols);
+            return opres::SUCCESS;
+        }
+        //writes every element into `dst`, which holds at least size() structs.
+        //members not named are left untouched
+        template<auto...Members, typename S>
+        requires(sizeof...(Members)==NFIELDS&&
+            (std::is_same_v<typename member_of<Members>::owner, S>&&...)&&
+            (std::is_same_v<typename member_of<Members>::type, Fields>&&...))
+        inline void to_aos(S* dst)const noexcept
+        {
+            std::apply([dst, n=_dynmsz](Fields*...cols)
+                {
+                    for(size_t i=0; i<n; ++i)
+                        ((dst[i].*Members=cols[i]), ...);
+                }, _cols);
+        }
+
+        /*DESTRUCTOR*/
+
+        ~soa_storage()noexcept
+        {
+            sys::rel(_block());
+        }
+    };
+
+    //the soa_storage holding the given struct members, in that order
+    template<auto...Members>
+    using soa_of=soa_storage<typename member_of<Members>::type...>;
+}
@@ -5,16 +5,23 @@
 #include "opres.h"
 
 #include <algorithm>
+#include <bit>
 #include <cassert>
 #include <cstddef>
 #include <cstdint>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <functional>
 #include <memory>
 #include <new>
 #include <type_traits>
 
+#if defined(__SSE2__)||defined(_M_X64)
+#include <emmintrin.h>
+#define AICO_BITS_SSE2 1
+#endif
+
 namespace aico
 {
 
@@ -103,15 +110,171 @@ namespace aico
                 }
             }
         }
+    /*BITMAPS*/
+
+    //bit i lives in byte i/8 at position i%8. bitmaps have no alignment
+    //guarantee (storage keeps them right past its elements), words are
+    //assembled with memcpy, which compiles down to plain unaligned loads
+
+    //the 64 bits starting at bit 64*word, only the first `bytes` bytes are
+    //read, the rest are zero
+    inline uint64_t bits_word(const uint8_t* bits, size_t word, size_t bytes=8)noexcept
+    {
+        uint64_t w=0;
+        std::memcpy(&w, bits+8*word, bytes);
+        if constexpr(std::endian::native==std::endian::big)
+            w=__builtin_bswap64(w);
+        return w;
+    }
+    //ones at bit positions [from, to) of a word, 0<=from<=to<=64
+    inline constexpr uint64_t bits_mask(size_t from, size_t to)noexcept
+    {
+        const uint64_t hi=to==64?~0ull:(1ull<<to)-1;
+        return hi&~((1ull<<from)-1);
+    }
+
+    //sets or clears bits [begin, end): partial bytes at both ends, memset
+    //in between
+    inline void bits_fill(uint8_t* bits, size_t begin, size_t end, bool value)noexcept
+    {
+        if(begin>=end)
+            return;
+        size_t first=begin/8, last=(end-1)/8;
+        const uint8_t head=(uint8_t)(0xFFu<<(begin%8));
+        const uint8_t tail=(uint8_t)(0xFFu>>(7-(end-1)%8));
+        if(first==last)
+        {
+            const uint8_t m=head&tail;
+            bits[first]=value?(uint8_t)(bits[first]|m):(uint8_t)(bits[first]&~m);
+            return;
+        }
+        bits[first]=value?(uint8_t)(bits[first]|head):(uint8_t)(bits[first]&~head);
+        bits[last]=value?(uint8_t)(bits[last]|tail):(uint8_t)(bits[last]&~tail);
+        if(last>first+1)
+            std::memset(bits+first+1, value?0xFF:0x00, last-first-1);
+    }
+
+    //whether the first n bits are all `value`. 64 bytes per step, folded into
+    //one vector and tested once
+    inline bool bits_all(const uint8_t* bits, size_t n, bool value)noexcept
+    {
+        const size_t full=n/8;
+        size_t i=0;
+#ifdef AICO_BITS_SSE2
+        const __m128i want=value?_mm_set1_epi8((char)0xFF):_mm_setzero_si128();
+        for(; i+64<=full; i+=64)
+        {
+            const __m128i a=_mm_loadu_si128((const __m128i*)(bits+i));
+            const __m128i b=_mm_loadu_si128((const __m128i*)(bits+i+16));
+            const __m128i c=_mm_loadu_si128((const __m128i*)(bits+i+32));
+            const __m128i d=_mm_loadu_si128((const __m128i*)(bits+i+48));
+            const __m128i acc=value?_mm_and_si128(_mm_and_si128(a, b), _mm_and_si128(c, d)):
+                _mm_or_si128(_mm_or_si128(a, b), _mm_or_si128(c, d));
+            if(_mm_movemask_epi8(_mm_cmpeq_epi8(acc, want))!=0xFFFF)
+                return false;
+        }
+#endif
+        const uint64_t want64=value?~0ull:0ull;
+        for(; i+8<=full; i+=8)
+            if(bits_word(bits, i/8)!=want64)
+                return false;
+        for(; i<full; ++i)
+            if(bits[i]!=(uint8_t)want64)
+                return false;
+        if(const size_t rem=n%8; rem)
+        {
+            const uint8_t m=(uint8_t)((1u<<rem)-1);
+            if((bits[full]&m)!=(value?m:0))
+                return false;
+        }
+        return true;
+    }
+
+    //indices of set bits in [begin, end), ascending. one count-trailing-zeros
+    //per set bit and one load per 64 bits, runs of clear bits cost nothing
+    //per bit
+    struct bit_iterator
+    {
+        const uint8_t* bits;
+        size_t word;        //index of the word `cur` came from
+        size_t end;
+        uint64_t cur;       //unvisited set bits of `word`
+
+        inline uint64_t _load(size_t w)const noexcept
+        {
+            const size_t bytes=std::min<size_t>(8, (end+7)/8-8*w);
+            uint64_t v=bits_word(bits, w, bytes);
+            if(64*w+64>end)
+                v&=bits_mask(0, end-64*w);
+            return v;
+        }
+        inline void _settle()noexcept
+        {
+            const size_t words=(end+63)/64;
+            while(!cur&&++word<words)
+                cur=_load(word);
+        }
+        bit_iterator(const uint8_t* bits, size_t begin, size_t end)noexcept:
+            bits(bits), word(begin/64), end(end), cur(0)
+        {
+            if(begin>=end)
+            {
+                word=(end+63)/64;
+                return;
+            }
+            cur=_load(word)&bits_mask(begin%64, 64);
+            _settle();
+        }
+        inline size_t operator*()const noexcept{return 64*word+(size_t)std::countr_zero(cur);}
+        inline bit_iterator& operator++()noexcept
+        {
+            cur&=cur-1;
+            _settle();
+            return *this;
+        }
+        inline bool done()const noexcept{return !cur;}
+        //range-for sentinel
+        struct sentinel{};
+        inline bool operator!=(sentinel)const noexcept{return cur!=0;}
+    };
+    struct bit_range
+    {
+        const uint8_t* bits;
+        size_t begin_, end_;
+        inline bit_iterator begin()const noexcept{return {bits, begin_, end_};}
+        inline bit_iterator::sentinel end()const noexcept{return {};}
+    };
+
 inline constexpr size_t DYNAMIC = 0;
 
 typedef void*(*memalloc_t)(size_t);
 typedef void(*memfree_t)(void*);
 
 inline void* alloc_bind(size_t sz){return sys::malc(sz);}
+//charges every allocation to `Tag`, whatever tag_scope is active, e.g.
+//storage<Vertex, DYNAMIC, false, 8, &alloc_tagged<TAG_MESH>>
+template<sys::memtag_t Tag>
+inline void* alloc_tagged(size_t sz){return sys::malc(sz, alignof(sys::hdr_t), nullptr, Tag);}
+
+//function pointer identity as a constant expression, `A==B` is not one for
+//every pair of inline functions
+template<auto A, decltype(A) B>
+inline constexpr bool same_fn=std::is_same_v<std::integral_constant<decltype(A), A>,
+    std::integral_constant<decltype(A), B>>;
+
+//capacity to reserve when `needed` elements no longer fit in `cpct`.
+//must return >= needed
+typedef size_t(*growth_t)(size_t cpct, size_t needed);
+
+//doubles, amortized O(1) push_back
+inline constexpr size_t grow_geometric(size_t cpct, size_t needed)
+{return std::max(needed, 2*cpct);}
+//tight, one allocation per push_back unless sys::regrow extends in place
+inline constexpr size_t grow_exact(size_t, size_t needed){return needed;}
 
 template <typename T, size_t dim=DYNAMIC, bool inlined=(dim!=DYNAMIC), 
-    size_t Mincpct=8, memalloc_t Alloc=&alloc_bind, memfree_t Free=&sys::rel>
+    size_t Mincpct=8, memalloc_t Alloc=&alloc_bind, memfree_t Free=&sys::rel,
+    growth_t Growth=&grow_geometric>
 requires (!(inlined && dim == DYNAMIC)&&Mincpct>0)
 class storage
 {
@@ -131,7 +294,8 @@ public: //XXX testing
             operator U()const{return U(0);}
     };
 
-    template<typename, size_t sz, bool inl, size_t Mcpt, memalloc_t, memfree_t>
+    template<typename, size_t sz, bool inl, size_t Mcpt, memalloc_t, memfree_t, 
+        growth_t>
         requires (!(inl && sz == DYNAMIC)&&Mcpt>0)
             friend class storage;
 
@@ -164,9 +328,14 @@ public:
         if(_alivebits) _alivebits[idx/8]&=~(1<<idx%8);
     }
 
-    //TODO handle partial bytes
-    inline void _setbits(size_t begin, size_t end)noexcept requires(Alivebit_Cond);
-    inline void _unsetbits(size_t begin, size_t end)noexcept requires(Alivebit_Cond);
+    inline void _setbits(size_t begin, size_t end)noexcept requires(Alivebit_Cond)
+    {
+        if(_alivebits) bits_fill(_alivebits, begin, end, true);
+    }
+    inline void _unsetbits(size_t begin, size_t end)noexcept requires(Alivebit_Cond)
+    {
+        if(_alivebits) bits_fill(_alivebits, begin, end, false);
+    }
 
     inline void _setdallbits()noexcept requires(Alivebit_Cond)
     {
@@ -184,45 +353,19 @@ public:
     }
     inline bool _allalive() const noexcept requires(Alivebit_Cond)
     {
-        if(!_alivebits)
-            return true;
-
-        const size_t full_bytes = _dynmsz / 8;
-        const size_t rem_bits   = _dynmsz % 8;
-
-        for (size_t i = 0; i < full_bytes; ++i)
-            if (_alivebits[i] != 0xFF)
-                return false;
-
-        if (rem_bits > 0)
-        {
-            uint8_t mask = (1 << rem_bits) - 1; // lower `rem_bits` set
-            if ((_alivebits[full_bytes] & mask) != mask)
-                return false;
-        }
-
-        return true;
+        return !_alivebits||bits_all(_alivebits, _dynmsz, true);
     }
     inline bool _alldead() const noexcept requires(Alivebit_Cond)
     {
-        if(!_alivebits)
-            return false;
-
-        const size_t full_bytes = _dynmsz / 8;
-        const size_t rem_bits   = _dynmsz % 8;
-
-        for (size_t i = 0; i < full_bytes; ++i)
-            if (_alivebits[i] != 0x00)
-                return false;
-
-        if (rem_bits > 0)
-        {
-            uint8_t mask = (1 << rem_bits) - 1; // lower `rem_bits` set
-            if ((_alivebits[full_bytes] & mask) != 0x00)
-                return false;
-        }
-
-        return true;
+        return _alivebits&&bits_all(_alivebits, _dynmsz, false);
+    }
+    //indices of the live elements in [begin, end), ascending. only meaningful
+    //while _alivebits is set, everything is alive otherwise
+    inline bit_range _alive_range(size_t begin, size_t end)const noexcept
+        requires(Alivebit_Cond)
+    {
+        assert(_alivebits);
+        return {_alivebits, begin, end};
     }
     
 public:
@@ -452,16 +595,25 @@ public:
                     (--end)->~T();
                 return;
             }
-            size_t idx=end-_data;//T* arithmetic, one past the end
-            while(end!=begin)
+            //live ones in reverse, a word of bits at a time, highest set
+            //bit first
+            const size_t lo=begin-_data, hi=end-_data;
+            if(lo>=hi)
+                return;
+            for(size_t w=(hi+63)/64; w-->lo/64;)
             {
-                --end; --idx;
-                if(_alive(idx))
+                uint64_t live=bits_word(_alivebits, w, std::min<size_t>(8, _n_bytes(hi)-8*w))&
+                    bits_mask(lo>64*w?lo-64*w:0, std::min<size_t>(64, hi-64*w));
+                while(live)
                 {
-                    end->~T();
-                    _unsetbit(idx);
+                    const size_t bit=63-(size_t)std::countl_zero(live);
+                    live&=~(1ull<<bit);
+                    if constexpr(!std::is_nothrow_destructible_v<T>)
+                        _unsetbit(64*w+bit);//dead even if it throws
+                    (_data+64*w+bit)->~T();
                 }
             }
+            _unsetbits(lo, hi);
         }
 
     }
@@ -481,6 +633,18 @@ public:
         if(newcpct<=this->_capacity)   //noalloc
             return opres::SUCCESS;
         
+        //trivially relocatable and malc backed, try growing without a copy.
+        //anything sys::rel can free came from malc, tag included
+        if constexpr(!Alivebit_Cond&&std::is_trivially_copyable_v<T>&&
+            same_fn<Free, &sys::rel>)
+            if(_data)
+                if(T* grown=(T*)sys::regrow(_data, sizeof(T)*newcpct); grown)
+                {
+                    _data=grown;
+                    _capacity=newcpct;
+                    return opres::SUCCESS;
+                }
+
         const size_t extra=Alivebit_Cond&&_alivebits?_n_bytes(newcpct):0;
         T* newaddr=(T*)Alloc(sizeof(T)*newcpct+extra);
         if(!newaddr) //Alloc fault
@@ -488,28 +652,30 @@ public:
         
         const bool maybe_uninitialized=(Alivebit_Cond&&_alivebits);
         if constexpr (!Alivebit_Cond&&std::is_trivially_copyable_v<T>) //happy path
-            memcpy(newaddr, _data, size()*sizeof(T));
-        else if(size_t constructed=0; maybe_uninitialized) try//slow, branching
+        {
+            if(size())  //_data may be null
+                memcpy(newaddr, _data, size()*sizeof(T));
+        }
+        else if(size_t constructed=0; maybe_uninitialized) try//live ones only
             {
-                for(size_t i=0; i<_dynmsz; ++i)
-                    if(_alive(i))
-                    {
-                        if constexpr(std::is_move_constructible_v<T>)
-                        {
-                            new (newaddr+i) T(std::move(this->at(i)));
-                            constructed++;
-                        }
-                        else
-                        {
-                            new (newaddr+i) T(this->at(i));
-                            constructed++;
-                        }
-                    }
+                for(const size_t i : _alive_range(0, _dynmsz))
+                {
+                    if constexpr(std::is_move_constructible_v<T>)
+                        new (newaddr+i) T(std::move(this->at(i)));
+                    else
+                        new (newaddr+i) T(this->at(i));
+                    constructed++;
+                }
             }
         catch(...)
         {
-            for(size_t i=constructed; i!=0; --i)
-                (newaddr+i-1)->~T();
+            //the first `constructed` live indices made it over
+            for(const size_t i : _alive_range(0, _dynmsz))
+            {
+                if(constructed--==0)
+                    break;
+                (newaddr+i)->~T();
+            }
             Free(newaddr);
             throw;
         }
@@ -566,8 +732,8 @@ public:
         if(res==opres::SUCCESS)
             this->_dynmsz=newsize;
         //init new bits to false
-        if constexpr(Alivebit_Cond)if(res==opres::SUCCESS&&_alivebits)
-                for(size_t i=oldsize; i<newsize; ++i) _unsetbit(i);
+        if constexpr(Alivebit_Cond)if(res==opres::SUCCESS)
+            _unsetbits(oldsize, newsize);
         return res;
     }
     //performs no initialization
@@ -589,8 +755,8 @@ public:
         if(newsize>oldsize&&res==opres::SUCCESS)
         {
             std::uninitialized_default_construct_n(_data+oldsize, newsize-oldsize);
-            if constexpr(Alivebit_Cond)if(_alivebits)
-                for(size_t i=oldsize; i<newsize; ++i) _setbit(i);
+            if constexpr(Alivebit_Cond)
+                _setbits(oldsize, newsize);
         }
         return res;
     }
@@ -605,8 +771,8 @@ public:
         if(newsize>oldsize&&res==opres::SUCCESS)
         {
             std::uninitialized_fill_n(this->begin()+oldsize, newsize-oldsize, fillval);
-            if constexpr(Alivebit_Cond)if(_alivebits)
-                for(size_t i=oldsize; i<newsize; ++i) _setbit(i);
+            if constexpr(Alivebit_Cond)
+                _setbits(oldsize, newsize);
         }
         return res;
     }
@@ -666,26 +832,25 @@ public:
        
         if constexpr(Alivebit_Cond)if(_alivebits)
         {
-            for(size_t i=fromidx; i<fromidx+n_elements; ++i)
-                if(this->_alive(i))//copy construct alive elements*/
-                    try
-                    {
-                        //we subtract fromidx so that destination starts at 0
-                        std::construct_at(&resdata[i-fromidx],
-                            this->at(i));
-                    }
-                    catch(...)//destroy every live object in reverse order
-                    {
-                        if constexpr(!std::is_trivially_destructible_v<U>)
-                            for(size_t j=i-fromidx; j-->0;)//j=num ctd elems
-                                try
-                                {
-                                    if(_alive(fromidx+j)) (resdata+j)->~U();
-                                }
-                                catch(...){OthrFree(resdata); throw;}
-                        OthrFree(resdata);
-                        throw;
-                    }
+            for(const size_t i : _alive_range(fromidx, fromidx+n_elements))
+                try //copy construct alive elements
+                {
+                    //we subtract fromidx so that destination starts at 0
+                    std::construct_at(&resdata[i-fromidx],
+                        this->at(i));
+                }
+                catch(...)//destroy every live object in reverse order
+                {
+                    if constexpr(!std::is_trivially_destructible_v<U>)
+                        for(size_t j=i-fromidx; j-->0;)//j=num ctd elems
+                            try
+                            {
+                                if(_alive(fromidx+j)) (resdata+j)->~U();
+                            }
+                            catch(...){OthrFree(resdata); throw;}
+                    OthrFree(resdata);
+                    throw;
+                }
             ret_t result((U*)resdata, (size_t)n_elements, _alivebits, fromidx);
             if(res) *res=opres::SUCCESS;
             return result;
@@ -752,9 +917,9 @@ public:
     //(constructed) by this function 
     template<typename U=T, 
         size_t OthrMincpt=Mincpct, 
-        memalloc_t OthrAlloc=Alloc, memfree_t OthrFree=Free>
+        memalloc_t OthrAlloc=Alloc, memfree_t OthrFree=Free, growth_t OthrGrowth=Growth>
     inline opres copyinto(
-            storage<U, DYNAMIC, false, OthrMincpt, OthrAlloc, OthrFree>&dst,
+            storage<U, DYNAMIC, false, OthrMincpt, OthrAlloc, OthrFree, OthrGrowth>&dst,
             size_t n_elements,
             size_t dst_startidx=0, 
             size_t src_startidx=0,
@@ -773,11 +938,11 @@ public:
         opres res=copyinto(dst._data, n_elements, dst_startidx, src_startidx, 
             initialize);
 
-        typedef storage<U, DYNAMIC, false, OthrMincpt, OthrAlloc, OthrFree> ret_t;
+        typedef storage<U, DYNAMIC, false, OthrMincpt, OthrAlloc, OthrFree, OthrGrowth> 
+            ret_t;
         if(res==opres::SUCCESS)
-            if constexpr(ret_t::Alivebit_Cond)if(dst._alivebits)
-                for(size_t i=dst_startidx; i<dst_startidx+n_elements; ++i)
-                    dst._setbit(i);
+            if constexpr(ret_t::Alivebit_Cond)
+                dst._setbits(dst_startidx, dst_startidx+n_elements);
         return res;
     }
     
@@ -826,10 +991,10 @@ public:
     //(constructed) by this function
     template<typename U=T, 
         size_t OthrMincpt=Mincpct, 
-        memalloc_t OthrAlloc=Alloc, memfree_t OthrFree=Free>
+        memalloc_t OthrAlloc=Alloc, memfree_t OthrFree=Free, growth_t OthrGrowth=Growth>
     inline opres move(
                 size_t n_elements,
-                storage<U, DYNAMIC, false, OthrMincpt, OthrAlloc, OthrFree>&dst,
+                storage<U, DYNAMIC, false, OthrMincpt, OthrAlloc, OthrFree, OthrGrowth>&dst,
                 size_t dst_startidx=0,
                 size_t src_startidx=0,
                 bool initialize=false
@@ -849,10 +1014,10 @@ public:
         if(initialize)
         {
             std::uninitialized_move(start, start+n_elements, dst.begin()+dst_startidx);
-            typedef storage<U, DYNAMIC, false, OthrMincpt, OthrAlloc, OthrFree> ret_t;
-            if constexpr (ret_t::Alivebit_Cond)if(dst._alivebits)
-                for(size_t i=dst_startidx; i<dst_startidx+n_elements; ++i)
-                    dst._setbit(i);
+            typedef storage<U, DYNAMIC, false, OthrMincpt, OthrAlloc, OthrFree, 
+                OthrGrowth> ret_t;
+            if constexpr (ret_t::Alivebit_Cond)
+                dst._setbits(dst_startidx, dst_startidx+n_elements);
         }
         else
         {
@@ -874,18 +1039,58 @@ public:
         if constexpr(Alivebit_Cond) _setbit(idx);
     }
 
+    //constructs in place past the end, capacity grows by Growth so a run of
+    //N calls costs O(N) moves. on throw, size is unchanged
+    template<typename...Args>
+    opres inline emplace_back(Args&&...args)
+    noexcept(noexcept(rsvcpct(std::declval<size_t>()))&&
+        std::is_nothrow_constructible_v<T, Args...>)
+    requires(dim==DYNAMIC&&requires{T(std::declval<Args>()...);}&&
+        requires{rsvcpct(std::declval<size_t>());})
+    {
+        if(_dynmsz==_capacity)
+        {
+            const size_t newcpct=std::max(Mincpct, Growth(_capacity, _dynmsz+1));
+            assert(newcpct>_dynmsz && "growth policy must make room");
+            if(opres res=rsvcpct(newcpct); res!=opres::SUCCESS)
+                return res;
+        }
+        std::construct_at(_data+_dynmsz, std::forward<Args>(args)...);
+        if constexpr(Alivebit_Cond) _setbit(_dynmsz);
+        ++_dynmsz;
+        return opres::SUCCESS;
+    }
+
+    //whether p points into [begin(), end()). std::less and friends give a
+    //total order even for pointers into unrelated objects, < does not
+    inline bool _owns(const T* p)const noexcept
+    {
+        return std::greater_equal<const T*>{}(p, begin())&&std::less<const T*>{}(p, end());
+    }
+
     opres inline push_back(const T& obj)
-    noexcept(noexcept(resize(std::declval<size_t>(), std::declval<const T&>())))
-    requires(requires{resize(std::declval<size_t>(), std::declval<const T&>());})
+    noexcept(noexcept(emplace_back(std::declval<const T&>())))
+    requires(requires{emplace_back(std::declval<const T&>());})
     {
-        return resize(size()+1, std::forward<const T&>(obj));
+        //obj may live in _data, which a reallocation would pull out from under it
+        if(_dynmsz==_capacity&&_owns(&obj))
+        {
+            const T tmp(obj);
+            return emplace_back(tmp);
+        }
+        return emplace_back(obj);
     }
     
     opres inline push_back(T&& obj)
-    noexcept(noexcept(resize(std::declval<size_t>(), std::declval<T&&>())))
-    requires(requires{resize(std::declval<size_t>(), std::declval<T&&>());})
+    noexcept(noexcept(emplace_back(std::declval<T&&>())))
+    requires(requires{emplace_back(std::declval<T&&>());})
     {
-        return resize(size()+1, std::forward<T&&>(obj));
+        if(_dynmsz==_capacity&&_owns(&obj))
+        {
+            T tmp(std::move(obj));
+            return emplace_back(std::move(tmp));
+        }
+        return emplace_back(std::move(obj));
     }
     /*DESTRUCTOR*/
     
@@ -0,0 +1,142 @@
+#pragma once
+
+#include "storage.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <span>
+#include <type_traits>
+
+namespace aico
+{
+    //owner and type of the member a member pointer points at, e.g.
+    //member_of<&vertex::pos>::type is vec3
+    template<auto Member>
+    struct member_of;
+    template<typename S, typename M, M S::*Member>
+    struct member_of<Member>
+    {
+        using owner=S;
+        using type=M;
+    };
+
+    //non-owning view of `size()` elements `stride()` bytes apart, for
+    //handing out a slice of a storage, or one member of every element of
+    //one, without a copy. valid as long as what it looks at. converts
+    //from any storage, whose elements must all be alive, and from spans
+    template<typename T>
+    class storage_view
+    {
+    public: //XXX testing
+        using byte_t=std::conditional_t<std::is_const_v<T>, const char, char>;
+
+        T* _data=nullptr;
+        size_t _size=0;
+        size_t _stride=sizeof(T);
+
+        inline T* _elem(size_t idx)const noexcept{return (T*)((byte_t*)_data+idx*_stride);}
+    public:
+        static constexpr size_t npos=~size_t(0);
+
+        /*SIZE*/
+
+        inline constexpr size_t size()const noexcept{return _size;}
+        inline constexpr bool empty()const noexcept{return _size==0;}
+        //bytes from one element to the next
+        inline constexpr size_t stride()const noexcept{return _stride;}
+        inline constexpr bool contiguous()const noexcept{return _stride==sizeof(T);}
+        inline constexpr T* data()const noexcept{return _data;}
+
+        /*INDEXING*/
+
+        inline T& at(size_t idx)const noexcept
+        {
+            assert(idx<this->size() && "out of bounds");
+            return *_elem(idx);
+        }
+        inline T& operator[](size_t idx)const noexcept{return at(idx);}
+
+        /*ITERATION*/
+
+        struct iterator
+        {
+            using iterator_category=std::forward_iterator_tag;
+            using value_type=std::remove_const_t<T>;
+            using difference_type=ptrdiff_t;
+            using pointer=T*;
+            using reference=T&;
+
+            byte_t* p=nullptr;
+            size_t stride=0;
+
+            inline T& operator*()const noexcept{return *(T*)p;}
+            inline T* operator->()const noexcept{return (T*)p;}
+            inline iterator& operator++()noexcept{p+=stride; return *this;}
+            inline iterator operator++(int)noexcept{iterator it=*this; p+=stride; return it;}
+            bool operator==(const iterator&)const noexcept=default;
+        };
+        inline iterator begin()const noexcept{return {(byte_t*)_data, _stride};}
+        inline iterator end()const noexcept{return {(byte_t*)_elem(_size), _stride};}
+
+        /*CONSTRUCTOR*/
+
+        constexpr storage_view()noexcept=default;
+        constexpr storage_view(T* data, size_t n, size_t stride=sizeof(T))noexcept:
+            _data(data), _size(n), _stride(stride){}
+        template<typename U, size_t E>
+        constexpr storage_view(std::span<U, E> s)noexcept
+            requires(std::is_convertible_v<U(*)[], T(*)[]>):_data(s.data()), _size(s.size()){}
+        template<size_t dim, bool inl, size_t Mcpt, memalloc_t A, memfree_t F, growth_t G>
+        storage_view(storage<std::remove_const_t<T>, dim, inl, Mcpt, A, F, G>& s)noexcept:
+            _data(s.begin()), _size(s.size()){}
+        template<size_t dim, bool inl, size_t Mcpt, memalloc_t A, memfree_t F, growth_t G>
+        storage_view(const storage<std::remove_const_t<T>, dim, inl, Mcpt, A, F, G>& s)noexcept
+            requires(std::is_const_v<T>):_data(s.begin()), _size(s.size()){}
+        //adds const
+        template<typename U>
+        constexpr storage_view(storage_view<U> v)noexcept
+            requires(std::is_same_v<const U, T>&&!std::is_same_v<U, T>):
+            _data(v.data()), _size(v.size()), _stride(v.stride()){}
+
+        /*SLICING*/
+
+        //`count` elements from `first`, or all of the rest
+        inline storage_view subview(size_t first, size_t count=npos)const noexcept
+        {
+            assert(first<=size() && "out of bounds");
+            count=std::min(count, size()-first);
+            return {count?_elem(first):_data, count, _stride};
+        }
+        //every `step`th element from the first
+        inline storage_view every(size_t step)const noexcept
+        {
+            assert(step>0);
+            return {_data, (_size+step-1)/step, _stride*step};
+        }
+        //one member of every element: view.member<&vertex::normal>()
+        template<auto Member>
+        requires(std::is_same_v<typename member_of<Member>::owner, std::remove_const_t<T>>)
+        inline auto member()const noexcept
+        {
+            using M=std::conditional_t<std::is_const_v<T>,
+                const typename member_of<Member>::type, typename member_of<Member>::type>;
+            return storage_view<M>(_data?std::addressof(_data->*Member):nullptr, _size, _stride);
+        }
+        inline std::span<T> span()const noexcept
+        {
+            assert(contiguous() && "strided view");
+            return {_data, _size};
+        }
+    };
+
+    template<typename T, size_t dim, bool inl, size_t Mcpt, memalloc_t A, memfree_t F, growth_t G>
+    storage_view(storage<T, dim, inl, Mcpt, A, F, G>&)->storage_view<T>;
+    template<typename T, size_t dim, bool inl, size_t Mcpt, memalloc_t A, memfree_t F, growth_t G>
+    storage_view(const storage<T, dim, inl, Mcpt, A, F, G>&)->storage_view<const T>;
+    template<typename T, size_t E>
+    storage_view(std::span<T, E>)->storage_view<T>;
+}
@@ -11,6 +11,9 @@ namespace aico{struct gfxctx; struct gfxconf_t;}
 
 namespace aico::sys
 {
+    struct arena;
+    struct retire_queue;
+
     /**
      * @class wndctx
      * @brief RAII wrapper responsible for initializing and terminating a 
@@ -28,7 +31,24 @@ namespace aico::sys
          * @struct frameinfo
          * @brief per-frame information, passed to the render function.
          */
-        struct frameinfo {};
+        struct frameinfo 
+        {
+            /**
+             * @brief Scratch arena for this frame, also bound to
+             * sys::bound_arena() for the duration of the render call.
+             * Two arenas alternate, so memory from frame N stays valid
+             * through frame N+1 and is reset when frame N+2 begins.
+             */
+            arena* scratch = nullptr;
+            /**
+             * @brief Deferred releases, also bound to sys::bound_retire()
+             * for the duration of the render call. Memory and GL objects
+             * handed to it (gfxctx::free does so while it is bound) are
+             * released in batches once the GPU is done with this frame.
+             */
+            retire_queue* retire = nullptr;
+            uint64_t index = 0;
+        };
         /**
          * @brief information about the window context, may change depending
          * external events.
@@ -87,6 +107,11 @@ namespace aico::sys
          * 
          * This function will internally call wndctx::renderfnc, which
          * *must* be a valid pointer.
+         * Every frame counts as an idle tick for sys::trim_idle.
+         * Every frame gets a freshly reset scratch arena, see frameinfo.
+         * Every frame is fenced after the swap, deferred releases of frames
+         * the GPU finished are reclaimed then. Leaving the loop waits for the
+         * GPU and reclaims everything.
          */
         void loop();
         /**
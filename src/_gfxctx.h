@@ -2,6 +2,8 @@
 
 
 #include "aico/gfxctx.h"
+#include "aico/pool.h"
+#include "aico/retire.h"
 
 #include "glad/glad.h"
 
@@ -43,6 +45,33 @@ namespace aico
         static const GLuint& hndl(const shader_t&)noexcept;
         static const GLuint& hndl(const program_t&)noexcept;
 
+        //handles churn with every transient resource, keep them off the global
+        //heap. GL objects only live on the thread their context is current on,
+        //so a per thread pool is enough
+        template<typename H>
+        static H* newhnd()noexcept
+        {
+            return sys::thread_pool<sizeof(H), alignof(H)>().template make<H>();
+        }
+        template<typename H>
+        static void delhnd(H* hnd)noexcept
+        {
+            sys::thread_pool<sizeof(H), alignof(H)>().destroy(hnd);
+        }
+
+        //GL names freed while a frame may still use them go through the
+        //thread's retire queue, deleted in batches once the GPU is done.
+        //names travel as the retired pointer
+        static void delbufs(void* const* names, size_t n)noexcept;
+        static void delvaos(void* const* names, size_t n)noexcept;
+        static void delshaders(void* const* names, size_t n)noexcept;
+        static void delprogs(void* const* names, size_t n)noexcept;
+        static void retire(sys::retire_fn fn, GLuint name)noexcept
+        {
+            if(name)
+                sys::retire(fn, (void*)(uintptr_t)name);
+        }
+
         static constexpr GLenum gl(attribinfo::type t)noexcept
         {
             using type = attribinfo::type;
@@ -5,6 +5,7 @@
 #include "aico/opres.h"
 #include "aico/wndctx.h"
 
+#include <algorithm>
 #include <cassert>
 #include <sstream>
 #include <cstring>
@@ -22,8 +23,40 @@ GLuint& ctx::_impl::hndl(ctx::vtxlayout_t&x)noexcept{return x._hnd->value;}
 GLuint& ctx::_impl::hndl(ctx::shader_t&x)noexcept{return x._hnd->value;}
 GLuint& ctx::_impl::hndl(ctx::program_t&x)noexcept{return x._hnd->value;}
 
+//unpacks retired names in chunks for the glDelete* calls taking arrays
+template<typename F>
+static void delnames(void* const* names, size_t n, F del)noexcept
+{
+    GLuint chunk[64];
+    for(size_t i=0; i<n;)
+    {
+        GLsizei k=0;
+        for(; k<64&&i<n; ++k, ++i)
+            chunk[k]=(GLuint)(uintptr_t)names[i];
+        del(k, chunk);
+    }
+}
+void ctx::_impl::delbufs(void* const* names, size_t n)noexcept
+{
+    delnames(names, n, [](GLsizei k, const GLuint* ids){glDeleteBuffers(k, ids);});
+}
+void ctx::_impl::delvaos(void* const* names, size_t n)noexcept
+{
+    delnames(names, n, [](GLsizei k, const GLuint* ids){glDeleteVertexArrays(k, ids);});
+}
+void ctx::_impl::delshaders(void* const* names, size_t n)noexcept
+{
+    for(size_t i=0; i<n; ++i)
+        glDeleteShader((GLuint)(uintptr_t)names[i]);
+}
+void ctx::_impl::delprogs(void* const* names, size_t n)noexcept
+{
+    for(size_t i=0; i<n; ++i)
+        glDeleteProgram((GLuint)(uintptr_t)names[i]);
+}
+
 
-ctx::shader_t::shader_t(ctx::stageinfo info): _type(info.T), _hnd(new handle_t){}
+ctx::shader_t::shader_t(ctx::stageinfo info): _type(info.T), _hnd(_impl::newhnd<handle_t>()){}
 ctx::shader_t ctx::compile(ctx::stageinfo info, opres* res)const noexcept
 {
     int length = info.length == -1? (int)strlen(info.src) : info.length;
@@ -61,15 +94,15 @@ void ctx::free(shader_t& stg)const noexcept
 {
     if(!stg._hnd)
         return;
-    glDeleteShader(_impl::hndl(stg));
-    delete stg._hnd;
+    _impl::retire(&_impl::delshaders, _impl::hndl(stg));
+    _impl::delhnd(stg._hnd);
     stg._hnd=nullptr;
 }
-ctx::program_t::program_t(): _hnd(new handle_t){}
+ctx::program_t::program_t(): _hnd(_impl::newhnd<handle_t>()){}
 ctx::program_t ctx::link(const std::vector<shader_t>& stages, opres* res)const noexcept
 {
     program_t prog;
-    if(!_impl::hndl(prog))
+    if(!prog._hnd)
     {
         if(res)
             *res = opres::FAILURE;//alloc failure
@@ -94,8 +127,8 @@ void ctx::free(program_t& prog)const noexcept
 {
     if(!prog._hnd)
         return;
-    glDeleteProgram(_impl::hndl(prog));
-    delete prog._hnd;
+    _impl::retire(&_impl::delprogs, _impl::hndl(prog));
+    _impl::delhnd(prog._hnd);
     prog._hnd=nullptr;
 }
 opres ctx::bind(program_t prog)const noexcept
@@ -105,10 +138,12 @@ opres ctx::bind(program_t prog)const noexcept
     return opres::SUCCESS;
 }
 
-ctx::vtxlayout_t::vtxlayout_t(ctx::vtxlayout_info info): _info(info), _hnd(new handle_t){}
+ctx::vtxlayout_t::vtxlayout_t(ctx::vtxlayout_info info): _info(info), _hnd(_impl::newhnd<handle_t>()){}
 ctx::vtxlayout_t ctx::make_vtxlayout(vtxlayout_info info)const noexcept
 {
     vtxlayout_t layout(info);
+    if(!layout._hnd)
+        return layout;
     glCreateVertexArrays(1, &layout._hnd->value);
     auto vaobj = _impl::hndl(layout);
     for(const auto& bind : layout._info.buffers)
@@ -139,17 +174,23 @@ void ctx::free(vtxlayout_t& layout)const noexcept
 {
     if(!layout._hnd)
         return;
-    glDeleteVertexArrays(1, &layout._hnd->value);
-    delete layout._hnd;
+    _impl::retire(&_impl::delvaos, _impl::hndl(layout));
+    _impl::delhnd(layout._hnd);
     layout._hnd = nullptr;
 }
 
-ctx::buf_t::buf_t(ctx::bufinfo info): _info(info), _hnd(new handle_t){}
+ctx::buf_t::buf_t(ctx::bufinfo info): _info(info), _hnd(_impl::newhnd<handle_t>()){}
 ctx::buf_t ctx::bufalloc(bufinfo info, const void* data, opres* res)const noexcept
 {
     //if something failed, let the driver scream, i guess
     //TODO return error states via res
     buf_t buffer(info);
+    if(!buffer._hnd)
+    {
+        if(res)
+            *res = opres::MEM_ERR;
+        return buffer;
+    }
     glCreateBuffers(1, &buffer._hnd->value);
     glNamedBufferStorage(buffer._hnd->value, (long)buffer._info.size, data,
         GL_DYNAMIC_STORAGE_BIT);
@@ -159,18 +200,51 @@ void ctx::free(buf_t& buffer)const noexcept
 {
     if(!buffer._hnd)
         return;
-    glDeleteBuffers(1, &_impl::hndl(buffer));
-    delete buffer._hnd;
+    _impl::retire(&_impl::delbufs, _impl::hndl(buffer));
+    _impl::delhnd(buffer._hnd);
     buffer._hnd = nullptr;
 }
 opres ctx::bufdata(const buf_t& buffer, const void* data, size_t size,
     size_t buf_offset)const noexcept
 {
-    if(buf_offset + size > buffer._info.size)
+    //compared without the sum, which could wrap
+    if(buf_offset > buffer._info.size || size > buffer._info.size - buf_offset)
         return opres::FAILURE;
     glNamedBufferSubData(buffer._hnd->value, buf_offset, size, data);
     return opres::SUCCESS;
 }
+opres ctx::bufdata(const buf_t& buffer, const void* data, size_t count,
+    size_t elemsize, size_t stride, size_t buf_offset)const noexcept
+{
+    if(count == 0 || elemsize == 0)
+        return opres::SUCCESS;
+    //count*elemsize could wrap too, divide instead
+    if(buf_offset > buffer._info.size ||
+        count > (buffer._info.size - buf_offset)/elemsize)
+        return opres::FAILURE;
+    if(stride == elemsize)
+        return bufdata(buffer, data, count*elemsize, buf_offset);
+    //gathered into a stack buffer, one upload per batch
+    alignas(16) char staging[4096];
+    const char* src = (const char*)data;
+    if(elemsize > sizeof(staging))
+    {
+        for(size_t i = 0; i < count; ++i)
+            glNamedBufferSubData(buffer._hnd->value, buf_offset + i*elemsize,
+                elemsize, src + i*stride);
+        return opres::SUCCESS;
+    }
+    const size_t batch = sizeof(staging)/elemsize;
+    for(size_t i = 0; i < count; i += batch)
+    {
+        const size_t n = std::min(batch, count - i);
+        for(size_t j = 0; j < n; ++j)
+            std::memcpy(staging + j*elemsize, src + (i + j)*stride, elemsize);
+        glNamedBufferSubData(buffer._hnd->value, buf_offset + i*elemsize,
+            n*elemsize, staging);
+    }
+    return opres::SUCCESS;
+}
 
 ctx::gfxctx(gfxconf_t config) : implptr(new _impl(config)){}
 ctx::_impl::_impl(gfxconf_t config) : config(config) {}
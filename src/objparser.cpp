@@ -4,58 +4,120 @@
 #include "tiny_obj_loader.h"
 
 #include <cstdio>
-#include <vector>
+#include <fstream>
+#include <memory_resource>
 
 using namespace aico;
 
-[[nodiscard]]storage<vertex> aico::parseobj(const char *filename, opres *res)
+namespace
 {
-    tinyobj::attrib_t attrib;
-    std::vector<tinyobj::shape_t> shapes;
-    
+    //everything tinyobj hands back, straight into `mr` instead of the
+    //attrib_t/shape_t vectors LoadObj fills
+    struct objdata
+    {
+        std::pmr::vector<float> vertices, normals, uvs;
+        std::pmr::vector<tinyobj::index_t> indices; //triangles, 0-based, -1 absent
+
+        explicit objdata(std::pmr::memory_resource* mr):
+            vertices(mr), normals(mr), uvs(mr), indices(mr){}
+
+        //raw OBJ index: 1-based, negative counts back from the last element,
+        //0 when missing
+        static int resolve(int idx, size_t count)noexcept
+        {
+            if(idx>0) return idx-1;
+            if(idx<0) return (int)count+idx;
+            return -1;
+        }
+        static void vertex_cb(void* usr, tinyobj::real_t x, tinyobj::real_t y,
+            tinyobj::real_t z, tinyobj::real_t)
+        {
+            ((objdata*)usr)->vertices.insert(((objdata*)usr)->vertices.end(),
+                {(float)x, (float)y, (float)z});
+        }
+        static void normal_cb(void* usr, tinyobj::real_t x, tinyobj::real_t y,
+            tinyobj::real_t z)
+        {
+            ((objdata*)usr)->normals.insert(((objdata*)usr)->normals.end(),
+                {(float)x, (float)y, (float)z});
+        }
+        static void texcoord_cb(void* usr, tinyobj::real_t x, tinyobj::real_t y,
+            tinyobj::real_t)
+        {
+            ((objdata*)usr)->uvs.insert(((objdata*)usr)->uvs.end(), {(float)x, (float)y});
+        }
+        //fans polygons out into triangles
+        static void index_cb(void* usr, tinyobj::index_t* idx, int n)
+        {
+            objdata& d=*(objdata*)usr;
+            for(int i=0; i<n; ++i)
+            {
+                idx[i].vertex_index=resolve(idx[i].vertex_index, d.vertices.size()/3);
+                idx[i].normal_index=resolve(idx[i].normal_index, d.normals.size()/3);
+                idx[i].texcoord_index=resolve(idx[i].texcoord_index, d.uvs.size()/2);
+            }
+            for(int i=1; i+1<n; ++i)
+                d.indices.insert(d.indices.end(), {idx[0], idx[i], idx[i+1]});
+        }
+    };
+}
+
+[[nodiscard]]storage<vertex> aico::parseobj(const char *filename, opres *res,
+    std::pmr::memory_resource* mr)
+{
+    std::ifstream file(filename);
+    if(!file)
+    {
+        printf("ERROR: cannot open %s\n", filename);
+        if(res) *res=opres::FAILURE;
+        return storage<vertex>();
+    }
+    objdata data(mr);
+    tinyobj::callback_t cb;
+    cb.vertex_cb=&objdata::vertex_cb;
+    cb.normal_cb=&objdata::normal_cb;
+    cb.texcoord_cb=&objdata::texcoord_cb;
+    cb.index_cb=&objdata::index_cb;
+
     std::string warn, err;
-    bool ok=tinyobj::LoadObj(&attrib, &shapes, nullptr,
-        &warn, &err, filename);
+    bool ok=tinyobj::LoadObjWithCallback(file, cb, &data, nullptr, &warn, &err);
     if(!warn.empty())printf("warn: %s\n", warn.c_str());
     if(!err.empty())printf("ERROR: %s\n", err.c_str());
-    if(!ok) 
+    if(!ok)
     {
         if(res) *res=opres::FAILURE;
         return storage<vertex>();
     }
     storage<vertex> vtx;
-    vtx.rsvcpct([&](){size_t sum=0; 
-        for(const auto& shape: shapes)sum+=shape.mesh.indices.size();
-        return sum;}());
+    vtx.rsvcpct(data.indices.size());
 
-    bool has_norms=!attrib.normals.empty(), has_uv=!attrib.texcoords.empty();
+    bool has_norms=!data.normals.empty(), has_uv=!data.uvs.empty();
 
-    const auto& vertices=attrib.vertices;
-    const auto& normals=attrib.normals;
-    const auto& uvs=attrib.texcoords;
+    const auto& vertices=data.vertices;
+    const auto& normals=data.normals;
+    const auto& uvs=data.uvs;
 
-    for(const auto& shape: shapes)
-        for(const auto& idx: shape.mesh.indices)
-        {
-            vertex v;
-            const auto& vidx=idx.vertex_index;
-            const auto& nidx=idx.normal_index;
-            const auto& tidx=idx.texcoord_index;
-
-            if(vidx>=0) v.pos=
-                {vertices[vidx*3+0], vertices[vidx*3+1], vertices[vidx*3+2]};
-            else puts("warn: missing vertices");
-            
-            if(nidx>=0) v.normal=
-                {normals[nidx*3+0], normals[nidx*3+1], normals[nidx*3+2]};
-            else if(has_norms) puts("warn: missing normals");
-
-            if(tidx>=0) v.uv=
-                {uvs[tidx*2+0], uvs[tidx*2+1]};
-            else if(has_uv) puts("warn: missing UVs");
-
-            vtx.push_back(v);
-        }
-    
+    for(const auto& idx: data.indices)
+    {
+        vertex v{};
+        const auto& vidx=idx.vertex_index;
+        const auto& nidx=idx.normal_index;
+        const auto& tidx=idx.texcoord_index;
+
+        if(vidx>=0&&(size_t)vidx*3<vertices.size()) v.pos=
+            {vertices[vidx*3+0], vertices[vidx*3+1], vertices[vidx*3+2]};
+        else puts("warn: missing vertices");
+
+        if(nidx>=0&&(size_t)nidx*3<normals.size()) v.normal=
+            {normals[nidx*3+0], normals[nidx*3+1], normals[nidx*3+2]};
+        else if(has_norms) puts("warn: missing normals");
+
+        if(tidx>=0&&(size_t)tidx*2<uvs.size()) v.uv=
+            {uvs[tidx*2+0], uvs[tidx*2+1]};
+        else if(has_uv) puts("warn: missing UVs");
+
+        vtx.push_back(v);
+    }
+    if(res) *res=opres::SUCCESS;
     return vtx;
 }
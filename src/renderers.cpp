@@ -2,6 +2,7 @@
 #include "gfxctx.h"
 #include "glad/glad.h"
 #include "opres.h"
+#include "slotmap.h"
 #include "wndctx.h"
 
 float vertices[]
@@ -25,10 +26,13 @@ const char* frgsrc =
 using gfx = aico::gfxctx;
 struct triangle_data
 {
-    gfx::shader_t *vtx = nullptr, *frg = nullptr;
-    gfx::program_t* prog = nullptr;
-    gfx::buf_t* vtxbuf = nullptr;
-    gfx::vtxlayout_t* binding = nullptr;
+    //gpu objects live in slot maps, the renderer holds handles
+    aico::slot_map<gfx::buf_t> bufs;
+    aico::slot_map<gfx::vtxlayout_t> layouts;
+    aico::slot_map<gfx::program_t> progs;
+    decltype(bufs)::handle_t vtxbuf;
+    decltype(layouts)::handle_t binding;
+    decltype(progs)::handle_t prog;
     gfx* gpu;
     triangle_data(gfx* gpu)noexcept: gpu(gpu)
     {
@@ -37,41 +41,42 @@ struct triangle_data
             0.f, 0.5f, -0.5f, 0.f, 0.5f, 0.f
         };
 
-        vtxbuf = new gfx::buf_t(gpu->bufalloc({.size=sizeof(vertices), 
+        vtxbuf = bufs.insert(gpu->bufalloc({.size=sizeof(vertices), 
                 .stride=2*sizeof(float)}, vertices));
         if(!vtxbuf)
             std::cout << "Uh oh..\n";
 
         using attrib = gfx::attribinfo;
         using bind = gfx::bindinfo;
-        binding = new gfx::vtxlayout_t(gpu->make_vtxlayout(
+        binding = layouts.insert(gpu->make_vtxlayout(
                     {
-                        .buffers{bind{*vtxbuf, 0, 0}},
+                        .buffers{bind{bufs[vtxbuf], 0, 0}},
                         .attribs{attrib{0, 2, 0, 0,
                             attrib::type::FLOAT}}
                     }));
         if(!binding)
             std::cout << "Uh oh..\n";
-        gpu->bind(*binding);
+        gpu->bind(layouts[binding]);
 
-        vtx = new gfx::shader_t(gpu->compile(gfx::stageinfo{vtxsrc, 
-            gfx::stageinfo::type::VERT}));
-        frg = new gfx::shader_t(gpu->compile(gfx::stageinfo{frgsrc,
-            gfx::stageinfo::type::FRAG}));
-        prog = new gfx::program_t(gpu->link({*frg, *vtx}));
+        gfx::shader_t vtx = gpu->compile(gfx::stageinfo{vtxsrc, 
+            gfx::stageinfo::type::VERT});
+        gfx::shader_t frg = gpu->compile(gfx::stageinfo{frgsrc,
+            gfx::stageinfo::type::FRAG});
+        prog = progs.insert(gpu->link({frg, vtx}));
 
-        if(!(vtx && frg && prog))
+        if(!prog)
             std::cout << "Uh oh..\n";
-        gpu->bind(*prog);
-        gpu->free(*vtx), gpu->free(*frg);
+        gpu->bind(progs[prog]);
+        gpu->free(vtx), gpu->free(frg);
     }
     ~triangle_data()noexcept
     {
-        gpu->free(*vtxbuf);
-        gpu->free(*binding);
-        gpu->free(*prog);
-        delete binding;
-        delete vtxbuf;
+        for(gfx::buf_t& buf : bufs)
+            gpu->free(buf);
+        for(gfx::vtxlayout_t& layout : layouts)
+            gpu->free(layout);
+        for(gfx::program_t& program : progs)
+            gpu->free(program);
     }
 };
 aico::opres triangle_init(gfx* gpu, void*& state)
@@ -1,9 +1,15 @@
 #include "sysinit.h"
 #include "_engctx.h"
 #include "aico/engctx.h"
+#include "aico/resource.h"
 
 #include "GLFW/glfw3.h"
 
+#include <memory_resource>
+
+//what the default resource was before init pointed it at malc
+static std::pmr::memory_resource* g_prevres = nullptr;
+
 aico::opres aico::sys::init()
 {
     if(!glfwInit())
@@ -11,6 +17,10 @@ aico::opres aico::sys::init()
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+    //std::pmr containers without a resource of their own go through malc
+    if(std::pmr::get_default_resource() != sys::malc_default_resource())
+        g_prevres = std::pmr::set_default_resource(sys::malc_default_resource());
     
     engflags = engflags | engctx::bits::INIT;
 
@@ -20,4 +30,6 @@ aico::opres aico::sys::init()
 void aico::sys::terminate() noexcept
 {
     glfwTerminate();
+    if(g_prevres != nullptr)
+        std::pmr::set_default_resource(g_prevres), g_prevres = nullptr;
 }
@@ -11,6 +11,8 @@ namespace aico::sys
      * This may be used to re-initialize the engine after a call to aicogfx::terminate()
      * Engine initialization status is marked in aicogfx::engine_flags with the 
      * aicogfx::engine_flag_bits::INIT bit.
+     * Makes sys::malc_default_resource() the std::pmr default resource,
+     * terminate() restores the previous one.
      *
      * @return aicogfx::opres::SUCCESS for success, 
      * consult return status codes otherwise.
@@ -1,6 +1,9 @@
 #include "aico/opres.h"
 #include "aico/wndctx.h"
 #include "aico/gfxctx.h"
+#include "aico/malc.h"
+#include "aico/arena.h"
+#include "aico/retire.h"
 
 #include "glad/glad.h"
 #include "GLFW/glfw3.h"
@@ -48,24 +51,94 @@ struct aico::sys::wndctx::_impl
     {
         kill_loop.store(false);
         looping.store(true);
+        frameinfo frame = framedata;
         while(!(glfwWindowShouldClose(winptr) || kill_loop.load()))
         {
+            //double buffered, the other arena still holds last frame's data
+            arena& scratch = scratch_arenas[frame.index & 1];
+            scratch.reset();
+            frame.scratch = &scratch;
+            frame.retire = &retired;
             if(fnc != nullptr)
-                fnc(framedata, gfxctxptr, usrdata);
+            {
+                arena_scope bind(scratch);
+                retire_scope bindretire(retired);
+                fnc(frame, gfxctxptr, usrdata);
+            }
+            ++frame.index;
 
             glfwSwapBuffers(winptr);
+            fence_frame();
             glfwPollEvents();
+            sys::trim_idle(); //no-op unless sys::g_autotrim is set
         }
+        drain();
         looping.store(false);
     }
+    //closes the frame's deferred releases behind a fence, then retires every
+    //frame the GPU got through
+    void fence_frame()
+    {
+        const uint64_t closed = retired.close();
+        if(fencesz == MAX_INFLIGHT)//GPU is far behind, wait for the oldest
+        {
+            glClientWaitSync(fences[fencehead].sync, GL_SYNC_FLUSH_COMMANDS_BIT,
+                GL_TIMEOUT_IGNORED);
+            retire_oldest();
+        }
+        GLsync sync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        if(!sync)
+        {
+            glFinish();
+            retired.retire(closed);
+            return;
+        }
+        fences[(fencehead + fencesz++) % MAX_INFLIGHT] = {closed, sync};
+        while(fencesz)
+        {
+            GLenum status = glClientWaitSync(fences[fencehead].sync, 0, 0);
+            if(status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+                break;
+            retire_oldest();
+        }
+    }
+    void retire_oldest()
+    {
+        fence_t& f = fences[fencehead];
+        retired.retire(f.frame);
+        glDeleteSync(f.sync);
+        fencehead = (fencehead + 1) % MAX_INFLIGHT;
+        --fencesz;
+    }
+    //waits for the GPU, then releases everything deferred so far
+    void drain()
+    {
+        glFinish();
+        while(fencesz)
+            retire_oldest();
+        retired.flush();
+    }
     ~_impl()
     {
+        //loop() drains on its way out, only a window torn down mid-flight
+        //still has fences or releases, and those need its own context
+        if(fencesz || retired.pending())
+        {
+            glfwMakeContextCurrent(winptr);
+            drain();
+        }
         if(gfxctxptr != nullptr)
             delete gfxctxptr;
         glfwDestroyWindow(winptr);
     }
     gfxctx* gfxctxptr = nullptr;
+    arena scratch_arenas[2];
+    retire_queue retired;
 private:
+    struct fence_t{uint64_t frame; GLsync sync;};
+    static constexpr size_t MAX_INFLIGHT = 4;
+    fence_t fences[MAX_INFLIGHT];
+    size_t fencehead = 0, fencesz = 0;
     GLFWwindow* winptr;
 };
 
@@ -0,0 +1,137 @@
+#include "aico/arena.h"
+#include "aico/storage.h"
+#include "aico/timer.h"
+
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+using namespace aico::sys;
+using namespace aico;
+
+// ============ tests ============
+
+static void test_bump_and_align()
+{
+    arena a(64*KB);
+    assert(a.reserved()==0 && "chunks are mapped lazily");
+    char* p=(char*)a.alloc(3);
+    char* q=(char*)a.alloc(5, 1);
+    assert(p&&q==p+3 && "byte aligned allocations are packed");
+    void* r=a.alloc(8, 64);
+    assert((uintptr_t)r%64==0);
+    opres res;
+    assert(!a.alloc(8, 24, &res)&&res==opres::ALIGN_ERR);
+    double* d=a.alloc<double>(16);
+    assert((uintptr_t)d%alignof(double)==0);
+    std::printf("[PASS] bump and alignment\n");
+}
+
+static void test_marker_and_reset()
+{
+    arena a(64*KB);
+    void* first=a.alloc(100);
+    const arena::marker m=a.mark();
+    void* second=a.alloc(200);
+    a.alloc(300);
+    a.rollback(m);
+    assert(a.alloc(200)==second && "rollback rewinds to the marker");
+
+    const size_t reserved=a.reserved();
+    a.reset();
+    assert(a.used()==0);
+    assert(a.alloc(100)==first && "reset starts over in the same chunk");
+    assert(a.reserved()==reserved);
+    std::printf("[PASS] marker rollback and reset\n");
+}
+
+static void test_chunk_chain()
+{
+    arena a(16*KB);
+    std::vector<void*> ptrs;
+    for(int i=0; i<64; ++i)
+    {
+        void* p=a.alloc(1*KB);
+        assert(p);
+        std::memset(p, i, 1*KB);
+        ptrs.push_back(p);
+    }
+    for(int i=0; i<64; ++i)
+        assert(*(unsigned char*)ptrs[i]==(unsigned char)i && "no overlap across chunks");
+    void* big=a.alloc(1*MB);
+    assert(big && "oversized requests get their own chunk");
+
+    const size_t reserved=a.reserved();
+    a.reset();
+    for(int i=0; i<64; ++i)
+        assert(a.alloc(1*KB)==ptrs[i] && "chunks are reused in order");
+    assert(a.reserved()==reserved);
+
+    a.reset();
+    a.alloc(1*KB);
+    assert(a.shrink()>0);
+    assert(a.reserved()<reserved);
+    std::printf("[PASS] chunk chaining\n");
+}
+
+static void test_storage_binding()
+{
+    typedef storage<int, DYNAMIC, false, 8, &arena_alloc, &arena_free> scratch_t;
+    arena a;
+    {
+        arena_scope bind(a);
+        scratch_t s;
+        for(int i=0; i<1000; ++i)
+            s.push_back(i);
+        for(int i=0; i<1000; ++i)
+            assert(s[i]==i);
+        assert(a.used()>=1000*sizeof(int));
+    }
+    assert(bound_arena()==nullptr && "scope restores the previous binding");
+    std::printf("[PASS] storage on the bound arena\n");
+}
+
+// per-frame scratch pattern: many small allocations, then drop them all
+static void bench_frames()
+{
+    const int frames=200, per_frame=5000;
+    micro_timer tm;
+    std::vector<void*> ptrs(per_frame);
+    for(int f=0; f<frames; ++f)
+    {
+        for(int i=0; i<per_frame; ++i)
+            ptrs[i]=malc(16+(i*13)%240);
+        for(int i=0; i<per_frame; ++i)
+            rel(ptrs[i]);
+    }
+    const long long us_malc=tm.time_since_start().count();
+
+    arena a;
+    tm.reset();
+    for(int f=0; f<frames; ++f)
+    {
+        a.reset();
+        for(int i=0; i<per_frame; ++i)
+            ptrs[i]=a.alloc(16+(i*13)%240);
+    }
+    const long long us_arena=tm.time_since_start().count();
+
+    const double n=(double)frames*per_frame;
+    std::printf("%-28s : %8lld us   (%5.1f ns/alloc)\n", "malc+rel", us_malc,
+        1000.0*(double)us_malc/n);
+    std::printf("%-28s : %8lld us   (%5.1f ns/alloc)\n", "arena+reset", us_arena,
+        1000.0*(double)us_arena/n);
+}
+
+// ================== driver ======================
+int main()
+{
+    test_bump_and_align();
+    test_marker_and_reset();
+    test_chunk_chain();
+    test_storage_binding();
+    bench_frames();
+    return 0;
+}
@@ -0,0 +1,211 @@
+#include "aico/flatmap.h"
+#include "aico/malc.h"
+#include "aico/timer.h"
+
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace aico;
+
+// ============ helpers ============
+
+struct Obj
+{
+    static inline int live=0;
+    std::string s;
+    Obj(int i):s(std::to_string(i)+" and enough to leave sso"){++live;}
+    Obj(const Obj& o):s(o.s){++live;}
+    Obj(Obj&& o)noexcept:s(std::move(o.s)){++live;}
+    Obj& operator=(const Obj&)=default;
+    ~Obj(){--live;}
+};
+
+//every key on one probe path
+struct collide_hash
+{
+    size_t operator()(int)const noexcept{return 42;}
+};
+
+// ============ correctness ============
+
+static void test_basic()
+{
+    flat_map<int, int> m;
+    assert(m.empty()&&m.capacity()==0&&!m.find(3)&&!m.erase(3));
+    for(int i=0; i<1000; ++i)
+    {
+        auto [v, inserted]=m.try_emplace(i, i*2);
+        assert(v&&inserted&&*v==i*2);
+    }
+    assert(m.size()==1000&&m.capacity()>=1000*8/7);
+    auto [v, inserted]=m.try_emplace(7, -1);
+    assert(!inserted&&*v==14);
+    assert(m.insert_or_assign(7, -1)==opres::SUCCESS&&*m.find(7)==-1);
+    for(int i=0; i<1000; i+=2)
+        assert(m.erase(i));
+    assert(m.size()==500&&!m.contains(0)&&m.contains(1)&&!m.erase(0));
+
+    long long sum=0;
+    size_t n=0;
+    for(auto [k, val] : m)
+        sum+=k, ++n, assert(val==k*2||k==7);
+    assert(n==500&&sum==500*500);
+    const flat_map<int, int>& cm=m;
+    for(auto [k, val] : cm)
+        assert(*cm.find(k)==val);
+
+    const size_t cpct=m.capacity();
+    m.clear();
+    assert(m.empty()&&m.capacity()==cpct&&!m.contains(1));
+
+    flat_map<int, int> moved(std::move(m));
+    assert(m.capacity()==0&&!m.contains(1)&&moved.capacity()==cpct);
+    std::printf("basic ok\n");
+}
+
+static void test_random()
+{
+    {
+        flat_map<std::string, Obj> m;
+        std::unordered_map<std::string, int> ref;
+        std::mt19937 rng(17);
+        for(int op=0; op<300000; ++op)
+        {
+            const int k=(int)(rng()%5000);
+            const std::string key="key "+std::to_string(k);
+            switch(rng()%4)
+            {
+            case 0: case 1:
+                if(auto [v, inserted]=m.try_emplace(key, k); inserted)
+                    ref[key]=k;
+                else
+                    assert(v->s.find(std::to_string(ref[key])+" ")==0);
+                break;
+            case 2:
+                assert(m.erase(key)==(ref.erase(key)==1));
+                break;
+            case 3:
+                assert(m.contains(key)==(ref.count(key)==1));
+                break;
+            }
+            assert(m.size()==ref.size());
+        }
+        assert((int)m.size()==Obj::live);
+        for(auto [k, v] : m)
+            assert(ref.count(k));
+    }
+    assert(Obj::live==0);
+    std::printf("random ops ok\n");
+}
+
+static void test_collisions()
+{
+    //one probe path, tombstones in the middle of it
+    flat_map<int, int, collide_hash> m;
+    for(int i=0; i<300; ++i)
+        m.try_emplace(i, i);
+    for(int i=0; i<300; i+=3)
+        assert(m.erase(i));
+    for(int i=0; i<300; ++i)
+        assert(m.contains(i)==(i%3!=0));
+    for(int round=0; round<50; ++round)
+    {
+        m.try_emplace(1000+round, round);
+        assert(m.erase(1000+round)&&m.contains(299));
+    }
+    assert(m.size()==200);
+    std::printf("collisions ok\n");
+}
+
+static void test_malc()
+{
+    //one block per rehash, through malc
+    const size_t before=sys::malc_stats().malcs;
+    flat_map<uint64_t, uint64_t> m;
+    for(uint64_t i=0; i<100000; ++i)
+        m.try_emplace(i*7919, i);
+    const size_t grown=sys::malc_stats().malcs-before;
+    assert(grown<=16);
+    flat_map<uint64_t, uint64_t> sized(100000);
+    const size_t mark=sys::malc_stats().malcs;
+    for(uint64_t i=0; i<100000; ++i)
+        sized.try_emplace(i*7919, i);
+    assert(sys::malc_stats().malcs==mark);
+    std::printf("malc ok (%zu allocations growing to 100000)\n", grown);
+}
+
+// ============ speed ============
+
+static void bench(size_t n)
+{
+    std::printf("\n=== %zu uint64 keys ===\n", n);
+    std::mt19937_64 rng(19);
+    std::vector<uint64_t> keys(n), misses(n);
+    for(size_t i=0; i<n; ++i)
+        keys[i]=rng(), misses[i]=rng();
+    long long t[2][4];
+    uint64_t sink=0;
+
+    micro_timer tm;
+    {
+        flat_map<uint64_t, uint64_t> m;
+        for(uint64_t k : keys)
+            m.try_emplace(k, k);
+        t[0][0]=tm.tick().count();
+        for(uint64_t k : keys)
+            sink+=*m.find(k);
+        t[0][1]=tm.tick().count();
+        for(uint64_t k : misses)
+            sink+=m.contains(k);
+        t[0][2]=tm.tick().count();
+        //steady size, every step erases one key and inserts a new one
+        for(size_t i=0; i<n; ++i)
+        {
+            m.erase(keys[i]);
+            m.try_emplace(misses[i], i);
+        }
+        t[0][3]=tm.tick().count();
+    }
+    (void)tm.tick();
+    {
+        std::unordered_map<uint64_t, uint64_t> m;
+        for(uint64_t k : keys)
+            m.try_emplace(k, k);
+        t[1][0]=tm.tick().count();
+        for(uint64_t k : keys)
+            sink+=m.find(k)->second;
+        t[1][1]=tm.tick().count();
+        for(uint64_t k : misses)
+            sink+=m.count(k);
+        t[1][2]=tm.tick().count();
+        for(size_t i=0; i<n; ++i)
+        {
+            m.erase(keys[i]);
+            m.try_emplace(misses[i], i);
+        }
+        t[1][3]=tm.tick().count();
+    }
+    const char* names[]{"insert", "lookup hit", "lookup miss", "erase+insert churn"};
+    std::printf("%-20s : %9s %10s\n", "", "flat_map", "unord_map");
+    for(int i=0; i<4; ++i)
+        std::printf("%-20s : %9lld %10lld us\n", names[i], t[0][i], t[1][i]);
+    std::printf("(%llu)\n", (unsigned long long)sink);
+}
+
+// ================== driver ======================
+int main()
+{
+    test_basic();
+    test_random();
+    test_collisions();
+    test_malc();
+
+    bench(100000);
+    bench(2000000);
+    return 0;
+}
@@ -0,0 +1,197 @@
+#include "aico/hybrid.h"
+#include "aico/malc.h"
+#include "aico/storage.h"
+#include "aico/timer.h"
+
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace aico;
+
+// ============ helpers ============
+
+struct Attrib
+{
+    uint32_t idx, size, offset, binding;
+};
+
+struct Tracked
+{
+    static inline int live=0;
+    std::string s;
+    Tracked(const char* p="a string that does not fit in sso"):s(p){++live;}
+    Tracked(const Tracked& o):s(o.s){++live;}
+    Tracked(Tracked&& o)noexcept:s(std::move(o.s)){++live;}
+    ~Tracked(){--live;}
+};
+
+//a move that may throw, and a copy that does after `budget` copies
+struct Fragile
+{
+    static inline int budget=1000;
+    std::string s;
+    Fragile(const char* p):s(p){}
+    Fragile(const Fragile& o):s(o.s){if(--budget<0) throw 1;}
+    Fragile(Fragile&& o):s(std::move(o.s)){}
+};
+
+static uint64_t heap_malcs()
+{
+    return sys::malc_stats().malcs;
+}
+
+// ============ correctness ============
+
+static void test_inline_spill()
+{
+    const uint64_t before=heap_malcs();
+    {
+        hybrid_storage<Attrib, 4> h;
+        assert(h.inlined()&&h.size()==0&&h.capacity()==4);
+        for(uint32_t i=0; i<4; ++i)
+            assert(h.push_back({i, 2*i, 0, 0})==opres::SUCCESS);
+        assert(h.inlined());
+        assert(heap_malcs()==before);
+        assert(h.push_back(h[0])==opres::SUCCESS);  //aliases, spills
+        assert(!h.inlined()&&h.capacity()>=5&&h[4].size==0);
+        assert(heap_malcs()==before+1);
+        for(uint32_t i=5; i<1000; ++i)
+            h.emplace_back(Attrib{i, 2*i, 0, 0});
+        for(uint32_t i=1; i<1000; ++i)
+            assert(h[i].idx==(i==4?0:i));
+        assert(h.resize(3)==opres::SUCCESS&&h.size()==3&&!h.inlined());
+    }
+    std::printf("inline/spill ok\n");
+}
+
+static void test_nontrivial()
+{
+    {
+        hybrid_storage<Tracked, 2> h(2);
+        assert(Tracked::live==2&&h.inlined());
+        h.emplace_back("third");
+        assert(!h.inlined()&&Tracked::live==3&&h[2].s=="third");
+        assert(h[0].s.size()>20);
+        assert(h.resize(6, h[2])==opres::SUCCESS&&Tracked::live==6);
+        assert(h[5].s=="third");
+        h.resize(1);
+        assert(Tracked::live==1);
+
+        hybrid_storage<std::unique_ptr<int>, 3> u;
+        u.push_back(std::make_unique<int>(1));
+        u.push_back(std::make_unique<int>(2));
+        hybrid_storage<std::unique_ptr<int>, 3> moved(std::move(u));
+        assert(u.size()==0&&moved.inlined()&&*moved[1]==2);
+        for(int i=3; i<10; ++i)
+            moved.push_back(std::make_unique<int>(i));
+        int* raw=moved[0].get();
+        hybrid_storage<std::unique_ptr<int>, 3> stolen(std::move(moved));
+        assert(!stolen.inlined()&&stolen[0].get()==raw&&moved.inlined());
+        assert(*stolen[8]==9);
+    }
+    assert(Tracked::live==0);
+    std::printf("non-trivial ok\n");
+}
+
+static void test_spill_throws()
+{
+    hybrid_storage<Fragile, 4> h;
+    for(int i=0; i<4; ++i)
+        h.emplace_back("an element long enough to leave the sso buffer");
+    //spilling copies, the second copy throws, the inline elements are intact
+    Fragile::budget=1;
+    bool threw=false;
+    try{h.emplace_back("fifth");}
+    catch(int){threw=true;}
+    assert(threw&&h.inlined()&&h.size()==4);
+    for(int i=0; i<4; ++i)
+        assert(h[i].s=="an element long enough to leave the sso buffer");
+    Fragile::budget=1000;
+    assert(h.emplace_back("fifth")==opres::SUCCESS&&!h.inlined()&&h[4].s=="fifth");
+    assert(h[0].s=="an element long enough to leave the sso buffer");
+    std::printf("throwing spill ok\n");
+}
+
+static void test_copy()
+{
+    hybrid_storage<int, 8> h(5, 7);
+    int out[5];
+    assert(h.copyinto(out, 5)==opres::SUCCESS&&out[4]==7);
+    assert(h.copyinto(out, 2, 3)==opres::SUCCESS&&out[1]==7);
+    std::printf("copy ok\n");
+}
+
+// ============ speed ============
+
+template<typename L>
+static uint64_t build_lists(std::vector<L>& lists, const std::vector<uint8_t>& lens)
+{
+    uint64_t sum=0;
+    lists.clear();
+    lists.reserve(lens.size());
+    for(uint8_t n : lens)
+    {
+        lists.emplace_back();
+        L& l=lists.back();
+        for(uint32_t i=0; i<n; ++i)
+            l.push_back({i, 4, 4*i, 0});
+        sum+=l.size();
+    }
+    return sum;
+}
+
+static void bench(size_t count, int maxlen)
+{
+    std::mt19937 rng(11);
+    std::uniform_int_distribution<int> len(0, maxlen);
+    std::vector<uint8_t> lens(count);
+    for(uint8_t& l : lens)
+        l=(uint8_t)len(rng);
+    std::printf("\n=== %zu lists of 0..%d attribs ===\n", count, maxlen);
+    std::printf("%-22s %10s %12s\n", "", "us", "malc calls");
+
+    auto run=[&](const char* label, auto& lists)
+    {
+        const uint64_t before=heap_malcs();
+        micro_timer tm;
+        volatile uint64_t sink=build_lists(lists, lens);
+        lists.clear();
+        (void)sink;
+        const long long us=tm.tick().count();
+        std::printf("%-22s %10lld %12llu\n", label, us,
+            (unsigned long long)(heap_malcs()-before));
+    };
+    std::vector<storage<Attrib>> st;
+    std::vector<hybrid_storage<Attrib, 4>> h4;
+    std::vector<hybrid_storage<Attrib, 8>> h8;
+    run("storage<Attrib>", st);
+    run("hybrid_storage<., 4>", h4);
+    run("hybrid_storage<., 8>", h8);
+
+    std::vector<std::vector<Attrib>> vec;
+    micro_timer tm;
+    volatile uint64_t sink=build_lists(vec, lens);
+    vec.clear();
+    (void)sink;
+    std::printf("%-22s %10lld %12s\n", "std::vector<Attrib>", (long long)tm.tick().count(),
+        "(new)");
+}
+
+// ================== driver ======================
+int main()
+{
+    test_inline_spill();
+    test_nontrivial();
+    test_spill_throws();
+    test_copy();
+
+    bench(200000, 4);
+    bench(200000, 8);
+    bench(200000, 32);
+    return 0;
+}
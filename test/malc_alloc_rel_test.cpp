@@ -20,16 +20,15 @@ bool is_aligned(void* p, size_t align) {
 }
 
 void dump_header(void* userptr) {
-    hdr_t* h = gethdr(userptr);
-    if (!h) {
-        std::cerr << "[!] invalid header for " << userptr << "\n";
+    blkinfo_t info;
+    if (!blkinfo(userptr, &info)) {
+        std::cerr << "[!] not a live block: " << userptr << "\n";
         return;
     }
-    std::cout << "  hdr @ " << h
-              << " base=" << h->base
-              << " bytes=" << h->bytes
-              << " flags=" << (int)h->flags
-              << " heapid=" << (int)h->heapid
+    std::cout << "  blk @ " << userptr
+              << " base=" << info.base
+              << " bytes=" << info.bytes
+              << " owner=" << info.owner
               << "\n";
 }
 
@@ -41,8 +40,8 @@ void test_alignment() {
     assert(r == opres::SUCCESS);
     assert(is_aligned(p, 16));
     std::cout << "Allocated 100 bytes at " << p << " aligned 16: OK\n";
-    hdr_t* h = gethdr(p);
-    assert(h && h->magic == 0xC0FFEE);
+    blkinfo_t info;
+    assert(blkinfo(p, &info) && info.bytes >= 100);
     dump_header(p);
     rel(p);
     std::cout << "Freed alignment test block\n\n";
@@ -56,10 +55,10 @@ void test_small_alloc() {
     assert(p);
     assert(r == opres::SUCCESS);
     std::cout << "Requested " << request << " bytes, got user ptr " << p << "\n";
-    hdr_t* h = gethdr(p);
-    assert(h);
+    blkinfo_t info;
+    assert(blkinfo(p, &info));
     // ensure underlying allocation was bumped to at least freenode_t
-    assert(h->bytes >= sizeof(freenode_t));
+    assert(info.bytes >= sizeof(freenode_t));
     dump_header(p);
     rel(p);
     std::cout << "Freed small alloc\n\n";
@@ -95,19 +94,19 @@ void test_free_and_reuse() {
     std::memset(b, 0xBB, 128);
     dump_header(b);
 
-    // Free A then B, freelist is LIFO so next alloc should return B first
+    // Free A then B, B is the last bumped block so both coalesce back
+    // into the bump region and get handed out again front to back
     rel(a);
     rel(b);
     
-    //use less bytes due to pessimistic fit logic
-    void* c = malc(64, 8, &r);
+    void* c = malc(128, 8, &r);
     dump_header(c);
-    assert(c == b && "Expected reuse of B (LIFO)"); 
-    std::cout << "Reused B as expected: " << c << "\n";
+    assert(c == a && "Expected reuse of A (coalesced)"); 
+    std::cout << "Reused A as expected: " << c << "\n";
 
-    void* d = malc(64, 8, &r);
-    assert(d == a && "Expected reuse of A second");
-    std::cout << "Reused A as expected: " << d << "\n";
+    void* d = malc(128, 8, &r);
+    assert(d == b && "Expected reuse of B second");
+    std::cout << "Reused B as expected: " << d << "\n";
 
     rel(c);
     rel(d);
@@ -140,8 +139,8 @@ void test_stress_random(size_t iterations = 10000) {
             assert(r == opres::SUCCESS);
             // check alignment
             assert(is_aligned(p, alignof(hdr_t)));
-            hdr_t* h = gethdr(p);
-            assert(h && h->magic == 0xC0FFEE);
+            blkinfo_t info;
+            assert(blkinfo(p, &info) && info.bytes >= sz);
             live.push_back({p, sz});
             seen.insert(p);
         }
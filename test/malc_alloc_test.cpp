@@ -13,10 +13,11 @@ void test_basic_allocation()
     assert(ptr != nullptr);
     assert(res == opres::SUCCESS);
 
-    hdr_t* header = header_addr(ptr);
-    assert(header->magic == 0xC0FFEE);
-    assert(header->bytes >= 1024);
-    assert(header->base != nullptr);
+    blkinfo_t info;
+    assert(blkinfo(ptr, &info));
+    assert(info.owner != MAP_DEDICATED);
+    assert(info.bytes >= 1024);
+    assert(info.base != nullptr);
 
     std::cout << "Basic Allocation passed ✅\n";
 }
@@ -0,0 +1,205 @@
+#include "aico/malc.h"
+#include "aico/memory.h"
+#include "aico/timer.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace aico::sys;
+using namespace aico;
+
+// ============ helpers ============
+
+struct Node
+{
+    Node* parent=nullptr;
+    Node* child=nullptr;
+    uint64_t key=0;
+    float w[6]{};
+};
+
+struct Named
+{
+    std::string name;
+    int id;
+    Named(int i):name("node name that does not fit sso"), id(i){}
+    Named(std::string n, int i):name(std::move(n)), id(i){}
+};
+
+static void print_t(const char* label, long long us, size_t ops)
+{
+    std::printf("%-26s : %8lld us   (%6.1f ns/op)\n", label, us,
+        ops?1000.0*(double)us/(double)ops:0.0);
+}
+
+static size_t live_bytes()
+{
+    malcstats_t st=malc_stats();
+    return st.live;
+}
+
+// ============ correctness ============
+
+static void test_basic()
+{
+    const size_t base=live_bytes();
+    std::vector<void*> ptrs(1000);
+    assert(malc_n(ptrs.size(), 40, alignof(hdr_t), ptrs.data())==opres::SUCCESS);
+    std::vector<void*> sorted=ptrs;
+    std::sort(sorted.begin(), sorted.end());
+    assert(std::adjacent_find(sorted.begin(), sorted.end())==sorted.end());
+    for(size_t i=0; i<ptrs.size(); ++i)
+    {
+        blkinfo_t info;
+        assert(blkinfo(ptrs[i], &info)&&info.bytes>=40);
+        assert((uintptr_t)ptrs[i]%alignof(hdr_t)==0);
+        std::memset(ptrs[i], (int)i, 40);
+    }
+    for(size_t i=0; i<ptrs.size(); ++i)
+        assert(*(unsigned char*)ptrs[i]==(unsigned char)i);
+    rel_n(ptrs.data(), ptrs.size());
+    assert(live_bytes()==base);
+    std::printf("basic batch ok\n");
+}
+
+static void test_aligned()
+{
+    void* ptrs[300];
+    assert(malc_n(300, 24, 64, ptrs)==opres::SUCCESS);
+    for(void* p : ptrs)
+        assert((uintptr_t)p%64==0);
+    assert(malc_n(4, 24, 48, ptrs)==opres::ALIGN_ERR);
+    //released one by one in reverse, every block stands on its own
+    for(size_t i=300; i!=0; --i)
+        rel(ptrs[i-1]);
+    std::printf("aligned batch ok\n");
+}
+
+static void test_shuffled_release()
+{
+    const size_t base=live_bytes();
+    std::vector<void*> ptrs(5000);
+    assert(malc_n(ptrs.size(), 100, alignof(hdr_t), ptrs.data())==opres::SUCCESS);
+    std::mt19937_64 rng(7);
+    std::shuffle(ptrs.begin(), ptrs.end(), rng);
+    void* kept=ptrs[10];
+    ptrs[10]=nullptr;
+    int local=0;
+    const size_t half=ptrs.size()/2;
+    rel_n(ptrs.data(), half);
+    ptrs.push_back(&local);//foreign, ignored
+    rel_n(ptrs.data()+half, ptrs.size()-half);
+    assert(live_bytes()>base);
+    rel(kept);
+    assert(live_bytes()==base);
+    std::printf("shuffled release ok\n");
+}
+
+static void test_large()
+{
+    void* ptrs[3];
+    assert(malc_n(3, 64*MB, alignof(hdr_t), ptrs)==opres::SUCCESS);
+    for(void* p : ptrs)
+    {
+        blkinfo_t info;
+        assert(blkinfo(p, &info)&&info.owner==MAP_DEDICATED);
+    }
+    rel_n(ptrs, 3);
+    assert(malc_stats().dedicated==0);
+    std::printf("dedicated batch ok\n");
+}
+
+static void test_alloctr_batch()
+{
+    const size_t base=live_bytes();
+    Named* objs[500];
+    assert(alloctr<Named>(objs, 500, 7)==opres::SUCCESS);
+    for(Named* o : objs)
+        assert(o->id==7&&o->name.size()>20&&(uintptr_t)o%alignof(Named)==0);
+    dtrel(objs[0]);     //single release still works
+    objs[0]=nullptr;
+    dtrel(objs, 500);
+    assert(live_bytes()==base);
+
+    //an rvalue argument is not moved from by the first object
+    assert(alloctr<Named>(objs, 500, std::string("shared name, long enough to leave sso"),
+        3)==opres::SUCCESS);
+    for(Named* o : objs)
+        assert(o->id==3&&o->name=="shared name, long enough to leave sso");
+    dtrel(objs, 500);
+    assert(live_bytes()==base);
+
+    Node* nodes[100];
+    assert(alloctr<Node>(nodes, 100)==opres::SUCCESS);
+    for(Node* n : nodes)
+        assert(!n->parent&&n->key==0);
+    dtrel(nodes, 100);
+    std::printf("alloctr batch ok\n");
+}
+
+// ============ speed ============
+
+static void bench(size_t count, int reps)
+{
+    std::printf("\n=== %zu nodes of %zuB, x%d ===\n", count, sizeof(Node), reps);
+    std::vector<void*> ptrs(count);
+    std::vector<Node*> nodes(count);
+    long long loop_malc=0, loop_rel=0, batch_malc=0, batch_rel=0;
+    long long loop_ctr=0, loop_dtr=0, batch_ctr=0, batch_dtr=0;
+    for(int r=0; r<reps; ++r)
+    {
+        micro_timer tm;
+        for(void*& p : ptrs)
+            p=malc(sizeof(Node));
+        loop_malc+=tm.tick().count();
+        for(void* p : ptrs)
+            rel(p);
+        loop_rel+=tm.tick().count();
+
+        malc_n(count, sizeof(Node), alignof(hdr_t), ptrs.data());
+        batch_malc+=tm.tick().count();
+        rel_n(ptrs.data(), count);
+        batch_rel+=tm.tick().count();
+
+        for(Node*& n : nodes)
+            n=alloctr<Node>();
+        loop_ctr+=tm.tick().count();
+        for(Node* n : nodes)
+            dtrel(n);
+        loop_dtr+=tm.tick().count();
+
+        alloctr<Node>(nodes.data(), count);
+        batch_ctr+=tm.tick().count();
+        dtrel(nodes.data(), count);
+        batch_dtr+=tm.tick().count();
+    }
+    const size_t ops=count*reps;
+    print_t("malc loop", loop_malc, ops);
+    print_t("malc_n", batch_malc, ops);
+    print_t("rel loop", loop_rel, ops);
+    print_t("rel_n", batch_rel, ops);
+    print_t("alloctr loop", loop_ctr, ops);
+    print_t("alloctr batch", batch_ctr, ops);
+    print_t("dtrel loop", loop_dtr, ops);
+    print_t("dtrel batch", batch_dtr, ops);
+}
+
+// ================== driver ======================
+int main()
+{
+    test_basic();
+    test_aligned();
+    test_shuffled_release();
+    test_large();
+    test_alloctr_batch();
+
+    bench(1000, 200);
+    bench(100000, 10);
+    return 0;
+}
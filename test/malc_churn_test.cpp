@@ -0,0 +1,91 @@
+#include "aico/malc.h"
+#include "aico/timer.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace aico::sys;
+using namespace aico;
+
+// ============ helpers ============
+static void print_t(const char* label, long long us, size_t ops)
+{
+    std::printf("%-28s : %8lld us   (%6.1f ns/op)\n", label, us,
+        ops?1000.0*(double)us/(double)ops:0.0);
+}
+
+// random alloc/free churn over a bounded live set, small sizes dominate
+static long long churn(size_t ops, size_t maxlive, size_t minsz, size_t maxsz,
+    uint64_t seed)
+{
+    std::mt19937_64 rng(seed);
+    std::uniform_int_distribution<size_t> size_dist(minsz, maxsz);
+    std::vector<void*> live;
+    live.reserve(maxlive);
+
+    micro_timer tm;
+    for(size_t i=0; i<ops; ++i)
+    {
+        const bool release=live.size()>=maxlive||(!live.empty()&&(rng()&1));
+        if(release)
+        {
+            size_t idx=rng()%live.size();
+            rel(live[idx]);
+            live[idx]=live.back();
+            live.pop_back();
+        }
+        else
+        {
+            opres r;
+            void* p=malc(size_dist(rng), alignof(hdr_t), &r);
+            assert(p&&r==opres::SUCCESS);
+            *(char*)p=(char)i; //touch
+            live.push_back(p);
+        }
+    }
+    for(void* p : live)
+        rel(p);
+    return tm.time_since_start().count();
+}
+
+//same trace repeated, keeps scheduler hiccups out of the comparison
+static long long best_of(int runs, size_t ops, size_t maxlive, size_t minsz, 
+    size_t maxsz)
+{
+    long long best=churn(ops, maxlive, minsz, maxsz, 42);
+    for(int i=1; i<runs; ++i)
+        best=std::min(best, churn(ops, maxlive, minsz, maxsz, 42));
+    return best;
+}
+
+static void run_case(const char* name, size_t ops, size_t maxlive, size_t minsz,
+    size_t maxsz)
+{
+    std::printf("\n=== %s (ops=%zu, live<=%zu, %zu..%zuB) ===\n", name, ops, maxlive,
+        minsz, maxsz);
+
+    g_fitstrat=fit_strat::FIRST;
+    print_t("first-fit", best_of(3, ops, maxlive, minsz, maxsz), ops);
+
+    g_fitstrat=fit_strat::SEGREGATED;
+    print_t("segregated", best_of(3, ops, maxlive, minsz, maxsz), ops);
+}
+
+// ================== driver ======================
+int main()
+{
+    //first-fit degrades quadratically with freelist length, keep ops modest
+    run_case("tiny", 20000, 1024, 8, 64);
+    run_case("small", 20000, 4096, 16, 1024);
+    run_case("mixed", 10000, 4096, 16, 16*KB);
+
+    std::printf("\nheaps: %u\n", (unsigned)g_heapsz);
+    for(uint8_t i=0; i<g_heapsz; ++i)
+        std::printf("heap #%u size: %zu KB | offset: %zu KB\n", (unsigned)i,
+            g_heaps[i].bytes/KB, g_heaps[i].offset/KB);
+    return 0;
+}
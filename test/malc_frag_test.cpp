@@ -0,0 +1,104 @@
+#include "aico/malc.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+using namespace aico::sys;
+using namespace aico;
+
+// ============ helpers ============
+struct heapbytes_t
+{
+    size_t reserved=0; //sum of heap sizes
+    size_t touched=0;  //sum of bump offsets, what the heaps actually hand out
+};
+static heapbytes_t heapbytes()
+{
+    heapbytes_t hb;
+    for(uint8_t i=0; i<g_heapsz; ++i)
+    {
+        hb.reserved+=g_heaps[i].bytes;
+        hb.touched+=g_heaps[i].offset;
+    }
+    return hb;
+}
+
+// log-uniform sizes in [minsz, maxsz], lots of small blocks, a few big ones
+static size_t logsize(std::mt19937_64& rng, size_t minsz, size_t maxsz)
+{
+    std::uniform_real_distribution<double> d(std::log2((double)minsz),
+        std::log2((double)maxsz));
+    return (size_t)std::exp2(d(rng));
+}
+
+// long random trace: live set swells and drains in waves, so freed space has
+// to be split and merged to be reused by differently sized requests
+static void run_trace(const char* name, size_t ops, size_t minsz, size_t maxsz,
+    uint64_t seed)
+{
+    struct alloc_t{void* ptr; size_t bytes;};
+    std::mt19937_64 rng(seed);
+    std::vector<alloc_t> live;
+
+    size_t livebytes=0, peaklive=0;
+    heapbytes_t peak;
+    for(size_t i=0; i<ops; ++i)
+    {
+        //wave: bias toward allocation in the first half of every 64K ops
+        const bool filling=(i/(64*KB))%2==0;
+        const bool release=!live.empty()&&(rng()%100)<(filling?35u:65u);
+        if(release)
+        {
+            size_t idx=rng()%live.size();
+            rel(live[idx].ptr);
+            livebytes-=live[idx].bytes;
+            live[idx]=live.back();
+            live.pop_back();
+        }
+        else
+        {
+            const size_t sz=logsize(rng, minsz, maxsz);
+            opres r;
+            void* p=malc(sz, alignof(hdr_t), &r);
+            assert(p&&r==opres::SUCCESS);
+            std::memset(p, 0xAB, std::min<size_t>(sz, 64));
+            live.push_back({p, sz});
+            livebytes+=sz;
+        }
+        peaklive=std::max(peaklive, livebytes);
+        const heapbytes_t hb=heapbytes();
+        peak.reserved=std::max(peak.reserved, hb.reserved);
+        peak.touched=std::max(peak.touched, hb.touched);
+    }
+    const heapbytes_t end=heapbytes();
+    std::printf("\n=== %s (ops=%zu, %zu..%zuB) ===\n", name, ops, minsz, maxsz);
+    std::printf("%-28s : %10zu KB\n", "peak live", peaklive/KB);
+    std::printf("%-28s : %10zu KB  (x%.2f live)\n", "peak heap touched",
+        peak.touched/KB, (double)peak.touched/(double)peaklive);
+    std::printf("%-28s : %10zu KB  (x%.2f live)\n", "peak heap reserved",
+        peak.reserved/KB, (double)peak.reserved/(double)peaklive);
+    std::printf("%-28s : %10zu KB / %zu KB touched\n", "live at end",
+        livebytes/KB, end.touched/KB);
+    std::printf("%-28s : %10u\n", "heaps", (unsigned)g_heapsz);
+
+    for(auto& a : live)
+        rel(a.ptr);
+    const heapbytes_t drained=heapbytes();
+    std::printf("%-28s : %10zu KB\n", "touched after drain", drained.touched/KB);
+    assert(drained.touched==0 && "fully free heaps should merge back to empty");
+}
+
+// ================== driver ======================
+int main()
+{
+    run_trace("small", 1000000, 16, 2*KB, 1);
+    run_trace("mixed", 1000000, 16, 64*KB, 2);
+    run_trace("large tail", 50000, 256, 256*KB, 3);
+    return 0;
+}
@@ -0,0 +1,153 @@
+#include "aico/malc.h"
+#include "aico/timer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace aico::sys;
+using namespace aico;
+
+// ============ helpers ============
+
+// bounded single producer/single consumer pointer queue, one per pair
+struct alignas(64) ptrqueue
+{
+    static constexpr size_t CPCT=1024;
+    void* slots[CPCT];
+    alignas(64) std::atomic<size_t> head{0};
+    alignas(64) std::atomic<size_t> tail{0};
+
+    bool push(void* p)
+    {
+        const size_t t=tail.load(std::memory_order_relaxed);
+        if(t-head.load(std::memory_order_acquire)==CPCT)
+            return false;
+        slots[t%CPCT]=p;
+        tail.store(t+1, std::memory_order_release);
+        return true;
+    }
+    void* pop()
+    {
+        const size_t h=head.load(std::memory_order_relaxed);
+        if(h==tail.load(std::memory_order_acquire))
+            return nullptr;
+        void* p=slots[h%CPCT];
+        head.store(h+1, std::memory_order_release);
+        return p;
+    }
+};
+
+static void print_t(const char* label, unsigned threads, long long us, size_t ops)
+{
+    std::printf("%-22s x%-3u : %8lld us   (%7.2f Mops/s)\n", label, threads, us,
+        us?(double)ops/(double)us:0.0);
+}
+
+// producers malc, consumers on other threads rel, every free is remote
+static long long producer_consumer(unsigned pairs, size_t per_pair)
+{
+    std::vector<ptrqueue> queues(pairs);
+    std::vector<std::thread> threads;
+    std::atomic<unsigned> ready{0};
+    std::atomic<bool> go{false};
+
+    micro_timer tm;
+    for(unsigned p=0; p<pairs; ++p)
+    {
+        threads.emplace_back([&, p]
+        {
+            std::mt19937_64 rng(p+1);
+            ++ready; while(!go.load()) std::this_thread::yield();
+            for(size_t i=0; i<per_pair; ++i)
+            {
+                const size_t sz=16+rng()%496;
+                void* ptr=malc(sz);
+                assert(ptr);
+                std::memset(ptr, (int)p, std::min<size_t>(sz, 32));
+                while(!queues[p].push(ptr)) std::this_thread::yield();
+            }
+        });
+        threads.emplace_back([&, p]
+        {
+            ++ready; while(!go.load()) std::this_thread::yield();
+            for(size_t i=0; i<per_pair;)
+            {
+                if(void* ptr=queues[p].pop())
+                {
+                    assert(*(unsigned char*)ptr==(unsigned char)p);
+                    rel(ptr);
+                    ++i;
+                }
+                else std::this_thread::yield();
+            }
+        });
+    }
+    while(ready.load()!=2*pairs) std::this_thread::yield();
+    tm.reset();
+    go.store(true);
+    for(auto& t : threads)
+        t.join();
+    return tm.time_since_start().count();
+}
+
+// every thread allocates and frees its own blocks, the owner fast path
+static long long thread_local_churn(unsigned threads_n, size_t per_thread)
+{
+    std::vector<std::thread> threads;
+    std::atomic<unsigned> ready{0};
+    std::atomic<bool> go{false};
+
+    micro_timer tm;
+    for(unsigned t=0; t<threads_n; ++t)
+        threads.emplace_back([&, t]
+        {
+            std::mt19937_64 rng(t+1);
+            std::vector<void*> live;
+            live.reserve(256);
+            ++ready; while(!go.load()) std::this_thread::yield();
+            for(size_t i=0; i<per_thread; ++i)
+            {
+                if(live.size()==256||(!live.empty()&&(rng()&1)))
+                {
+                    const size_t idx=rng()%live.size();
+                    rel(live[idx]);
+                    live[idx]=live.back();
+                    live.pop_back();
+                }
+                else live.push_back(malc(16+rng()%496));
+            }
+            for(void* p : live)
+                rel(p);
+        });
+    while(ready.load()!=threads_n) std::this_thread::yield();
+    tm.reset();
+    go.store(true);
+    for(auto& t : threads)
+        t.join();
+    return tm.time_since_start().count();
+}
+
+// ================== driver ======================
+int main()
+{
+    const unsigned cores=std::max(2u, std::thread::hardware_concurrency());
+    const size_t N=200000;
+
+    std::printf("\n=== producer/consumer, remote frees (%zu blocks per pair) ===\n", N);
+    for(unsigned pairs=1; 2*pairs<=cores; pairs*=2)
+        print_t("pairs", pairs, producer_consumer(pairs, N), 2*N*pairs);
+
+    std::printf("\n=== thread local churn (%zu ops per thread) ===\n", N);
+    for(unsigned t=1; t<=cores; t*=2)
+        print_t("threads", t, thread_local_churn(t, N), N*t);
+
+    std::printf("\nheaps: %u\n", (unsigned)g_heapsz);
+    return 0;
+}
@@ -0,0 +1,97 @@
+#include "aico/malc.h"
+#include "aico/memory.h"
+
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+using namespace aico::sys;
+using namespace aico;
+
+// ============ tests ============
+
+static void test_headerless()
+{
+    //back to back small blocks, only the boundary tag sits between them
+    void* a=malc(16);
+    void* b=malc(16);
+    assert((char*)b-(char*)a==(ptrdiff_t)(sizeof(blktag_t)+16));
+    blkinfo_t info;
+    assert(blkinfo(a, &info) && info.base==(char*)a-sizeof(blktag_t));
+    rel(b);
+    rel(a);
+    std::printf("[PASS] small blocks carry no header (%zu bytes apart)\n",
+        sizeof(blktag_t)+16);
+}
+
+static void test_overaligned()
+{
+    std::vector<void*> ptrs;
+    for(size_t align=32; align<=4*KB; align*=2)
+    {
+        void* p=malc(40, align);
+        assert(p&&(uintptr_t)p%align==0);
+        blkinfo_t info;
+        assert(blkinfo(p, &info) && info.bytes>=40);
+        std::memset(p, 0x3C, 40);
+        ptrs.push_back(p);
+    }
+    for(void* p : ptrs)
+        rel(p);
+    std::printf("[PASS] over-aligned blocks find their tag\n");
+}
+
+static void test_foreign_pointers()
+{
+    const malcstats_t before=malc_stats();
+    int on_stack=0xC0FFEE;
+    void* from_libc=std::malloc(64);
+    std::memset(from_libc, 0xEE, 64);
+    rel(&on_stack);
+    rel(from_libc);
+    rel(nullptr);
+    assert(map_owner(&on_stack)==MAP_NONE);
+    assert(map_owner(from_libc)==MAP_NONE);
+    std::free(from_libc);
+
+    //an interior pointer into a dedicated block does not resolve
+    char* big=(char*)malc(70*MB);
+    assert(map_owner(big)==MAP_DEDICATED);
+    rel(big+4*KB);
+    assert(malc_stats().dedicated==before.dedicated+1);
+    rel(big);
+    assert(map_owner(big)==MAP_NONE && "unmapped ranges leave the page map");
+    const malcstats_t after=malc_stats();
+    assert(after.rels==before.rels&&after.dedicated==before.dedicated);
+    std::printf("[PASS] foreign and interior pointers are ignored\n");
+}
+
+struct Obj
+{
+    static inline int alive=0;
+    alignas(32) int v=1;
+    Obj(){++alive;}
+    ~Obj(){--alive;}
+};
+
+static void test_alloctr_count()
+{
+    Obj* objs=alloctr<Obj>(37);
+    assert(objs&&(uintptr_t)objs%32==0&&Obj::alive==37);
+    dtrel(objs);
+    assert(Obj::alive==0 && "dtrel destroys exactly what alloctr built");
+    std::printf("[PASS] alloctr keeps its own count\n");
+}
+
+// ================== driver ======================
+int main()
+{
+    test_headerless();
+    test_overaligned();
+    test_foreign_pointers();
+    test_alloctr_count();
+    return 0;
+}
@@ -0,0 +1,109 @@
+#include "aico/malc.h"
+#include "aico/storage.h"
+
+#include <cassert>
+#include <cstring>
+#include <iostream>
+
+using namespace aico::sys;
+using namespace aico;
+
+static bool filled(const void* p, unsigned char val, size_t n)
+{
+    for(size_t i=0; i<n; ++i)
+        if(((const unsigned char*)p)[i]!=val) return false;
+    return true;
+}
+
+void test_bump_tail()
+{
+    std::cout << "Test: last block grows into the bump region\n";
+    void* p=malc(1*KB);
+    std::memset(p, 0xA1, 1*KB);
+    opres r;
+    void* q=regrow(p, 64*KB, &r);
+    assert(q==p && r==opres::SUCCESS);
+    assert(filled(q, 0xA1, 1*KB));
+    blkinfo_t info;
+    assert(blkinfo(q, &info) && info.bytes>=64*KB);
+    std::memset(q, 0xA2, 64*KB);
+    rel(q);
+    std::cout << "bump tail passed ✅\n";
+}
+
+void test_free_successor()
+{
+    std::cout << "Test: block grows into a free successor\n";
+    void* a=malc(1*KB);
+    void* b=malc(32*KB);
+    void* c=malc(64);
+    std::memset(a, 0xB1, 1*KB);
+    rel(b);
+    void* q=regrow(a, 16*KB);
+    assert(q==a);
+    assert(filled(q, 0xB1, 1*KB));
+    std::memset(q, 0xB2, 16*KB);
+    //the split off tail of b is still usable
+    void* d=malc(8*KB);
+    assert(d);
+    std::memset(d, 0xB3, 8*KB);
+    assert(filled(q, 0xB2, 16*KB));
+    rel(d);
+    rel(q);
+    rel(c);
+    std::cout << "free successor passed ✅\n";
+}
+
+void test_blocked()
+{
+    std::cout << "Test: blocked growth leaves the block alone\n";
+    void* a=malc(1*KB);
+    void* b=malc(1*KB);
+    std::memset(a, 0xC1, 1*KB);
+    opres r;
+    assert(regrow(a, 8*KB, &r)==nullptr && r==opres::MEM_ERR);
+    assert(filled(a, 0xC1, 1*KB));
+    assert(regrow(a, 512)==a);//shrinking always works
+    rel(b);
+    rel(a);
+    std::cout << "blocked passed ✅\n";
+}
+
+void test_dedicated_remap()
+{
+    std::cout << "Test: dedicated blocks are remapped\n";
+    void* p=malc(70*MB, 64);
+    assert(gethdr(p)->flags&hdr_t::DEDICATED);
+    std::memset(p, 0xD1, 70*MB);
+    void* q=regrow(p, 200*MB);
+    assert(q && (uintptr_t)q%64==0);
+    assert(gethdr(q) && gethdr(q)->flags&hdr_t::DEDICATED);
+    assert(filled(q, 0xD1, 70*MB));
+    std::memset((char*)q+70*MB, 0xD2, 130*MB);
+    rel(q);
+    std::cout << "dedicated remap passed ✅\n";
+}
+
+void test_storage_rsvcpct()
+{
+    std::cout << "Test: storage::rsvcpct grows in place\n";
+    storage<int> s(16);
+    for(int i=0; i<16; ++i) s[i]=i;
+    const int* before=s.begin();
+    assert(s.rsvcpct(4096)==opres::SUCCESS);
+    assert(s.begin()==before);
+    for(int i=0; i<16; ++i) assert(s[i]==i);
+    assert(s.resize(4096)==opres::SUCCESS);
+    assert(s.begin()==before);
+    std::cout << "storage rsvcpct passed ✅\n";
+}
+
+int main()
+{
+    test_bump_tail();
+    test_free_successor();
+    test_blocked();
+    test_dedicated_remap();
+    test_storage_rsvcpct();
+    return 0;
+}
@@ -0,0 +1,403 @@
+//replays an allocation trace against malc, the C heap and storage<char>.
+//usage: malc_replay_test [trace]. without a trace a synthetic workload is
+//recorded first and replayed
+#define AICO_MALC_TRACE
+#include "aico/malc.h"
+#include "aico/memory.h"
+#include "aico/storage.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <optional>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__unix__)||defined(__APPLE__)
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#define REPLAY_FORK 1
+#endif
+
+using namespace aico::sys;
+using namespace aico;
+
+// ============ trace ============
+
+//a trace turned into block ids, addresses only mean something to the process
+//that recorded them
+struct replayop
+{
+    enum kind_t:uint8_t{ALLOC, FREE, REGROW} kind;
+    uint8_t alignlog2;
+    uint32_t id;
+    uint64_t bytes;
+};
+struct replay_t
+{
+    std::vector<replayop> ops;
+    uint32_t blocks=0;
+    size_t counts[6]{};      //records by traceop
+    size_t unmatched=0;      //frees/regrows of blocks from before the trace
+};
+
+static bool load_trace(const char* path, replay_t& out)
+{
+    FILE* f=std::fopen(path, "rb");
+    if(!f)
+        return false;
+    tracehdr_t hdr, expect;
+    std::vector<tracerec_t> recs;
+    bool ok=std::fread(&hdr, sizeof(hdr), 1, f)==1&&
+        std::memcmp(hdr.magic, expect.magic, sizeof(hdr.magic))==0&&
+        hdr.version==expect.version&&hdr.recbytes==sizeof(tracerec_t);
+    for(tracerec_t r; ok&&std::fread(&r, sizeof(r), 1, f)==1;)
+        recs.push_back(r);
+    std::fclose(f);
+    if(!ok)
+        return false;
+    //chunks of different threads interleave, MOVE keeps its place after its
+    //REGROW since both come from the same thread in order
+    std::stable_sort(recs.begin(), recs.end(),
+        [](const tracerec_t& a, const tracerec_t& b){return a.ns<b.ns;});
+
+    std::unordered_map<uint64_t, uint32_t> live;
+    struct moving_t{uint64_t addr; uint32_t id;};
+    std::unordered_map<uint32_t, moving_t> moving;//by thread, last REGROW
+    for(const tracerec_t& r : recs)
+    {
+        if((size_t)r.op<std::size(out.counts))
+            ++out.counts[(size_t)r.op];
+        switch(r.op)
+        {
+        case traceop::MALC: case traceop::CTR:
+            live[r.addr]=out.blocks;
+            out.ops.push_back({replayop::ALLOC, r.alignlog2, out.blocks++, r.bytes});
+            break;
+        case traceop::REL: case traceop::DTR:
+            if(auto it=live.find(r.addr); it!=live.end())
+            {
+                out.ops.push_back({replayop::FREE, 0, it->second, 0});
+                live.erase(it);
+            }
+            else ++out.unmatched;
+            break;
+        case traceop::REGROW:
+            if(auto it=live.find(r.addr); it!=live.end())
+            {
+                out.ops.push_back({replayop::REGROW, 0, it->second, r.bytes});
+                moving[r.thread]={r.addr, it->second};
+            }
+            else ++out.unmatched;
+            break;
+        case traceop::MOVE:
+            if(auto it=moving.find(r.thread); it!=moving.end())
+            {
+                if(auto old=live.find(it->second.addr);
+                    old!=live.end()&&old->second==it->second.id)
+                    live.erase(old);
+                live[r.addr]=it->second.id;
+            }
+            break;
+        }
+    }
+    return true;
+}
+
+// ============ workload ============
+
+struct Obj
+{
+    std::string name;
+    uint64_t v[4]{};
+    Obj():name("replayed object, long enough to spill"){}
+};
+
+//mixed small churn, a few large blocks, storage growth and alloctr/dtrel
+static void workload(uint64_t seed, size_t ops)
+{
+    std::mt19937_64 rng(seed);
+    std::vector<void*> blocks;
+    std::vector<Obj*> objs;
+    blocks.reserve(1024);
+    for(size_t i=0; i<ops; ++i)
+    {
+        const uint64_t r=rng();
+        if(blocks.size()>=1024||(!blocks.empty()&&(r&1)))
+        {
+            const size_t idx=(r>>8)%blocks.size();
+            rel(blocks[idx]);
+            blocks[idx]=blocks.back();
+            blocks.pop_back();
+        }
+        else if((r&0xff)==2)
+        {
+            storage<uint32_t> vec;
+            for(uint32_t n=0, m=(uint32_t)(r>>16)%4096; n<m; ++n)
+                vec.push_back(n);
+        }
+        else if((r&0xff)==4)
+        {
+            if(objs.size()<64)
+                objs.push_back(alloctr<Obj>(1+(r>>16)%8));
+            else
+            {
+                dtrel(objs.back());
+                objs.pop_back();
+            }
+        }
+        else
+        {
+            const size_t sz=(r&0xf00)==0?4*KB+(r>>16)%(256*KB):16+(r>>16)%496;
+            void* p=malc(sz, (r&0xf000)==0?64:alignof(hdr_t));
+            assert(p);
+            std::memset(p, (int)i, std::min<size_t>(sz, 64));
+            blocks.push_back(p);
+        }
+    }
+    for(void* p : blocks)
+        rel(p);
+    for(Obj* o : objs)
+        dtrel(o);
+}
+
+static bool record_workload(const char* path, unsigned threads, size_t ops)
+{
+    FILE* f=std::fopen(path, "wb");
+    if(!f||!trace_begin(f))
+    {
+        if(f) std::fclose(f);
+        return false;
+    }
+    std::vector<std::thread> pool;
+    for(unsigned t=0; t<threads; ++t)
+        pool.emplace_back(workload, t+1, ops);
+    for(auto& t : pool)
+        t.join();
+    const bool ok=trace_end();
+    return std::fclose(f)==0&&ok;
+}
+
+// ============ backends ============
+
+struct malc_backend
+{
+    static constexpr const char* name="malc";
+    static void* alloc(size_t bytes, size_t align){return malc(bytes, align);}
+    static void free(void* p, size_t){rel(p);}
+    static void* regrow(void* p, size_t old, size_t bytes, size_t align)
+    {
+        if(void* q=sys::regrow(p, bytes); q)
+            return q;
+        void* q=malc(bytes, align);
+        if(q) std::memcpy(q, p, std::min(old, bytes));
+        rel(p);
+        return q;
+    }
+};
+struct malloc_backend
+{
+    static constexpr const char* name="malloc";
+    static void* alloc(size_t bytes, size_t align)
+    {
+        if(align<=alignof(max_align_t))
+            return std::malloc(bytes);
+        return std::aligned_alloc(align, (bytes+align-1)&~(align-1));
+    }
+    static void free(void* p, size_t){std::free(p);}
+    static void* regrow(void* p, size_t old, size_t bytes, size_t align)
+    {
+        if(align<=alignof(max_align_t))
+            return std::realloc(p, bytes);
+        void* q=alloc(bytes, align);
+        if(q) std::memcpy(q, p, std::min(old, bytes));
+        std::free(p);
+        return q;
+    }
+};
+
+struct block_t
+{
+    void* p=nullptr;
+    uint64_t bytes=0;
+    std::optional<storage<char>> s;
+};
+
+//touches one byte per page so RSS reflects what the trace keeps alive
+static void touch(void* p, size_t bytes)
+{
+    for(size_t off=0; off<bytes; off+=4*KB)
+        ((volatile char*)p)[off]=1;
+}
+
+struct result_t
+{
+    double seconds=0;        //sum of per-op latencies
+    std::vector<uint32_t> ns;
+};
+
+template<typename B>
+static result_t replay_raw(const replay_t& tr)
+{
+    using clk=std::chrono::steady_clock;
+    std::vector<block_t> blocks(tr.blocks);
+    result_t res;
+    res.ns.reserve(tr.ops.size());
+    for(const replayop& op : tr.ops)
+    {
+        block_t& b=blocks[op.id];
+        const size_t align=(size_t)1<<op.alignlog2;
+        const auto t0=clk::now();
+        switch(op.kind)
+        {
+        case replayop::ALLOC: b.p=B::alloc(op.bytes, align); b.bytes=op.bytes; break;
+        case replayop::FREE: B::free(b.p, b.bytes); b.p=nullptr; break;
+        case replayop::REGROW:
+            b.p=B::regrow(b.p, b.bytes, op.bytes, align);
+            b.bytes=op.bytes;
+            break;
+        }
+        const auto t1=clk::now();
+        res.ns.push_back((uint32_t)std::min<int64_t>(UINT32_MAX,
+            std::chrono::duration_cast<std::chrono::nanoseconds>(t1-t0).count()));
+        if(op.kind!=replayop::FREE&&b.p)
+            touch(b.p, b.bytes);
+    }
+    for(block_t& b : blocks)
+        if(b.p) B::free(b.p, b.bytes);
+    return res;
+}
+
+//every block is a storage<char>, alignment is whatever storage gives a char
+static result_t replay_storage(const replay_t& tr)
+{
+    using clk=std::chrono::steady_clock;
+    std::vector<block_t> blocks(tr.blocks);
+    result_t res;
+    res.ns.reserve(tr.ops.size());
+    for(const replayop& op : tr.ops)
+    {
+        block_t& b=blocks[op.id];
+        const auto t0=clk::now();
+        switch(op.kind)
+        {
+        case replayop::ALLOC: b.s.emplace(op.bytes); break;
+        case replayop::FREE: b.s.reset(); break;
+        case replayop::REGROW:
+            if(b.s) b.s->rsvcpct(op.bytes);
+            break;
+        }
+        const auto t1=clk::now();
+        res.ns.push_back((uint32_t)std::min<int64_t>(UINT32_MAX,
+            std::chrono::duration_cast<std::chrono::nanoseconds>(t1-t0).count()));
+        if(op.kind!=replayop::FREE&&b.s)
+            touch(b.s->begin(), b.s->_capacity);
+    }
+    return res;
+}
+
+// ============ report ============
+
+static long maxrss_kb()
+{
+#ifdef REPLAY_FORK
+    rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+#ifdef __APPLE__
+    return ru.ru_maxrss/1024;
+#else
+    return ru.ru_maxrss;
+#endif
+#else
+    return 0;
+#endif
+}
+
+static void report(const char* name, result_t& r, long rss0)
+{
+    std::sort(r.ns.begin(), r.ns.end());
+    uint64_t total=0;
+    for(uint32_t ns : r.ns)
+        total+=ns;
+    auto pct=[&](double p){return r.ns.empty()?0u:r.ns[(size_t)(p*(double)(r.ns.size()-1))];};
+    const long rss=maxrss_kb();
+    std::printf("%-8s : %7.2f Mops/s   p50 %5u  p90 %5u  p99 %6u  p99.9 %7u  "
+        "max %8u ns   peak rss %ld KB (+%ld)\n", name,
+        total?1000.0*(double)r.ns.size()/(double)total:0.0,
+        pct(.5), pct(.9), pct(.99), pct(.999), r.ns.empty()?0u:r.ns.back(),
+        rss, rss-rss0);
+}
+
+template<typename Fn>
+static void run_isolated(const char* name, Fn&& fn)
+{
+    std::fflush(stdout);
+#ifdef REPLAY_FORK
+    //a fresh process per backend, peak RSS is a high-water mark and the C
+    //heap never shrinks back
+    if(pid_t pid=fork(); pid==0)
+    {
+        const long rss0=maxrss_kb();
+        result_t r=fn();
+        report(name, r, rss0);
+        std::fflush(stdout);
+        _exit(0);
+    }
+    else if(pid>0)
+    {
+        int status;
+        waitpid(pid, &status, 0);
+        return;
+    }
+#endif
+    const long rss0=maxrss_kb();
+    result_t r=fn();
+    report(name, r, rss0);
+}
+
+// ================== driver ======================
+int main(int argc, char** argv)
+{
+    std::string path;
+    if(argc>1)
+        path=argv[1];
+    else
+    {
+        path="malc_replay.trace";
+        const unsigned threads=4;
+        const size_t ops=200000;
+        std::printf("recording %u threads x %zu ops to %s\n", threads, ops,
+            path.c_str());
+        if(!record_workload(path.c_str(), threads, ops))
+        {
+            std::printf("failed to record %s\n", path.c_str());
+            return 1;
+        }
+    }
+
+    replay_t tr;
+    if(!load_trace(path.c_str(), tr))
+    {
+        std::printf("%s is not a malc trace\n", path.c_str());
+        return 1;
+    }
+    std::printf("\n=== %s: %zu ops over %u blocks ===\n", path.c_str(),
+        tr.ops.size(), tr.blocks);
+    std::printf("malc %zu  rel %zu  regrow %zu  moved %zu  alloctr %zu  dtrel %zu"
+        "  unmatched %zu\n\n", tr.counts[0], tr.counts[1], tr.counts[2],
+        tr.counts[3], tr.counts[4], tr.counts[5], tr.unmatched);
+
+    //single threaded in trace order, the per-op latency includes two clock reads
+    run_isolated(malc_backend::name, [&]{return replay_raw<malc_backend>(tr);});
+    run_isolated(malloc_backend::name, [&]{return replay_raw<malloc_backend>(tr);});
+    run_isolated("storage", [&]{return replay_storage(tr);});
+    return 0;
+}
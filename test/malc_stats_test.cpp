@@ -0,0 +1,118 @@
+#include "aico/malc.h"
+#include "aico/timer.h"
+
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+using namespace aico::sys;
+using namespace aico;
+
+// ============ tests ============
+
+static void test_live_and_counts()
+{
+    const malcstats_t before=malc_stats();
+    std::vector<void*> ptrs;
+    for(size_t i=0; i<100; ++i)
+        ptrs.push_back(malc(64+i));
+
+    malcstats_t st=malc_stats();
+    assert(st.malcs-before.malcs==100);
+    assert(st.live>before.live+100*64 && "live counts block bytes");
+    assert(st.reserved>=st.live);
+    assert(st.reservedpeak>=st.reserved);
+
+    //every other block freed, none of them touch the bump offset
+    for(size_t i=0; i<ptrs.size()-1; i+=2)
+        rel(ptrs[i]);
+    st=malc_stats();
+    assert(st.rels-before.rels==50);
+    uint32_t binned=0;
+    for(uint8_t c=0; c<SIZECLASSES; ++c)
+        binned+=st.binlens[c];
+    assert(binned+st.listlen>=50 && "freed blocks show up in the census");
+
+    for(size_t i=1; i<ptrs.size(); i+=2)
+        rel(ptrs[i]);
+    st=malc_stats();
+    assert(st.live==before.live);
+    std::printf("[PASS] live bytes and counts\n");
+}
+
+static void test_dedicated()
+{
+    const malcstats_t before=malc_stats();
+    void* big=malc(80*MB);
+    assert(big);
+    malcstats_t st=malc_stats();
+    assert(st.dedicated==before.dedicated+1);
+    assert(st.dedicatedbytes>=before.dedicatedbytes+80*MB);
+    assert(st.reservedpeak>=before.reserved+80*MB);
+    rel(big);
+    st=malc_stats();
+    assert(st.dedicated==before.dedicated);
+    assert(st.reserved==before.reserved);
+    std::printf("[PASS] dedicated blocks\n");
+}
+
+static void test_remote_heaps()
+{
+    void* p=nullptr;
+    std::thread([&]{p=malc(256);}).join(); //heap is orphaned, block still live
+    const malcstats_t st=malc_stats();
+    bool found=false;
+    for(uint8_t i=0; i<st.heapsz; ++i)
+        if(st.heaps[i].owner==heap_t::ORPHANED&&st.heaps[i].live)
+        {
+            assert(!st.heaps[i].walked && "only own heaps are walked");
+            found=true;
+        }
+    assert(found);
+    rel(p);
+    std::printf("[PASS] foreign heaps report counters only\n");
+}
+
+// cost of the counters on the hot path, compare against malc_churn_test
+static void bench_overhead()
+{
+    const size_t N=200000;
+    void* ptrs[64];
+    micro_timer tm;
+    for(size_t i=0; i<N; ++i)
+    {
+        const size_t slot=i%64;
+        if(i>=64) rel(ptrs[slot]);
+        ptrs[slot]=malc(16+(i*37)%480);
+    }
+    for(void* p : ptrs)
+        rel(p);
+    const long long us=tm.time_since_start().count();
+    std::printf("malc+rel with counters: %.1f ns/op\n", 1000.0*(double)us/(double)N);
+
+    tm.reset();
+    for(int i=0; i<1000; ++i)
+    {
+        const malcstats_t st=malc_stats();
+        assert(st.heapsz);
+    }
+    std::printf("malc_stats(): %.2f us/snapshot\n", 
+        (double)tm.time_since_start().count()/1000.0);
+}
+
+// ================== driver ======================
+int main()
+{
+    test_live_and_counts();
+    test_dedicated();
+    test_remote_heaps();
+    bench_overhead();
+    
+    void* keep=malc(1000);
+    malc_stats_json(malc_stats(), stdout);
+    rel(keep);
+    return 0;
+}
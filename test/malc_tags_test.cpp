@@ -0,0 +1,216 @@
+#include "aico/malc.h"
+#include "aico/memory.h"
+#include "aico/storage.h"
+
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+using namespace aico::sys;
+using namespace aico;
+
+enum : memtag_t
+{
+    TAG_MESH=1,
+    TAG_STRINGS,
+    TAG_RENDER,
+    TAG_BIG
+};
+
+// ============ helpers ============
+
+struct budgetlog_t
+{
+    int soft=0, hard=0;
+    memtag_t tag=0;
+    size_t live=0, budget=0;
+};
+static budgetlog_t g_log;
+
+static void on_budget_cb(memtag_t tag, size_t live, size_t budget, bool hard)
+{
+    ++(hard?g_log.hard:g_log.soft);
+    g_log.tag=tag;
+    g_log.live=live;
+    g_log.budget=budget;
+}
+
+// ============ tests ============
+
+static void test_scope()
+{
+    assert(tag_live(TAG_MESH)==0);
+    void* untagged=malc(100);
+    void* a;
+    {
+        tag_scope scope(TAG_MESH);
+        a=malc(100);
+        {
+            tag_scope inner(TAG_STRINGS);
+            void* s=malc(40);
+            blkinfo_t info;
+            assert(blkinfo(s, &info)&&info.memtag==TAG_STRINGS);
+            rel(s);
+        }
+        assert(bound_tag()==TAG_MESH);
+    }
+    assert(bound_tag()==0);
+    blkinfo_t info;
+    assert(blkinfo(a, &info)&&info.memtag==TAG_MESH&&info.bytes>=100);
+    assert(blkinfo(untagged, &info)&&info.memtag==0);
+    assert(tag_live(TAG_MESH)>=100+sizeof(blktag_t));
+    assert(tag_live(TAG_STRINGS)==0);
+    assert(g_tags[TAG_STRINGS].livepeak.load()>=40);
+    rel(a);
+    rel(untagged);
+    assert(tag_live(TAG_MESH)==0);
+    std::printf("tag scope ok\n");
+}
+
+static void test_regrow()
+{
+    void* p=malc(64, alignof(hdr_t), nullptr, TAG_RENDER);
+    const size_t before=tag_live(TAG_RENDER);
+    //the last block of a fresh heap, grows into the bump region
+    void* q=regrow(p, 4096);
+    if(q)
+    {
+        assert(q==p);
+        assert(tag_live(TAG_RENDER)>=before+4096-64);
+        blkinfo_t info;
+        assert(blkinfo(q, &info)&&info.memtag==TAG_RENDER);
+    }
+    rel(p);
+    assert(tag_live(TAG_RENDER)==0);
+    std::printf("regrow ok\n");
+}
+
+static void test_budgets()
+{
+    on_budget(&on_budget_cb);
+    tag_budget(TAG_STRINGS, 1000, 4000);
+    void* ptrs[64];
+    size_t n=0;
+    opres res=opres::SUCCESS;
+    tag_scope scope(TAG_STRINGS);
+    while(n<64)
+    {
+        void* p=malc(200, alignof(hdr_t), &res);
+        if(!p)
+            break;
+        ptrs[n++]=p;
+    }
+    assert(res==opres::BUDGET_ERR);
+    assert(n>=4&&n<64);
+    assert(tag_live(TAG_STRINGS)<=4000);
+    assert(g_log.soft==1&&g_log.hard==1);   //one crossing, one refusal
+    assert(g_log.tag==TAG_STRINGS&&g_log.budget==4000&&g_log.live>4000);
+    //batches are refused as a whole
+    void* batch[8];
+    assert(malc_n(8, 200, alignof(hdr_t), batch)==opres::BUDGET_ERR);
+    rel_n(ptrs, n);
+    assert(tag_live(TAG_STRINGS)==0);
+    //crossing again fires again
+    void* p=malc(1200);
+    assert(p&&g_log.soft==2);
+    rel(p);
+    tag_budget(TAG_STRINGS, 0, 0);
+    on_budget(nullptr);
+    std::printf("budgets ok\n");
+}
+
+static void test_remote_and_batch()
+{
+    void* ptrs[500];
+    assert(malc_n(500, 48, alignof(hdr_t), ptrs, TAG_MESH)==opres::SUCCESS);
+    assert(tag_live(TAG_MESH)>=500*48);
+    std::thread([&]{rel_n(ptrs, 500);}).join();
+    assert(tag_live(TAG_MESH)==0);
+
+    tag_scope scope(TAG_MESH);
+    int* objs[100];
+    assert(alloctr<int>(objs, 100, 5)==opres::SUCCESS);
+    assert(tag_live(TAG_MESH)>0);
+    dtrel(objs, 100);
+    assert(tag_live(TAG_MESH)==0);
+    std::printf("remote and batch ok\n");
+}
+
+static void test_dedicated()
+{
+    void* p=malc(64*MB, alignof(hdr_t), nullptr, TAG_BIG);
+    assert(p);
+    blkinfo_t info;
+    assert(blkinfo(p, &info)&&info.owner==MAP_DEDICATED&&info.memtag==TAG_BIG);
+    assert(tag_live(TAG_BIG)>=64*MB);
+    tag_budget(TAG_BIG, 0, 80*MB);
+    assert(!malc(64*MB, alignof(hdr_t), nullptr, TAG_BIG));
+    //remaps are charged and budgeted like fresh blocks
+    if(void* q=regrow(p, 72*MB); q)
+    {
+        p=q;
+        assert(tag_live(TAG_BIG)>=72*MB);
+        opres res;
+        assert(!regrow(p, 96*MB, &res)&&res==opres::BUDGET_ERR);
+    }
+    rel(p);
+    assert(tag_live(TAG_BIG)==0);
+    tag_budget(TAG_BIG, 0, 0);
+    std::printf("dedicated ok\n");
+}
+
+static void test_storage()
+{
+    {
+        storage<uint32_t, DYNAMIC, false, 8, &alloc_tagged<TAG_RENDER>> vec;
+        for(uint32_t i=0; i<10000; ++i)
+            vec.push_back(i);
+        assert(tag_live(TAG_RENDER)>=10000*sizeof(uint32_t));
+        for(uint32_t i=0; i<10000; ++i)
+            assert(vec[i]==i);
+        //a scope does not override a storage's own tag
+        tag_scope scope(TAG_MESH);
+        vec.rsvcpct(50000);
+        assert(tag_live(TAG_MESH)==0);
+        assert(tag_live(TAG_RENDER)>=50000*sizeof(uint32_t));
+    }
+    assert(tag_live(TAG_RENDER)==0);
+    std::printf("tagged storage ok\n");
+}
+
+static void test_json()
+{
+    tag_name(TAG_MESH, "mesh");
+    void* p=malc(256, alignof(hdr_t), nullptr, TAG_MESH);
+    malcstats_t st=malc_stats();
+    bool found=false;
+    for(uint16_t i=0; i<st.tagsz; ++i)
+        if(st.tags[i].tag==TAG_MESH)
+        {
+            found=true;
+            assert(st.tags[i].live>=256&&std::strcmp(st.tags[i].name, "mesh")==0);
+        }
+    assert(found);
+    char buf[64*1024];
+    FILE* f=fmemopen(buf, sizeof(buf), "w");
+    assert(malc_stats_json(st, f));
+    std::fclose(f);
+    assert(std::strstr(buf, "\"tags\":[")&&std::strstr(buf, "\"name\":\"mesh\""));
+    rel(p);
+    std::printf("stats ok\n");
+}
+
+// ================== driver ======================
+int main()
+{
+    test_scope();
+    test_regrow();
+    test_budgets();
+    test_remote_and_batch();
+    test_dedicated();
+    test_storage();
+    test_json();
+    return 0;
+}
@@ -0,0 +1,165 @@
+#include "aico/malc.h"
+
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+using namespace aico::sys;
+using namespace aico;
+
+// resident set size in KB, 0 where /proc is unavailable
+static size_t rss_kb()
+{
+    FILE* f=fopen("/proc/self/statm", "r");
+    if(!f) return 0;
+    size_t pages=0, resident=0;
+    if(fscanf(f, "%zu %zu", &pages, &resident)!=2) resident=0;
+    fclose(f);
+    return resident*os_pagesize()/KB;
+}
+
+void test_trim_empty_heaps()
+{
+    std::cout << "Test: trim unmaps fully free heaps\n";
+    std::vector<void*> blocks;
+    for(size_t i=0; i<4096; ++i)
+    {
+        void* p=malc(4*KB);
+        assert(p);
+        std::memset(p, 0xCD, 4*KB);
+        blocks.push_back(p);
+    }
+    const uint8_t heaps=g_heapsz;
+    std::cout << "heaps: " << (int)heaps << " rss: " << rss_kb() << " KB\n";
+    for(void* p : blocks)
+        rel(p);
+
+    size_t released=trim();
+    std::cout << "released: " << released/KB << " KB rss: " << rss_kb() << " KB\n";
+    assert(released>=16*MB);
+    for(uint8_t i=0; i<heaps; ++i)
+        assert(g_heaps[i].owner==heap_t::RELEASED);
+
+    //released slots are recycled before new ones are reserved
+    void* p=malc(64);
+    assert(p);
+    assert(g_heapsz==heaps);
+    rel(p);
+    trim();
+    std::cout << "trim empty heaps passed ✅\n";
+}
+
+void test_trim_free_blocks()
+{
+    std::cout << "Test: trim discards pages under free blocks\n";
+    void* keep_front=malc(64);
+    void* big=malc(256*KB);
+    void* keep_back=malc(64);
+    assert(keep_front&&big&&keep_back);
+    std::memset(big, 0xEE, 256*KB);
+    rel(big);
+
+    size_t released=trim();
+    std::cout << "released: " << released/KB << " KB\n";
+    assert(released>=240*KB);//a page or two stays for tag and alignment
+    //the heap is still mapped and the neighbours untouched
+    std::memset(keep_front, 1, 64);
+    std::memset(keep_back, 1, 64);
+    void* again=malc(200*KB);
+    assert(again);
+    std::memset(again, 0x11, 200*KB);
+    rel(again);
+    rel(keep_front);
+    rel(keep_back);
+    trim();
+    std::cout << "trim free blocks passed ✅\n";
+}
+
+void test_dedicated_unmap()
+{
+    std::cout << "Test: dedicated blocks are unmapped on rel\n";
+    const size_t before=rss_kb();
+    for(int i=0; i<4; ++i)
+    {
+        void* p=malc(80*MB, 64);
+        assert(p);
+        assert(gethdr(p)->flags&hdr_t::DEDICATED);
+        std::memset(p, 0x5A, 80*MB);
+        rel(p);
+    }
+    const size_t after=rss_kb();
+    std::cout << "rss before: " << before << " KB after: " << after << " KB\n";
+    assert(after<before+16*KB);
+    std::cout << "dedicated unmap passed ✅\n";
+}
+
+void test_autotrim()
+{
+    std::cout << "Test: idle ticks trigger a single trim\n";
+    g_autotrim=3;
+    void* p=malc(1*KB);
+    rel(p);
+    size_t released=0;
+    for(int tick=0; tick<8; ++tick)
+        released+=trim_idle();
+    assert(released>0);
+    assert(trim_idle()==0 && "already trimmed this idle period");
+    g_autotrim=0;
+    std::cout << "autotrim passed ✅\n";
+}
+
+void test_hugepages()
+{
+    std::cout << "Test: huge page hinted heaps\n";
+    g_hugepages=true;
+    void* p=malc(8*MB);
+    assert(p);
+    blkinfo_t info;
+    assert(blkinfo(p, &info) && info.owner!=MAP_DEDICATED);
+    assert((uintptr_t)g_heaps[info.owner-1].addr%HUGEPAGE==0);
+    std::memset(p, 0x42, 8*MB);
+    rel(p);
+    trim();
+    g_hugepages=false;
+    std::cout << "huge pages passed ✅\n";
+}
+
+void test_recycle_full_table()
+{
+    std::cout << "Test: released slots are reused once every slot was taken\n";
+    const alloc_strat strat=g_strat;
+    const unsigned bump=g_constantbump;
+    g_strat=alloc_strat::CONSTANT;
+    g_constantbump=1*MB;//three blocks per heap, mapped but never touched
+    std::vector<void*> blocks;
+    opres res=opres::SUCCESS;
+    while(void* p=malc(300*KB, alignof(hdr_t), &res))
+        blocks.push_back(p);
+    assert(res==opres::NO_HEAPS&&g_heapsz==HEAPS_MAX);
+    std::cout << "blocks: " << blocks.size() << " until NO_HEAPS\n";
+    for(void* p : blocks)
+        rel(p);
+    trim();
+
+    void* p=malc(300*KB, alignof(hdr_t), &res);
+    assert(p&&res==opres::SUCCESS);
+    std::memset(p, 0x77, 300*KB);
+    rel(p);
+    trim();
+    g_strat=strat;
+    g_constantbump=bump;
+    std::cout << "recycle full table passed ✅\n";
+}
+
+int main()
+{
+    test_trim_empty_heaps();
+    test_trim_free_blocks();
+    test_dedicated_unmap();
+    test_autotrim();
+    test_hugepages();
+    test_recycle_full_table();
+    return 0;
+}
@@ -0,0 +1,162 @@
+#include "aico/malc.h"
+#include "aico/mapped.h"
+#include "aico/objparser.h"
+#include "aico/storage.h"
+#include "aico/timer.h"
+#include "aico/view.h"
+
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <type_traits>
+
+using namespace aico;
+
+// ============ helpers ============
+
+static const char* BLOB="mapped_test.bin";
+
+//`n` vertices after a `header` byte header, what a baked mesh looks like
+static void write_blob(size_t n, size_t header=0)
+{
+    FILE* f=std::fopen(BLOB, "wb");
+    assert(f);
+    for(size_t i=0; i<header; ++i)
+        std::fputc('h', f);
+    for(size_t i=0; i<n; ++i)
+    {
+        const vertex v{{{(float)i, 1.f, 2.f}}, {{0.f, 0.f, (float)i}}, {{(float)(i%7), 0.f}}};
+        std::fwrite(&v, sizeof(v), 1, f);
+    }
+    std::fclose(f);
+}
+
+static float sum_x(storage_view<const vec3> v)
+{
+    float s=0.f;
+    for(const vec3& p : v)
+        s+=p.x;
+    return s;
+}
+
+// ============ correctness ============
+
+static void test_readonly()
+{
+    write_blob(1000);
+    opres res;
+    mapped_storage<const vertex> m(BLOB, &res, map_hint::SEQUENTIAL);
+    assert(res==opres::SUCCESS&&m.size()==1000&&m[999].pos.x==999.f);
+    static_assert(std::is_same_v<decltype(m.begin()), const vertex*>);
+    //walked as a view, one member at a time
+    storage_view<const vertex> v=m;
+    assert(sum_x(v.member<&vertex::pos>())==999.f*1000/2);
+    assert(v.subview(10).member<&vertex::normal>()[0].z==10.f);
+    m.advise(map_hint::WILLNEED, 500, 100);
+    m.advise(map_hint::RANDOM);
+
+    mapped_storage<const vertex> moved(std::move(m));
+    assert(m.empty()&&moved.size()==1000&&moved[3].uv.x==3.f);
+    m=std::move(moved);
+    assert(moved.empty()&&m.size()==1000);
+    std::printf("read-only ok\n");
+}
+
+static void test_copy_on_write()
+{
+    write_blob(64);
+    {
+        mapped_storage<vertex> m(BLOB);
+        assert(m.size()==64);
+        m[5].pos.x=-1.f;
+        storage_view<vertex> v=m;
+        v[6].pos.x=-2.f;
+        assert(m[5].pos.x==-1.f&&m[6].pos.x==-2.f);
+    }
+    //the file never saw the writes
+    mapped_storage<const vertex> again(BLOB);
+    assert(again[5].pos.x==5.f&&again[6].pos.x==6.f);
+    std::printf("copy-on-write ok\n");
+}
+
+static void test_offsets()
+{
+    //past a page, so the mapping starts before the header ends
+    const size_t header=sys::os_pagesize()+16;
+    write_blob(100, header);
+    opres res;
+    mapped_storage<const vertex> m(BLOB, &res, map_hint::NORMAL, header);
+    assert(res==opres::SUCCESS&&m.size()==100&&m[0].pos.x==0.f&&m[99].pos.x==99.f);
+    mapped_storage<const vertex> some(BLOB, &res, map_hint::NORMAL, header+sizeof(vertex), 10);
+    assert(res==opres::SUCCESS&&some.size()==10&&some[9].pos.x==10.f);
+
+    mapped_storage<const vertex> bad(BLOB, &res, map_hint::NORMAL, header, 101);
+    assert(res==opres::BOUNDS_ERR&&bad.empty());
+    mapped_storage<const vertex>(BLOB, &res, map_hint::NORMAL, header+1);
+    assert(res==opres::ALIGN_ERR);
+    mapped_storage<const vertex>(BLOB, &res, map_hint::NORMAL, header+100*sizeof(vertex)+4);
+    assert(res==opres::BOUNDS_ERR);
+    //a trailing partial element is left out
+    mapped_storage<const uint64_t> words(BLOB, &res, map_hint::NORMAL, 0);
+    assert(res==opres::SUCCESS&&words.size()==(header+100*sizeof(vertex))/8);
+
+    write_blob(0);
+    mapped_storage<const vertex> none(BLOB, &res);
+    assert(res==opres::SUCCESS&&none.empty()&&none.begin()==none.end());
+    std::remove(BLOB);
+    mapped_storage<const vertex> missing(BLOB, &res);
+    assert(res==opres::FAILURE&&missing.empty());
+    std::printf("offsets and errors ok\n");
+}
+
+// ============ speed ============
+
+static void bench(size_t n)
+{
+    write_blob(n);
+    const size_t bytes=n*sizeof(vertex);
+    std::printf("\n=== %zu vertices, %zu MB ===\n", n, bytes/sys::MB);
+    micro_timer tm;
+    float sink=0.f;
+    {
+        //what loading looks like today: the file into malc memory, then a storage
+        FILE* f=std::fopen(BLOB, "rb");
+        char* contents=(char*)sys::malc(bytes);
+        const size_t got=std::fread(contents, 1, bytes, f);
+        std::fclose(f);
+        storage<vertex> mesh(got/sizeof(vertex));
+        std::memcpy((void*)mesh.begin(), contents, got);
+        sys::rel(contents);
+        sink+=sum_x(storage_view(mesh).member<&vertex::pos>());
+    }
+    const long long read=tm.tick().count();
+    for(map_hint hint : {map_hint::NORMAL, map_hint::SEQUENTIAL})
+    {
+        mapped_storage<const vertex> m(BLOB, nullptr, hint);
+        sink+=sum_x(m.view().member<&vertex::pos>());
+    }
+    const long long mapped=tm.tick().count();
+    {
+        //lazily faulted, only the pages a sparse walk lands on come in
+        mapped_storage<const vertex> m(BLOB, nullptr, map_hint::RANDOM);
+        for(size_t i=0; i<n; i+=n/1000)
+            sink+=m[i].pos.x;
+    }
+    const long long sparse=tm.tick().count();
+    std::printf("%-30s : %8lld us\n", "read+copy into storage", read);
+    std::printf("%-30s : %8lld us\n", "map+walk, normal & sequential", mapped/2);
+    std::printf("%-30s : %8lld us (%g)\n", "map+touch 1000 random", sparse, (double)sink);
+    std::remove(BLOB);
+}
+
+// ================== driver ======================
+int main()
+{
+    test_readonly();
+    test_copy_on_write();
+    test_offsets();
+
+    bench(4000000);
+    return 0;
+}
@@ -0,0 +1,192 @@
+#include "aico/parallel.h"
+#include "aico/storage.h"
+#include "aico/timer.h"
+#include "aico/view.h"
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <numeric>
+#include <string>
+
+using namespace aico;
+
+// ============ helpers ============
+
+struct Obj
+{
+    static inline std::atomic<int> live=0;
+    std::string s;
+    Obj()noexcept{++live;}
+    Obj(int i):s(std::to_string(i)+" and enough to leave sso"){++live;}
+    Obj(const Obj& o)noexcept:s(o.s){++live;}
+    Obj& operator=(const Obj&)noexcept=default;
+    ~Obj(){--live;}
+};
+
+struct rgb{uint8_t r, g, b, a, x[8];};   //12 bytes, no streamed fill
+
+// ============ correctness ============
+
+static void test_pool()
+{
+    for(size_t workers : {0, 1, 3})
+    {
+        worker_pool pool(workers);
+        assert(pool.lanes()==workers+1);
+        for(size_t n : {0, 1, 7, 1000})
+        {
+            std::atomic<size_t> sum{0};
+            storage<uint8_t> hit(n);
+            std::memset(hit.begin(), 0, n);
+            pool.run(n, [&](size_t i){sum+=i; ++hit[i];});
+            assert(sum==n*(n-(n>0))/2);
+            for(size_t i=0; i<n; ++i)
+                assert(hit[i]==1);
+        }
+    }
+    std::printf("worker_pool ok\n");
+}
+
+static void test_streaming()
+{
+    storage<char> src(300), dst(300);
+    for(size_t i=0; i<300; ++i)
+        src[i]=(char)(i*7);
+    for(size_t off=0; off<20; ++off)
+        for(size_t bytes : {0, 5, 16, 63, 64, 200})
+        {
+            std::memset(dst.begin(), 0, 300);
+            copy_nt(dst.begin()+off, src.begin()+3, bytes);
+            assert(std::memcmp(dst.begin()+off, src.begin()+3, bytes)==0);
+            assert(dst[off+bytes]==0&&(off==0||dst[off-1]==0));
+        }
+    //every element size that divides 16, from every misalignment
+    const char elem[16]={1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16};
+    for(size_t es : {1, 2, 4, 8, 16})
+        for(size_t off=0; off<16; ++off)
+        {
+            std::memset(dst.begin(), 0, 300);
+            const size_t count=(250-off)/es;
+            fill_nt(dst.begin()+off, elem, es, count);
+            for(size_t i=0; i<count*es; ++i)
+                assert(dst[off+i]==elem[i%es]);
+            assert(dst[off+count*es]==0);
+        }
+    std::printf("streaming stores ok\n");
+}
+
+static void test_storages()
+{
+    worker_pool pool(3);
+    //big enough to split, streamed too
+    const size_t n=NT_MIN_BYTES/sizeof(uint32_t)+1001;
+    storage<uint32_t> a(n);
+    std::iota(a.begin(), a.end(), 0u);
+    storage<uint32_t> b=par_copy(pool, a, n-5, 5);
+    assert(b.size()==n-5&&b[0]==5&&b[n-6]==n-1);
+    assert(par_resize(pool, b, n+100, 0xABCDu)==opres::SUCCESS);
+    assert(b[n-6]==n-1&&b[n-5]==0xABCD&&b[n+99]==0xABCD);
+    storage<rgb> px;
+    assert(par_resize(pool, px, PAR_MIN_BYTES, rgb{1, 2, 3, 4, {}})==opres::SUCCESS);
+    assert(px[PAR_MIN_BYTES/2].b==3);
+
+    //alive bits follow every run, the storage never sees a gap
+    {
+        const size_t m=PAR_MIN_BYTES/sizeof(Obj)*3;
+        storage<Obj> src(m, Obj(7));
+        //raw memory, every bit clear
+        storage<Obj> dst((Obj*)alloc_bind((m+13)*sizeof(Obj)), m+13, false);
+        assert(dst._alldead());
+        assert(par_copyinto(pool, src, dst, m, 13, 0, true)==opres::SUCCESS);
+        for(size_t i=0; i<13; ++i)
+            assert(!dst._alive(i));
+        for(size_t i=13; i<m+13; ++i)
+            assert(dst._alive(i)&&dst[i].s==src[0].s);
+        storage<Obj> c=par_copy(pool, src, m);
+        assert(c._allalive()&&c[m-1].s==src[0].s);
+        assert(par_resize(pool, c, m+m/2, Obj(8))==opres::SUCCESS&&c._allalive());
+        assert(c[m+m/2-1].s.find("8 ")==0);
+        //partially alive sources fall back to the serial copy
+        storage<Obj> part=par_copy(pool, dst, m+13);
+        assert(!part._alive(12)&&part._alive(13));
+    }
+    assert(Obj::live==0);
+    std::printf("parallel storages ok\n");
+}
+
+static void test_transform()
+{
+    worker_pool pool(2);
+    const size_t n=PAR_MIN_BYTES;
+    storage<uint32_t> src(n);
+    std::iota(src.begin(), src.end(), 0u);
+    storage<uint64_t> dst(2*n);
+    std::memset(dst.begin(), 0, 2*n*sizeof(uint64_t));
+    //into every other slot
+    assert(par_transform(pool, storage_view<const uint32_t>(src),
+        storage_view<uint64_t>(dst).every(2), [](uint32_t v)noexcept{return 3ull*v;})==
+        opres::SUCCESS);
+    for(size_t i=0; i<n; ++i)
+        assert(dst[2*i]==3ull*i&&dst[2*i+1]==0);
+    std::printf("transform ok\n");
+}
+
+// ============ speed ============
+
+//MB/s moved by f, best of three
+template<typename F>
+static double bandwidth(size_t bytes, F&& f)
+{
+    long long best=~0ull>>1;
+    for(int r=0; r<3; ++r)
+    {
+        micro_timer tm;
+        f();
+        best=std::min(best, std::max(1ll, (long long)tm.tick().count()));
+    }
+    return (double)bytes/(double)best;
+}
+
+static void bench(size_t bytes)
+{
+    const size_t n=bytes/sizeof(uint64_t);
+    storage<uint64_t> src(n, 1ull), dst(n, 0ull);
+    std::printf("\n=== %zu MB, MB/s ===\n", bytes/sys::MB);
+    std::printf("%-28s : %8.0f\n", "memcpy", bandwidth(bytes, [&]
+        {std::memcpy(dst.begin(), src.begin(), bytes);}));
+    std::printf("%-28s : %8.0f\n", "copy_nt", bandwidth(bytes, [&]
+        {copy_nt(dst.begin(), src.begin(), bytes);}));
+    std::printf("%-28s : %8.0f\n", "std::fill", bandwidth(bytes, [&]
+        {std::fill_n(dst.begin(), n, 7ull);}));
+    const uint64_t seven=7;
+    std::printf("%-28s : %8.0f\n", "fill_nt", bandwidth(bytes, [&]
+        {fill_nt(dst.begin(), &seven, sizeof(seven), n);}));
+    for(size_t workers : {0, 1, 3})
+    {
+        worker_pool pool(workers);
+        char name[64];
+        std::snprintf(name, sizeof(name), "par_copyinto, %zu lanes", pool.lanes());
+        std::printf("%-28s : %8.0f\n", name, bandwidth(bytes, [&]
+            {par_copyinto(pool, src, dst, n);}));
+        std::snprintf(name, sizeof(name), "par_transform, %zu lanes", pool.lanes());
+        std::printf("%-28s : %8.0f\n", name, bandwidth(bytes, [&]
+            {par_transform(pool, storage_view<const uint64_t>(src), storage_view<uint64_t>(dst),
+                [](uint64_t v)noexcept{return v*3+1;});}));
+    }
+}
+
+// ================== driver ======================
+int main()
+{
+    test_pool();
+    test_streaming();
+    test_storages();
+    test_transform();
+
+    //bandwidth bound, lanes past the memory channels stop helping
+    bench(256*sys::MB);
+    return 0;
+}
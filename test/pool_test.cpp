@@ -0,0 +1,159 @@
+#include "aico/pool.h"
+#include "aico/timer.h"
+
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <set>
+#include <thread>
+#include <vector>
+
+using namespace aico::sys;
+using namespace aico;
+
+// ============ helpers ============
+struct handle{uint32_t value;};
+
+struct Counted
+{
+    static inline int alive=0;
+    uint64_t payload[3];
+    Counted(uint64_t v):payload{v, v, v}{++alive;}
+    ~Counted(){--alive;}
+};
+
+// ============ tests ============
+
+static void test_reuse()
+{
+    pool<sizeof(handle), alignof(handle)> p;
+    static_assert(decltype(p)::BLOCK>=sizeof(void*));
+    void* a=p.alloc();
+    void* b=p.alloc();
+    assert(a&&b&&a!=b);
+    p.rel(a);
+    assert(p.alloc()==a && "freed blocks are handed out first");
+    p.rel(b);
+    p.rel(a);
+    assert(p.live()==0);
+    std::printf("[PASS] freelist reuse\n");
+}
+
+static void test_many_slabs()
+{
+    pool<48, 16, 4*KB> p;
+    std::vector<void*> blocks;
+    std::set<void*> unique;
+    for(int i=0; i<10000; ++i)
+    {
+        void* blk=p.alloc();
+        assert(blk&&(uintptr_t)blk%16==0);
+        blocks.push_back(blk);
+        unique.insert(blk);
+    }
+    assert(unique.size()==blocks.size() && "blocks never overlap");
+    for(void* blk : blocks)
+        p.rel(blk);
+    for(int i=0; i<10000; ++i)
+        assert(unique.count(p.alloc()) && "no new slabs once warmed up");
+    std::printf("[PASS] slab chaining\n");
+}
+
+static void test_make_destroy()
+{
+    pool<sizeof(Counted), alignof(Counted)> p;
+    Counted* c=p.make<Counted>(7u);
+    assert(c&&c->payload[2]==7&&Counted::alive==1);
+    p.destroy(c);
+    assert(Counted::alive==0&&p.live()==0);
+    std::printf("[PASS] make and destroy\n");
+}
+
+static void test_teardown()
+{
+    const size_t before=malc_stats().live;
+    void* straggler=nullptr;
+    {
+        pool<48, 16, 4*KB> p;
+        std::vector<void*> blocks;
+        for(int i=0; i<1000; ++i)
+            blocks.push_back(p.alloc());
+        straggler=blocks[500];
+        for(void* blk : blocks)
+            if(blk!=straggler)
+                p.rel(blk);
+    }
+    //only the straggler's slab outlives the pool
+    const size_t kept=malc_stats().live-before;
+    assert(kept>=4*KB&&kept<8*KB);
+    *(uint64_t*)straggler=1;
+    {
+        pool<48, 16, 4*KB> p;
+        std::vector<void*> blocks;
+        for(int i=0; i<1000; ++i)
+            blocks.push_back(p.alloc());
+        for(void* blk : blocks)
+            p.rel(blk);
+    }
+    assert(malc_stats().live-before==kept && "nothing out, every slab goes");
+    std::printf("[PASS] teardown frees idle slabs\n");
+}
+
+static void test_thread_pools()
+{
+    auto& mine=thread_pool<sizeof(handle), alignof(handle)>();
+    pool<sizeof(handle), alignof(handle)>* theirs=nullptr;
+    std::thread([&]
+    {
+        auto& p=thread_pool<sizeof(handle), alignof(handle)>();
+        theirs=&p;
+        p.destroy(p.make<handle>(1u));
+    }).join();
+    assert(theirs!=&mine && "one pool per thread");
+    std::printf("[PASS] thread pools\n");
+}
+
+// transient handle churn, what gfxctx does with buffers every frame
+static void bench_churn()
+{
+    const size_t N=2000000, live=256;
+    std::vector<handle*> ptrs(live, nullptr);
+
+    micro_timer tm;
+    for(size_t i=0; i<N; ++i)
+    {
+        handle*& slot=ptrs[(i*7919)%live];
+        delete slot;
+        slot=new handle{(uint32_t)i};
+    }
+    for(handle*& h : ptrs){delete h; h=nullptr;}
+    const long long us_new=tm.time_since_start().count();
+
+    auto& p=thread_pool<sizeof(handle), alignof(handle)>();
+    tm.reset();
+    for(size_t i=0; i<N; ++i)
+    {
+        handle*& slot=ptrs[(i*7919)%live];
+        p.destroy(slot);
+        slot=p.make<handle>((uint32_t)i);
+    }
+    for(handle*& h : ptrs){p.destroy(h); h=nullptr;}
+    const long long us_pool=tm.time_since_start().count();
+
+    std::printf("%-28s : %8lld us   (%5.1f ns/op)\n", "new/delete", us_new,
+        1000.0*(double)us_new/(double)N);
+    std::printf("%-28s : %8lld us   (%5.1f ns/op)\n", "thread_pool", us_pool,
+        1000.0*(double)us_pool/(double)N);
+}
+
+// ================== driver ======================
+int main()
+{
+    test_reuse();
+    test_many_slabs();
+    test_make_destroy();
+    test_teardown();
+    test_thread_pools();
+    bench_churn();
+    return 0;
+}
@@ -0,0 +1,116 @@
+#include "aico/arena.h"
+#include "aico/malc.h"
+#include "aico/resource.h"
+
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <memory_resource>
+#include <string>
+#include <vector>
+
+using namespace aico::sys;
+using namespace aico;
+
+enum : memtag_t
+{
+    TAG_PMR=1,
+    TAG_SCOPED
+};
+
+// ============ tests ============
+
+static void test_malc()
+{
+    const size_t base=malc_stats().live;
+    malc_resource mr(TAG_PMR);
+    {
+        std::pmr::vector<uint64_t> v(&mr);
+        for(uint64_t i=0; i<10000; ++i)
+            v.push_back(i);
+        assert(tag_live(TAG_PMR)>=10000*sizeof(uint64_t));
+        blkinfo_t info;
+        assert(blkinfo(v.data(), &info)&&info.memtag==TAG_PMR);
+
+        std::pmr::map<int, std::pmr::string> m(&mr);
+        for(int i=0; i<100; ++i)
+            m.emplace(i, "a string long enough to leave the small buffer");
+        assert(m.at(42).get_allocator().resource()==&mr);
+    }
+    assert(tag_live(TAG_PMR)==0);
+    assert(malc_stats().live==base);
+
+    //untagged resources follow the bound tag
+    {
+        tag_scope scope(TAG_SCOPED);
+        void* p=malc_default_resource()->allocate(100, 8);
+        assert(tag_live(TAG_SCOPED)>=100);
+        malc_default_resource()->deallocate(p, 100, 8);
+    }
+    assert(tag_live(TAG_SCOPED)==0);
+
+    //over-aligned and tiny alignments
+    void* a=mr.allocate(1000, 256);
+    void* b=mr.allocate(3, 1);
+    assert((uintptr_t)a%256==0&&b);
+    mr.deallocate(a, 1000, 256);
+    mr.deallocate(b, 3, 1);
+
+    assert(mr.is_equal(*malc_default_resource()));
+    assert(!mr.is_equal(*std::pmr::new_delete_resource()));
+    std::printf("malc resource ok\n");
+}
+
+static void test_arena()
+{
+    arena a;
+    arena b;
+    arena_resource ra(a), rb(b), ra2(a);
+    assert(ra.is_equal(ra2)&&!ra.is_equal(rb));
+    assert(!ra.is_equal(*malc_default_resource()));
+    {
+        std::pmr::vector<int> v(&ra);
+        for(int i=0; i<1000; ++i)
+            v.push_back(i);
+        for(int i=0; i<1000; ++i)
+            assert(v[i]==i);
+        assert(a.used()>=1000*sizeof(int));
+        void* p=ra.allocate(64, 64);
+        assert((uintptr_t)p%64==0);
+    }
+    //deallocation is a no-op, the arena takes it all back at once
+    assert(a.used()>0);
+    a.reset();
+    assert(a.used()==0);
+    std::printf("arena resource ok\n");
+}
+
+static void test_default()
+{
+    std::pmr::memory_resource* prev=std::pmr::set_default_resource(malc_default_resource());
+    const size_t base=malc_stats().live;
+    {
+        std::pmr::vector<double> v;
+        v.resize(5000);
+        assert(malc_stats().live>=base+5000*sizeof(double));
+        //copies land on the default resource, whatever the source used
+        arena a;
+        arena_resource ra(a);
+        std::pmr::vector<double> scratch(v.begin(), v.end(), &ra);
+        std::pmr::vector<double> kept(scratch);
+        assert(kept.get_allocator().resource()==malc_default_resource());
+    }
+    assert(malc_stats().live==base);
+    std::pmr::set_default_resource(prev);
+    std::printf("default resource ok\n");
+}
+
+// ================== driver ======================
+int main()
+{
+    test_malc();
+    test_arena();
+    test_default();
+    return 0;
+}
@@ -0,0 +1,147 @@
+#include "aico/malc.h"
+#include "aico/retire.h"
+
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+using namespace aico::sys;
+using namespace aico;
+
+// ============ helpers ============
+
+struct calllog_t
+{
+    int calls=0;
+    std::vector<uintptr_t> objs;
+};
+static calllog_t g_a, g_b;
+
+static void retire_a(void* const* objs, size_t n)
+{
+    ++g_a.calls;
+    for(size_t i=0; i<n; ++i)
+        g_a.objs.push_back((uintptr_t)objs[i]);
+}
+static void retire_b(void* const* objs, size_t n)
+{
+    ++g_b.calls;
+    for(size_t i=0; i<n; ++i)
+        g_b.objs.push_back((uintptr_t)objs[i]);
+}
+static void reset_logs(){g_a={}; g_b={};}
+
+static size_t live_bytes(){return malc_stats().live;}
+
+// ============ tests ============
+
+static void test_frames()
+{
+    reset_logs();
+    retire_queue q;
+    assert(q.frame()==0);
+    q.defer(&retire_a, (void*)1);
+    q.defer(&retire_a, (void*)2);
+    assert(q.close()==0);
+    assert(q.close()==1);   //empty frame
+    q.defer(&retire_a, (void*)3);
+    assert(q.close()==2);
+    q.defer(&retire_a, (void*)4);   //open frame 3
+    assert(q.pending()==4);
+
+    assert(q.retire(1)==2);
+    assert(g_a.objs==(std::vector<uintptr_t>{1, 2}));
+    assert(q.retire(1)==0);
+    assert(q.retire(2)==1);
+    assert(g_a.objs.back()==3);
+    //open frames never retire
+    assert(q.retire(100)==0&&q.pending()==1);
+    assert(q.flush()==1&&q.pending()==0);
+    assert(g_a.objs.back()==4&&g_a.calls==3);
+    std::printf("frames ok\n");
+}
+
+static void test_grouping()
+{
+    reset_logs();
+    retire_queue q;
+    for(uintptr_t i=1; i<=1000; ++i)
+        q.defer(i%3?&retire_a:&retire_b, (void*)i);
+    q.close();
+    assert(q.retire(0)==1000);
+    //one call per function, order kept within a function
+    assert(g_a.calls==1&&g_b.calls==1);
+    assert(g_a.objs.size()+g_b.objs.size()==1000);
+    for(size_t i=1; i<g_a.objs.size(); ++i)
+        assert(g_a.objs[i-1]<g_a.objs[i]);
+    for(uintptr_t o : g_b.objs)
+        assert(o%3==0);
+    std::printf("grouping ok\n");
+}
+
+static void test_memory()
+{
+    const size_t base=live_bytes();
+    {
+        retire_queue q;
+        for(int frame=0; frame<8; ++frame)
+        {
+            for(int i=0; i<100; ++i)
+                assert(q.defer(malc(64+i))==opres::SUCCESS);
+            q.close();
+            //two frames in flight
+            if(frame>=2)
+                q.retire((uint64_t)frame-2);
+        }
+        assert(q.pending()==200);
+        assert(q.defer(nullptr)==opres::SUCCESS&&q.pending()==200);
+        //the destructor releases the rest
+    }
+    assert(live_bytes()==base);
+    std::printf("memory ok\n");
+}
+
+static void test_bound()
+{
+    reset_logs();
+    const size_t base=live_bytes();
+    //nothing bound, released on the spot
+    retire(&retire_a, (void*)7);
+    assert(g_a.calls==1);
+    rel_deferred(malc(100));
+    assert(live_bytes()==base);
+
+    retire_queue q;
+    {
+        retire_scope scope(q);
+        assert(bound_retire()==&q);
+        retire(&retire_a, (void*)8);
+        rel_deferred(malc(100));
+        assert(g_a.calls==1&&q.pending()==2);
+        {
+            retire_queue inner;
+            retire_scope nested(inner);
+            retire(&retire_b, (void*)9);
+            assert(inner.pending()==1);
+        }
+        assert(g_b.calls==1&&bound_retire()==&q);
+    }
+    assert(bound_retire()==nullptr);
+    const size_t held=live_bytes();
+    q.close();
+    q.retire(q.frame());
+    assert(g_a.calls==2&&q.pending()==0);
+    assert(live_bytes()+100<=held);
+    std::printf("bound ok\n");
+}
+
+// ================== driver ======================
+int main()
+{
+    test_frames();
+    test_grouping();
+    test_memory();
+    test_bound();
+    return 0;
+}
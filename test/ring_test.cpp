@@ -0,0 +1,293 @@
+#include "aico/ring.h"
+#include "aico/timer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace aico;
+
+// ============ helpers ============
+
+struct Obj
+{
+    static inline std::atomic<int> live=0;
+    std::string s;
+    Obj()noexcept{++live;}
+    Obj(int i):s(std::to_string(i)+" and enough to leave sso"){++live;}
+    Obj(const Obj& o)noexcept:s(o.s){++live;}   //mpmc_ring wants it
+    Obj(Obj&& o)noexcept:s(std::move(o.s)){++live;}
+    Obj& operator=(Obj&&)noexcept=default;
+    ~Obj(){--live;}
+};
+
+//mutex baseline, same interface as the rings
+template<typename T, size_t N>
+struct locked_queue
+{
+    std::mutex m;
+    std::deque<T> q;
+    bool try_push(const T& v)
+    {
+        std::lock_guard lk(m);
+        if(q.size()==N)
+            return false;
+        q.push_back(v);
+        return true;
+    }
+    bool try_pop(T& out)
+    {
+        std::lock_guard lk(m);
+        if(q.empty())
+            return false;
+        out=q.front();
+        q.pop_front();
+        return true;
+    }
+};
+
+//a failed try yields, the other side may share the core
+static size_t backoff(size_t got)
+{
+    if(!got)
+        std::this_thread::yield();
+    return got;
+}
+
+// ============ correctness ============
+
+static void test_spsc_single()
+{
+    {
+        spsc_ring<Obj, 8> r;
+        static_assert(alignof(spsc_ring<Obj, 8>)==CACHELINE);
+        assert(r.empty()&&r.capacity()==8);
+        for(int i=0; i<8; ++i)
+            assert(r.try_emplace(i));
+        assert(!r.try_emplace(8)&&r.size()==8&&Obj::live==8);
+        Obj o;
+        for(int i=0; i<5; ++i)
+            assert(r.try_pop(o)&&o.s.find(std::to_string(i)+" ")==0);
+        //batches wrap around the end
+        Obj src[6]{Obj(10), Obj(11), Obj(12), Obj(13), Obj(14), Obj(15)};
+        assert(r.push_n(src, 6)==5&&r.size()==8);
+        Obj dst[8];
+        assert(r.pop_n(dst, 8)==8&&r.empty()&&!r.try_pop(o));
+        assert(dst[0].s.find("5 ")==0&&dst[7].s.find("14 ")==0);
+        r.push_n(src, 3);   //left in the ring
+    }
+    assert(Obj::live==0);
+    std::printf("spsc single thread ok\n");
+}
+
+static void test_mpmc_single()
+{
+    {
+        mpmc_ring<Obj, 4> r;
+        Obj o;
+        for(int lap=0; lap<10; ++lap)
+        {
+            Obj src[3]{Obj(lap), Obj(lap+1), Obj(lap+2)};
+            assert(r.push_n(src, 3)==3&&r.try_push(Obj(lap+3))&&!r.try_push(Obj(0)));
+            Obj dst[4];
+            assert(r.pop_n(dst, 2)==2&&dst[1].s.find(std::to_string(lap+1)+" ")==0);
+            assert(r.try_pop(o)&&r.pop_n(dst, 4)==1&&!r.try_pop(o)&&r.empty());
+        }
+        r.try_push(Obj(1));  //left in the ring
+    }
+    assert(Obj::live==0);
+    std::printf("mpmc single thread ok\n");
+}
+
+static void test_spsc_threads()
+{
+    auto r=std::make_unique<spsc_ring<uint64_t, 1024>>();
+    const uint64_t n=2000000;
+    std::thread producer([&]
+        {
+            uint64_t next=0, batch[37];
+            while(next<n)
+                if(next%3)
+                    next+=backoff(r->try_push(next));
+                else
+                {
+                    const size_t k=(size_t)std::min<uint64_t>(37, n-next);
+                    for(size_t i=0; i<k; ++i)
+                        batch[i]=next+i;
+                    next+=backoff(r->push_n(batch, k));
+                }
+        });
+    uint64_t expect=0, buf[64];
+    while(expect<n)
+    {
+        const size_t k=backoff(expect%2?r->pop_n(buf, 64):r->try_pop(buf[0]));
+        for(size_t i=0; i<k; ++i)
+            assert(buf[i]==expect++);
+    }
+    producer.join();
+    assert(r->empty());
+    std::printf("spsc two threads ok\n");
+}
+
+static void test_mpmc_threads()
+{
+    auto r=std::make_unique<mpmc_ring<uint64_t, 256>>();
+    const size_t producers=4, consumers=4;
+    const uint64_t per=300000;
+    std::atomic<uint64_t> total{0}, popped{0};
+    std::vector<std::thread> pool;
+    for(uint64_t p=0; p<producers; ++p)
+        pool.emplace_back([&, p]
+            {
+                uint64_t batch[16];
+                for(uint64_t i=0; i<per;)
+                {
+                    const size_t k=(size_t)std::min<uint64_t>(1+i%16, per-i);
+                    for(size_t j=0; j<k; ++j)
+                        batch[j]=p<<32|(i+j);
+                    i+=backoff(r->push_n(batch, k));
+                }
+            });
+    for(size_t c=0; c<consumers; ++c)
+        pool.emplace_back([&]
+            {
+                //one producer's items reach one consumer in order
+                uint64_t last[producers], buf[8], sum=0;
+                std::fill_n(last, producers, ~0ull);
+                while(popped.load(std::memory_order_relaxed)<producers*per)
+                {
+                    const size_t k=backoff(r->pop_n(buf, 8));
+                    for(size_t i=0; i<k; ++i)
+                    {
+                        const uint64_t p=buf[i]>>32, seq=buf[i]&0xFFFFFFFF;
+                        assert(last[p]==~0ull||seq>last[p]);
+                        last[p]=seq;
+                        sum+=seq;
+                    }
+                    popped+=k;
+                }
+                total+=sum;
+            });
+    for(std::thread& t : pool)
+        t.join();
+    assert(popped==producers*per&&total==producers*(per*(per-1)/2));
+    assert(r->empty());
+    std::printf("mpmc %zux%zu threads ok\n", producers, consumers);
+}
+
+// ============ speed ============
+
+//items per microsecond, `producers` threads pushing `per` each through Q
+template<typename Q>
+static double throughput(Q& q, size_t producers, size_t consumers, uint64_t per, size_t batch)
+{
+    std::atomic<uint64_t> popped{0};
+    std::atomic<bool> go{false};
+    std::vector<std::thread> pool;
+    for(size_t p=0; p<producers; ++p)
+        pool.emplace_back([&]
+            {
+                uint64_t buf[64]{};
+                while(!go.load())
+                    backoff(0);
+                for(uint64_t i=0; i<per;)
+                    if constexpr(requires{q.push_n(buf, batch);})
+                        i+=backoff(batch>1?q.push_n(buf, std::min<uint64_t>(batch, per-i)):
+                            q.try_push(i));
+                    else
+                        i+=backoff(q.try_push(i));
+            });
+    for(size_t c=0; c<consumers; ++c)
+        pool.emplace_back([&]
+            {
+                uint64_t buf[64];
+                while(!go.load())
+                    backoff(0);
+                while(popped.load(std::memory_order_relaxed)<producers*per)
+                {
+                    size_t k;
+                    if constexpr(requires{q.pop_n(buf, batch);})
+                        k=batch>1?q.pop_n(buf, batch):q.try_pop(buf[0]);
+                    else
+                        k=q.try_pop(buf[0]);
+                    if(backoff(k))
+                        popped.fetch_add(k, std::memory_order_relaxed);
+                }
+            });
+    micro_timer tm;
+    go=true;
+    for(std::thread& t : pool)
+        t.join();
+    return double(producers*per)/(double)std::max<long long>(1, tm.tick().count());
+}
+
+//round trip through two spsc rings, ns
+static double pingpong(size_t trips)
+{
+    auto there=std::make_unique<spsc_ring<uint64_t, 64>>();
+    auto back=std::make_unique<spsc_ring<uint64_t, 64>>();
+    std::thread echo([&]
+        {
+            uint64_t v=0;
+            for(size_t i=0; i<trips; ++i)
+            {
+                while(!backoff(there->try_pop(v)));
+                while(!backoff(back->try_push(v)));
+            }
+        });
+    const auto t0=std::chrono::steady_clock::now();
+    uint64_t v=0;
+    for(size_t i=0; i<trips; ++i)
+    {
+        while(!backoff(there->try_push(i)));
+        while(!backoff(back->try_pop(v)));
+    }
+    const auto t1=std::chrono::steady_clock::now();
+    echo.join();
+    return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(t1-t0).count()/trips;
+}
+
+static void bench()
+{
+    std::printf("\n=== throughput, items/us ===\n");
+    {
+        auto s=std::make_unique<spsc_ring<uint64_t, 4096>>();
+        std::printf("%-28s : %8.1f\n", "spsc 1x1", throughput(*s, 1, 1, 4000000, 1));
+        std::printf("%-28s : %8.1f\n", "spsc 1x1, batch 32", throughput(*s, 1, 1, 4000000, 32));
+    }
+    for(size_t t : {1, 2, 4})
+    {
+        char name[64];
+        auto m=std::make_unique<mpmc_ring<uint64_t, 4096>>();
+        std::snprintf(name, sizeof(name), "mpmc %zux%zu", t, t);
+        std::printf("%-28s : %8.1f\n", name, throughput(*m, t, t, 2000000/t, 1));
+        std::snprintf(name, sizeof(name), "mpmc %zux%zu, batch 32", t, t);
+        std::printf("%-28s : %8.1f\n", name, throughput(*m, t, t, 2000000/t, 32));
+        auto l=std::make_unique<locked_queue<uint64_t, 4096>>();
+        std::snprintf(name, sizeof(name), "mutex+deque %zux%zu", t, t);
+        std::printf("%-28s : %8.1f\n", name, throughput(*l, t, t, 2000000/t, 1));
+    }
+    std::printf("\n=== latency ===\n");
+    std::printf("%-28s : %8.1f ns\n", "spsc round trip", pingpong(200000));
+}
+
+// ================== driver ======================
+int main()
+{
+    test_spsc_single();
+    test_mpmc_single();
+    test_spsc_threads();
+    test_mpmc_threads();
+
+    bench();
+    return 0;
+}
@@ -0,0 +1,166 @@
+#include "aico/malc.h"
+#include "aico/segmented.h"
+#include "aico/storage.h"
+#include "aico/timer.h"
+
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace aico;
+
+// ============ helpers ============
+
+struct Obj
+{
+    static inline int live=0;
+    static inline int fail_in=0;    //the fail_in-th default construction throws
+    std::string s;
+    Obj():s("default, long enough to leave sso")
+    {
+        if(fail_in>0&&--fail_in==0)
+            throw 1;
+        ++live;
+    }
+    Obj(int i):s(std::to_string(i)){++live;}
+    Obj(const Obj& o):s(o.s){++live;}
+    Obj(Obj&& o)noexcept:s(std::move(o.s)){++live;}
+    ~Obj(){--live;}
+};
+
+// ============ correctness ============
+
+static void test_stable()
+{
+    segmented_storage<uint64_t, 64> s;
+    assert(s.size()==0&&s.chunks()==0);
+    std::vector<uint64_t*> addrs;
+    for(uint64_t i=0; i<10000; ++i)
+    {
+        assert(s.push_back(i)==opres::SUCCESS);
+        addrs.push_back(&s[i]);
+    }
+    assert(s.chunks()==(10000+63)/64&&s.capacity()>=10000);
+    for(uint64_t i=0; i<10000; ++i)
+        assert(&s[i]==addrs[i]&&*addrs[i]==i);
+    //aliasing push_back needs no temporary, nothing moves
+    s.push_back(s[5]);
+    assert(s[10000]==5&&&s[5]==addrs[5]);
+
+    s.resize(100);
+    assert(s.chunks()==2&&s.capacity()>=10000);
+    assert(s.shrink()==(10001+63)/64-2);
+    assert(s.capacity()==128&&&s[99]==addrs[99]);
+
+    segmented_storage<uint64_t, 64> moved(std::move(s));
+    assert(moved.size()==100&&s.size()==0&&&moved[42]==addrs[42]);
+    s.push_back(1);     //moved-from is empty, still usable
+    assert(s.size()==1&&s[0]==1);
+    std::printf("stable addresses ok\n");
+}
+
+static void test_lifetimes()
+{
+    {
+        segmented_storage<Obj, 16> s(100);
+        assert(Obj::live==100);
+        for(int i=0; i<1000; ++i)
+            s.emplace_back(i);
+        assert(Obj::live==1100&&s[100].s=="0"&&s[1099].s=="999");
+        s.resize(37);
+        assert(Obj::live==37);
+        s.resize(50);
+        assert(Obj::live==50&&s[49].s.size()>20);
+    }
+    assert(Obj::live==0);
+    //a throw partway into the third chunk takes the first two with it
+    Obj::fail_in=40;
+    bool threw=false;
+    try{segmented_storage<Obj, 16> s(100);}
+    catch(int){threw=true;}
+    assert(threw&&Obj::live==0);
+    std::printf("lifetimes ok\n");
+}
+
+static void test_chunks()
+{
+    segmented_storage<uint32_t, 1024> s;
+    const size_t n=1000003;
+    for(uint32_t i=0; i<n; ++i)
+        s.push_back(i);
+    //whole runs, the last one partial
+    size_t total=0;
+    s.for_chunks([&](std::span<uint32_t> run, size_t first)
+        {
+            assert(run[0]==first);
+            total+=run.size();
+        });
+    assert(total==n&&s.chunk(s.chunks()-1).size()==n%1024);
+
+    //one range of chunks per thread
+    const size_t workers=4, nc=s.chunks();
+    uint64_t partial[workers]{};
+    std::vector<std::thread> pool;
+    for(size_t w=0; w<workers; ++w)
+        pool.emplace_back([&, w]
+            {
+                s.for_chunks(nc*w/workers, nc*(w+1)/workers,
+                    [&](std::span<uint32_t> run, size_t)
+                    {
+                        for(uint32_t& v : run)
+                            partial[w]+=v, v*=2;
+                    });
+            });
+    for(std::thread& t : pool)
+        t.join();
+    uint64_t sum=0;
+    for(uint64_t p : partial)
+        sum+=p;
+    assert(sum==(uint64_t)n*(n-1)/2);
+    assert(s[n-1]==2*(n-1));
+    std::printf("chunk iteration ok\n");
+}
+
+// ============ speed ============
+
+static void bench(size_t n)
+{
+    std::printf("\n=== push_back %zu uint64 ===\n", n);
+    micro_timer tm;
+    {
+        storage<uint64_t> st;
+        for(uint64_t i=0; i<n; ++i)
+            st.push_back(i);
+        std::printf("%-22s : %8lld us\n", "storage", (long long)tm.tick().count());
+    }
+    (void)tm.tick();
+    {
+        segmented_storage<uint64_t> seg;
+        for(uint64_t i=0; i<n; ++i)
+            seg.push_back(i);
+        std::printf("%-22s : %8lld us\n", "segmented_storage", (long long)tm.tick().count());
+        uint64_t sum=0;
+        for(uint64_t i=0; i<n; ++i)
+            sum+=seg[i];
+        const long long idx=tm.tick().count();
+        seg.for_chunks([&](std::span<uint64_t> run, size_t){for(uint64_t v : run) sum-=v;});
+        std::printf("%-22s : %8lld us\n", "  indexed read", idx);
+        std::printf("%-22s : %8lld us (%llu)\n", "  chunked read", (long long)tm.tick().count(),
+            (unsigned long long)sum);
+    }
+}
+
+// ================== driver ======================
+int main()
+{
+    test_stable();
+    test_lifetimes();
+    test_chunks();
+
+    bench(1000000);
+    bench(20000000);
+    return 0;
+}
@@ -0,0 +1,185 @@
+#include "aico/slotmap.h"
+#include "aico/timer.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace aico;
+
+// ============ helpers ============
+
+struct Obj
+{
+    static inline int live=0;
+    std::string s;
+    Obj(int i):s(std::to_string(i)+" and enough to leave sso"){++live;}
+    Obj(const Obj& o):s(o.s){++live;}
+    Obj(Obj&& o)noexcept:s(std::move(o.s)){++live;}
+    Obj& operator=(Obj&&)noexcept=default;
+    ~Obj(){--live;}
+};
+
+// ============ correctness ============
+
+static void test_handles()
+{
+    static_assert(sizeof(slot_map<int>::handle_t)==4);
+    slot_map<int> m;
+    using handle=slot_map<int>::handle_t;
+    assert(m.empty()&&!m.get(handle{})&&!handle{});
+
+    handle a=m.insert(1), b=m.insert(2), c=m.insert(3);
+    assert(a&&b&&c&&m.size()==3&&m[b]==2);
+    assert(m.erase(b)==opres::SUCCESS&&m.size()==2);
+    assert(!m.contains(b)&&!m.get(b)&&m.erase(b)==opres::BOUNDS_ERR);
+    assert(m[a]==1&&m[c]==3);
+
+    //the freed slot comes back with a new generation
+    handle d=m.insert(4);
+    assert(d.index()==b.index()&&d.gen()==b.gen()+1&&!m.contains(b)&&m[d]==4);
+
+    //values stay packed, handle_at maps dense back to handles
+    int sum=0;
+    for(int v : m)
+        sum+=v;
+    assert(sum==8&&m.values().size()==3);
+    for(size_t i=0; i<m.size(); ++i)
+        assert(m[m.handle_at(i)]==m.values()[i]);
+
+    m.clear();
+    assert(m.empty()&&!m.contains(a)&&!m.contains(c)&&!m.contains(d));
+    std::printf("handles ok\n");
+}
+
+static void test_random()
+{
+    //against a reference map, stale handles kept around to probe
+    slot_map<Obj, 12> m;
+    std::unordered_map<uint32_t, int> ref;
+    std::vector<slot_map<Obj, 12>::handle_t> live, dead;
+    std::mt19937 rng(11);
+    for(int op=0; op<200000; ++op)
+    {
+        if(live.empty()||rng()%3)
+        {
+            const int v=(int)(rng()%100000);
+            auto h=m.emplace(v);
+            if(!h)  //every slot in use
+            {
+                assert(live.size()==4096);
+                continue;
+            }
+            assert(!ref.count(h.bits));
+            ref[h.bits]=v;
+            live.push_back(h);
+        }
+        else
+        {
+            const size_t i=rng()%live.size();
+            auto h=live[i];
+            assert(m.erase(h)==opres::SUCCESS);
+            ref.erase(h.bits);
+            live[i]=live.back();
+            live.pop_back();
+            dead.push_back(h);
+        }
+        if(op%997==0)
+        {
+            assert(m.size()==ref.size()&&(int)m.size()==Obj::live);
+            for(auto h : live)
+                assert(m[h].s.find(std::to_string(ref[h.bits])+" ")==0);
+            for(auto h : dead)
+                assert(!m.contains(h));
+            dead.clear();
+        }
+    }
+    slot_map<Obj, 12> moved(std::move(m));
+    assert(moved.size()==live.size()&&m.size()==0&&!m.contains(live[0]));
+    assert(moved.get(live[0]));
+    std::printf("random ops ok\n");
+}
+
+static void test_retire()
+{
+    //2 generation bits: a slot is reused 3 times, then retired
+    slot_map<int, 30> m;
+    auto h=m.insert(0);
+    const uint32_t idx=h.index();
+    for(int i=0; i<3; ++i)
+    {
+        assert(m.erase(h)==opres::SUCCESS);
+        h=m.insert(i+1);
+        assert(h.index()==(i<2?idx:idx+1));
+    }
+    assert(m.erase(h)==opres::SUCCESS);
+    auto fresh=m.insert(9);
+    assert(fresh.index()==idx+1&&m._slots.size()==2&&m[fresh]==9);
+    std::printf("retire ok\n");
+}
+
+// ============ speed ============
+
+static void bench(size_t n)
+{
+    std::printf("\n=== %zu values ===\n", n);
+    std::mt19937 rng(13);
+    std::vector<uint32_t> order(n);
+    for(size_t i=0; i<n; ++i)
+        order[i]=(uint32_t)i;
+    std::shuffle(order.begin(), order.end(), rng);
+
+    micro_timer tm;
+    slot_map<uint64_t> m;
+    std::vector<slot_map<uint64_t>::handle_t> hs(n);
+    for(size_t i=0; i<n; ++i)
+        hs[i]=m.insert(i);
+    const long long ins=tm.tick().count();
+    uint64_t sum=0;
+    for(uint32_t i : order)
+        sum+=*m.get(hs[i]);
+    const long long look=tm.tick().count();
+    for(int r=0; r<10; ++r)
+        for(uint64_t v : m)
+            sum+=v;
+    const long long iter=tm.tick().count();
+    for(size_t i=0; i<n/2; ++i)
+        (void)m.erase(hs[order[i]]);
+    const long long era=tm.tick().count();
+
+    std::unordered_map<uint32_t, uint64_t> um;
+    for(size_t i=0; i<n; ++i)
+        um.emplace((uint32_t)i, i);
+    const long long uins=tm.tick().count();
+    for(uint32_t i : order)
+        sum+=um.find(i)->second;
+    const long long ulook=tm.tick().count();
+    for(int r=0; r<10; ++r)
+        for(auto& [k, v] : um)
+            sum+=v;
+    const long long uiter=tm.tick().count();
+
+    std::printf("%-24s : %8s %10s\n", "", "slot_map", "unord_map");
+    std::printf("%-24s : %8lld %10lld us\n", "insert", ins, uins);
+    std::printf("%-24s : %8lld %10lld us\n", "random lookup", look, ulook);
+    std::printf("%-24s : %8lld %10lld us\n", "iterate x10", iter, uiter);
+    std::printf("%-24s : %8lld us (%llu)\n", "erase half", era, (unsigned long long)sum);
+}
+
+// ================== driver ======================
+int main()
+{
+    test_handles();
+    test_random();
+    test_retire();
+    assert(Obj::live==0);
+
+    bench(100000);
+    bench(1000000);
+    return 0;
+}
@@ -0,0 +1,143 @@
+#include "aico/objparser.h"
+#include "aico/soa.h"
+#include "aico/storage.h"
+#include "aico/timer.h"
+
+#include <cassert>
+#include <cfloat>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+
+using namespace aico;
+
+// ============ helpers ============
+
+using vertex_soa=soa_of<&vertex::pos, &vertex::normal, &vertex::uv>;
+
+struct bounds_t{vec3 min, max;};
+
+static storage<vertex> make_mesh(size_t n)
+{
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<float> d(-100.f, 100.f);
+    storage<vertex> vtx;
+    vtx.rsvcpct(n);
+    for(size_t i=0; i<n; ++i)
+    {
+        vertex v;
+        v.pos={d(rng), d(rng), d(rng)};
+        v.normal={0.f, 1.f, 0.f};
+        v.uv={d(rng), d(rng)};
+        vtx.push_back(v);
+    }
+    return vtx;
+}
+
+static bounds_t bounds_aos(const vertex* v, size_t n)
+{
+    bounds_t b{{FLT_MAX, FLT_MAX, FLT_MAX}, {-FLT_MAX, -FLT_MAX, -FLT_MAX}};
+    for(size_t i=0; i<n; ++i)
+        for(int k=0; k<3; ++k)
+        {
+            b.min[k]=v[i].pos[k]<b.min[k]?v[i].pos[k]:b.min[k];
+            b.max[k]=v[i].pos[k]>b.max[k]?v[i].pos[k]:b.max[k];
+        }
+    return b;
+}
+
+static bounds_t bounds_soa(std::span<const vec3> pos)
+{
+    bounds_t b{{FLT_MAX, FLT_MAX, FLT_MAX}, {-FLT_MAX, -FLT_MAX, -FLT_MAX}};
+    for(const vec3& p : pos)
+        for(int k=0; k<3; ++k)
+        {
+            b.min[k]=p[k]<b.min[k]?p[k]:b.min[k];
+            b.max[k]=p[k]>b.max[k]?p[k]:b.max[k];
+        }
+    return b;
+}
+
+// ============ correctness ============
+
+static void test_layout()
+{
+    soa_storage<float, uint8_t, vec3> s;
+    assert(s.size()==0&&s.capacity()>=8);
+    for(int i=0; i<1000; ++i)
+        assert(s.push_back((float)i, (uint8_t)i, vec3{{{(float)i, 0.f, 0.f}}})==
+            opres::SUCCESS);
+    assert(s.size()==1000);
+    assert((uintptr_t)s.data<0>()%64==0&&(uintptr_t)s.data<1>()%64==0&&
+        (uintptr_t)s.data<2>()%64==0);
+    for(int i=0; i<1000; ++i)
+    {
+        auto [f, b, v]=s[i];
+        assert(f==(float)i&&b==(uint8_t)i&&v.x==(float)i);
+    }
+    s.at<0>(5)=-1.f;
+    assert(s.column<0>()[5]==-1.f&&s.column<1>().size()==1000);
+    assert(s.resize(10)==opres::SUCCESS&&s.column<2>().size()==10);
+
+    soa_storage<float, uint8_t, vec3> moved(std::move(s));
+    assert(moved.size()==10&&s.size()==0&&moved.at<2>(9).x==9.f);
+    std::printf("layout ok\n");
+}
+
+static void test_conversion()
+{
+    storage<vertex> mesh=make_mesh(1001);
+    vertex_soa soa;
+    assert((soa.from_aos<&vertex::pos, &vertex::normal, &vertex::uv>(mesh.begin(),
+        mesh.size())==opres::SUCCESS));
+    assert(soa.size()==1001);
+    for(size_t i=0; i<mesh.size(); ++i)
+    {
+        assert(soa.at<0>(i).y==mesh[i].pos.y);
+        assert(soa.at<2>(i).x==mesh[i].uv.x);
+    }
+    storage<vertex> back(mesh.size());
+    soa.to_aos<&vertex::pos, &vertex::normal, &vertex::uv>(back.begin());
+    assert(std::memcmp(back.begin(), mesh.begin(), sizeof(vertex)*mesh.size())==0);
+
+    //a subset of members, in any order
+    soa_of<&vertex::uv, &vertex::pos> some;
+    some.from_aos<&vertex::uv, &vertex::pos>(mesh.begin(), mesh.size());
+    assert(some.at<1>(7).z==mesh[7].pos.z);
+    std::printf("conversion ok\n");
+}
+
+// ============ speed ============
+
+static void bench(size_t n, int reps)
+{
+    storage<vertex> mesh=make_mesh(n);
+    vertex_soa soa;
+    std::printf("\n=== %zu vertices, x%d ===\n", n, reps);
+    micro_timer tm;
+    for(int r=0; r<reps; ++r)
+        soa.from_aos<&vertex::pos, &vertex::normal, &vertex::uv>(mesh.begin(), n);
+    const long long conv=tm.tick().count();
+    volatile float sink=0;
+    for(int r=0; r<reps; ++r)
+        sink=sink+bounds_aos(mesh.begin(), n).max.x;
+    const long long aos=tm.tick().count();
+    for(int r=0; r<reps; ++r)
+        sink=sink+bounds_soa(soa.column<0>()).max.x;
+    const long long soas=tm.tick().count();
+    assert(bounds_aos(mesh.begin(), n).min.y==bounds_soa(soa.column<0>()).min.y);
+    std::printf("%-20s : %8lld us\n", "aos->soa", conv);
+    std::printf("%-20s : %8lld us\n", "bounds over aos", aos);
+    std::printf("%-20s : %8lld us\n", "bounds over column", soas);
+}
+
+// ================== driver ======================
+int main()
+{
+    test_layout();
+    test_conversion();
+
+    bench(100000, 100);
+    bench(2000000, 10);
+    return 0;
+}
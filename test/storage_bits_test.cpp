@@ -0,0 +1,162 @@
+#include "aico/storage.h"
+#include "aico/timer.h"
+
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace aico;
+
+// ============ helpers ============
+
+struct Obj
+{
+    static inline int live=0;
+    std::string s;
+    Obj(int i):s(std::to_string(i)+" and enough to leave sso"){++live;}
+    Obj(const Obj& o):s(o.s){++live;}
+    Obj(Obj&& o)noexcept:s(std::move(o.s)){++live;}
+    ~Obj(){--live;}
+};
+
+static bool ref_get(const std::vector<bool>& ref, size_t i){return ref[i];}
+static bool bit_get(const uint8_t* bits, size_t i){return bits[i/8]&(1u<<i%8);}
+
+// ============ bitmap helpers ============
+
+static void test_fill_all()
+{
+    std::mt19937 rng(5);
+    for(int round=0; round<2000; ++round)
+    {
+        const size_t n=1+rng()%700;
+        std::vector<uint8_t> bits((n+7)/8+1, 0);
+        std::vector<bool> ref(n, false);
+        for(int op=0; op<8; ++op)
+        {
+            size_t a=rng()%(n+1), b=rng()%(n+1);
+            if(a>b) std::swap(a, b);
+            const bool v=rng()&1;
+            bits_fill(bits.data(), a, b, v);
+            for(size_t i=a; i<b; ++i)
+                ref[i]=v;
+        }
+        for(size_t i=0; i<n; ++i)
+            assert(bit_get(bits.data(), i)==ref_get(ref, i));
+        //bytes past the last bit are untouched
+        assert(bits.back()==0);
+
+        bool all=true, none=true;
+        for(size_t i=0; i<n; ++i)
+            all=all&&ref[i], none=none&&!ref[i];
+        assert(bits_all(bits.data(), n, true)==all);
+        assert(bits_all(bits.data(), n, false)==none);
+
+        size_t a=rng()%(n+1), b=rng()%(n+1);
+        if(a>b) std::swap(a, b);
+        size_t expect=a;
+        for(const size_t i : bit_range{bits.data(), a, b})
+        {
+            while(!ref[expect]) ++expect;
+            assert(i==expect&&i<b);
+            ++expect;
+        }
+        while(expect<b) assert(!ref[expect++]);
+    }
+    //long runs, the vector path
+    std::vector<uint8_t> big(4096, 0xFF);
+    assert(bits_all(big.data(), 4096*8, true));
+    big[3000]=0xEF;
+    assert(!bits_all(big.data(), 4096*8, true));
+    assert(!bits_all(big.data(), 4096*8, false));
+    std::printf("bitmap helpers ok\n");
+}
+
+// ============ storage ============
+
+static void test_sparse_storage()
+{
+    {
+        //user-initialized storage: only some elements are constructed
+        storage<Obj> s(1000, 0);
+        s.resize(0);
+        assert(Obj::live==0);
+        s.resize(3000, Obj(7));
+        assert(Obj::live==3000&&s._allalive());
+        s.resize(200);
+        assert(Obj::live==200);
+    }
+    assert(Obj::live==0);
+    {
+        std::vector<uint8_t> pattern(125);
+        for(size_t i=0; i<pattern.size(); ++i)
+            pattern[i]=(uint8_t)(i*37);
+        Obj* raw=(Obj*)aico::sys::malc(1000*sizeof(Obj));
+        for(size_t i=0; i<1000; ++i)
+            if(bit_get(pattern.data(), i))
+                new (raw+i) Obj((int)i);
+        const int constructed=Obj::live;
+        storage<Obj> s(raw, 1000, pattern.data());
+        assert(!s._allalive()&&!s._alldead());
+        size_t seen=0;
+        for(const size_t i : s._alive_range(0, 1000))
+            assert(bit_get(pattern.data(), i)&&s[i].s.find(std::to_string(i))==0), ++seen;
+        assert(seen==(size_t)constructed);
+
+        auto c=s.copy(900, 50);
+        assert(Obj::live==constructed+[&]{int n=0; for(size_t i=50; i<950; ++i)
+            n+=bit_get(pattern.data(), i); return n;}());
+        s.rsvcpct(5000);    //moves live ones only
+        for(const size_t i : s._alive_range(0, 1000))
+            assert(s[i].s.find(std::to_string(i))==0);
+    }
+    assert(Obj::live==0);
+    std::printf("sparse storage ok\n");
+}
+
+// ============ speed ============
+
+static void bench(size_t n)
+{
+    std::vector<uint8_t> bits((n+7)/8, 0);
+    std::mt19937 rng(9);
+    for(size_t i=0; i<n/64; ++i)
+        bits[rng()%bits.size()]|=(uint8_t)(1u<<(rng()%8));
+    std::printf("\n=== %zu bits ===\n", n);
+    micro_timer tm;
+    size_t count=0;
+    for(int r=0; r<20; ++r)
+        for(size_t i=0; i<n; ++i)
+            count+=bit_get(bits.data(), i);
+    const long long perbit=tm.tick().count();
+    size_t count2=0;
+    for(int r=0; r<20; ++r)
+        for(const size_t i : bit_range{bits.data(), 0, n})
+            count2+=i!=~size_t(0);
+    const long long ctz=tm.tick().count();
+    assert(count==count2);
+    bool all=false;
+    for(int r=0; r<20; ++r)
+    {
+        bits_fill(bits.data(), 0, n, r&1);
+        all^=bits_all(bits.data(), n, r&1);
+    }
+    const long long fill=tm.tick().count();
+    std::printf("%-24s : %8lld us\n", "visit live, per bit", perbit);
+    std::printf("%-24s : %8lld us\n", "visit live, ctz", ctz);
+    std::printf("%-24s : %8lld us (%d)\n", "fill + all, word-wise", fill, (int)all);
+}
+
+// ================== driver ======================
+int main()
+{
+    test_fill_all();
+    test_sparse_storage();
+
+    bench(1<<20);
+    bench(1<<26);
+    return 0;
+}
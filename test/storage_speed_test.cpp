@@ -217,6 +217,54 @@ static void bench_storage(std::size_t N, std::mt19937_64& rng)
     print_t("storage rand idx (dummy)", us_rand, guard);
 }
 
+// ============ push_back without reserve, growth policy only ============
+
+template<class T>
+static T make_elem(size_t i)
+{
+    if constexpr (std::is_same_v<T, NoDefault> || std::is_same_v<T, MoveOnly>)
+        return T(int(i));
+    else if constexpr (std::is_same_v<T, NonTrivialDef>)
+        return T("abc");
+    else
+        return T{};
+}
+
+template<class Vec>
+static long long push_noreserve(std::size_t N, uint64_t& guard)
+{
+    using aico::micro_timer;
+    micro_timer tm;
+    Vec v;
+    for (size_t i = 0; i < N; ++i)
+        v.push_back(make_elem<std::remove_cvref_t<decltype(*v.begin())>>(i));
+    auto us = tm.time_since_start().count();
+    guard = checksum(v.begin(), v.end());
+    return us;
+}
+
+template<class T>
+static void bench_push_noreserve(std::size_t N)
+{
+    uint64_t g;
+    long long us;
+
+    us = push_noreserve<std::vector<T>>(N, g);
+    print_t("vector push_back (no rsv)", us, g);
+
+    us = push_noreserve<aico::storage<T, aico::DYNAMIC, false, 8, malloc, free>>(N, g);
+    print_t("storage push_back (no rsv)", us, g);
+
+    us = push_noreserve<aico::storage<T>>(N, g); //malc backed, may regrow in place
+    print_t("storage<malc> push_back", us, g);
+
+    //exact growth is quadratic in copies, keep it small
+    const size_t M = std::min<size_t>(N, 5000);
+    us = push_noreserve<aico::storage<T, aico::DYNAMIC, false, 8, malloc, free,
+        aico::grow_exact>>(M, g);
+    std::printf("%-28s : %8lld us   (N=%zu)\n", "storage exact growth", us, M);
+}
+
 // ================== driver ======================
 template<class T>
 static void run_case(const char* name, std::size_t N, std::mt19937_64& rng) 
@@ -224,6 +272,7 @@ static void run_case(const char* name, std::size_t N, std::mt19937_64& rng)
     std::printf("\n=== %s (N=%zu) ===\n", name, N);
     bench_vector<T>(N, rng);
     bench_storage<T>(N, rng);
+    bench_push_noreserve<T>(N);
 }
 
 int main() {
@@ -0,0 +1,127 @@
+#include "aico/objparser.h"
+#include "aico/storage.h"
+#include "aico/timer.h"
+#include "aico/view.h"
+
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <numeric>
+#include <type_traits>
+
+using namespace aico;
+
+// ============ helpers ============
+
+static float sum_x(storage_view<const vec3> v)
+{
+    float s=0.f;
+    for(const vec3& p : v)
+        s+=p.x;
+    return s;
+}
+static int sum(storage_view<const int> v){return std::accumulate(v.begin(), v.end(), 0);}
+
+// ============ correctness ============
+
+static void test_conversions()
+{
+    storage<int> dyn(10);
+    std::iota(dyn.begin(), dyn.end(), 0);
+    const storage<int>& cdyn=dyn;
+    storage<int, 4> fixed;
+    for(int i=0; i<4; ++i)
+        fixed[i]=i+1;
+
+    //implicit from any storage, const or not, and from spans
+    assert(sum(dyn)==45&&sum(cdyn)==45&&sum(fixed)==10);
+    assert(sum(std::span<int>(dyn.begin(), 3))==3);
+    static_assert(std::is_same_v<decltype(storage_view(dyn)), storage_view<int>>);
+    static_assert(std::is_same_v<decltype(storage_view(cdyn)), storage_view<const int>>);
+    static_assert(!std::is_constructible_v<storage_view<int>, const storage<int>&>);
+    static_assert(!std::is_constructible_v<storage_view<int>, storage_view<const int>>);
+
+    storage_view<int> v=dyn;
+    v[3]=-3;
+    assert(dyn[3]==-3&&v.data()==dyn.begin()&&v.contiguous()&&v.span().size()==10);
+    storage_view<const int> cv=v;
+    assert(cv.size()==10&&cv[3]==-3);
+    std::printf("conversions ok\n");
+}
+
+static void test_slicing()
+{
+    storage<int> s(100);
+    std::iota(s.begin(), s.end(), 0);
+    storage_view<int> v=s;
+    //the second half, no copy
+    storage_view<int> half=v.subview(50);
+    assert(half.size()==50&&half[0]==50&&&half[0]==&s[50]);
+    assert(v.subview(10, 5).size()==5&&sum(v.subview(10, 5))==60);
+    assert(v.subview(95, 50).size()==5&&v.subview(100).empty());
+
+    storage_view<int> odd=v.subview(1).every(2);
+    assert(odd.size()==50&&!odd.contiguous()&&odd[49]==99);
+    assert(sum(odd)==2500&&sum(v.every(3))==(0+99)*34/2);
+    assert(odd.subview(10, 2)[1]==23);
+    std::printf("slicing ok\n");
+}
+
+static void test_members()
+{
+    storage<vertex> mesh(64);
+    for(size_t i=0; i<mesh.size(); ++i)
+        mesh[i]={{{(float)i, 0.f, 0.f}}, {{0.f, (float)i, 0.f}}, {{(float)i, -1.f}}};
+    storage_view<vertex> vs=mesh;
+    auto normals=vs.member<&vertex::normal>();
+    static_assert(std::is_same_v<decltype(normals), storage_view<vec3>>);
+    assert(normals.size()==64&&normals.stride()==sizeof(vertex)&&normals[7].y==7.f);
+    normals[7].y=-7.f;
+    assert(mesh[7].normal.y==-7.f);
+
+    const storage<vertex>& cmesh=mesh;
+    auto uvs=storage_view(cmesh).subview(32).member<&vertex::uv>();
+    static_assert(std::is_same_v<decltype(uvs), storage_view<const vec2>>);
+    assert(uvs.size()==32&&uvs[0].x==32.f);
+    assert(sum_x(storage_view(cmesh).member<&vertex::pos>())==63.f*64/2);
+    assert(storage_view<vertex>().member<&vertex::pos>().empty());
+    std::printf("members ok\n");
+}
+
+// ============ speed ============
+
+static void bench(size_t n)
+{
+    storage<vertex> mesh(n);
+    for(size_t i=0; i<n; ++i)
+        mesh[i].pos={{(float)(i%7), 1.f, 2.f}};
+    std::printf("\n=== second half of %zu vertices, x20 ===\n", n);
+    micro_timer tm;
+    float sink=0.f;
+    for(int r=0; r<20; ++r)
+    {
+        auto half=mesh.copy(n-n/2, n/2);
+        sink+=half[0].pos.x;
+    }
+    const long long copy=tm.tick().count();
+    for(int r=0; r<20; ++r)
+        sink+=storage_view(mesh).subview(n/2)[0].pos.x;
+    const long long view=tm.tick().count();
+    for(int r=0; r<20; ++r)
+        sink+=sum_x(storage_view(mesh).subview(n/2).member<&vertex::pos>());
+    const long long walk=tm.tick().count();
+    std::printf("%-26s : %8lld us\n", "storage::copy", copy);
+    std::printf("%-26s : %8lld us\n", "storage_view::subview", view);
+    std::printf("%-26s : %8lld us (%g)\n", "walk pos member of view", walk, (double)sink);
+}
+
+// ================== driver ======================
+int main()
+{
+    test_conversions();
+    test_slicing();
+    test_members();
+
+    bench(1000000);
+    return 0;
+}